@@ -0,0 +1,67 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "embedded/fonts.h"
+#include "visage_app/application_editor.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <vector>
+
+using namespace visage;
+
+TEST_CASE("Layer submission", "[benchmark][app]") {
+  static constexpr int kNumRegions = 2000;
+  static constexpr int kColumns = 50;
+
+  ApplicationEditor editor;
+  editor.onDraw() = [&editor](Canvas& canvas) {
+    canvas.setColor(0xff223344);
+    canvas.fill(0, 0, editor.width(), editor.height());
+  };
+
+  std::vector<std::unique_ptr<Frame>> frames;
+  for (int i = 0; i < kNumRegions; ++i) {
+    frames.push_back(std::make_unique<Frame>());
+    Frame* frame = frames.back().get();
+    frame->onDraw() = [frame, i](Canvas& canvas) {
+      canvas.setColor(0xff88aacc);
+      canvas.roundedRectangle(0, 0, frame->width(), frame->height(), 3);
+      canvas.setColor(0xffeeddcc);
+      if (i % 2)
+        canvas.circle(4, 2, 12);
+      else
+        canvas.text("1", Font(10, fonts::Lato_Regular_ttf), Font::kCenter, 0, 0, frame->width(),
+                    frame->height());
+    };
+    editor.addChild(frame);
+    frame->setBounds((i % kColumns) * 20, (i / kColumns) * 18, 18, 16);
+  }
+
+  editor.setWindowless(kColumns * 20, (kNumRegions / kColumns) * 18);
+  editor.drawWindow();
+
+  BENCHMARK("Submit 2000 small regions") {
+    editor.redraw();
+    editor.drawWindow();
+  };
+}
@@ -0,0 +1,137 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "embedded/fonts.h"
+#include "visage_graphics/font.h"
+#include "visage_graphics/graphics_utils.h"
+#include "visage_graphics/palette.h"
+#include "visage_graphics/shape_batcher.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+
+using namespace visage;
+
+namespace {
+  std::vector<RoundedRectangle> widgetShapes(int num_shapes) {
+    static constexpr int kColumns = 50;
+    static constexpr float kSpacing = 40.0f;
+
+    std::mt19937 generator(num_shapes);
+    std::uniform_real_distribution<float> offset(0.0f, 16.0f);
+    std::uniform_real_distribution<float> size(2.0f, 24.0f);
+
+    ClampBounds clamp = { 0.0f, 0.0f, 4000.0f, 4000.0f };
+    std::vector<RoundedRectangle> shapes;
+    for (int i = 0; i < num_shapes; ++i) {
+      int widget = i / 5;
+      float x = (widget % kColumns) * kSpacing + offset(generator);
+      float y = (widget / kColumns) * kSpacing + offset(generator);
+      shapes.emplace_back(clamp, nullptr, x, y, size(generator), size(generator), 4.0f);
+    }
+    return shapes;
+  }
+
+  std::u32string paragraph(int length) {
+    static constexpr char32_t kWords[] = U"the quick brown fox jumps over a lazy dog while visage draws ";
+    std::u32string text;
+    for (int i = 0; text.size() < length; ++i)
+      text.push_back(kWords[i % (std::size(kWords) - 1)]);
+    return text;
+  }
+}
+
+TEST_CASE("Shape batcher", "[benchmark][graphics]") {
+  std::vector<RoundedRectangle> shapes = widgetShapes(10000);
+
+  BENCHMARK("Batch 10k shapes") {
+    ShapeBatcher batcher;
+    for (const RoundedRectangle& shape : shapes)
+      batcher.addShape(shape);
+    return batcher.numBatches();
+  };
+
+  DirtyRegion invalid_rects;
+  invalid_rects.add({ 0, 0, 4000, 4000 });
+  BatchVector<RoundedRectangle> batches;
+  batches.emplace_back(&shapes, &invalid_rects, 0, 0);
+  std::vector<ShapeVertex> vertices(numShapes(batches) * kVerticesPerQuad);
+
+  BENCHMARK("Quad vertices for 10k shapes") {
+    return setQuadVertices(batches, vertices.data());
+  };
+
+  setParallelVertexGeneration(false);
+  BENCHMARK("Serial quad vertices for 10k shapes") {
+    return setQuadVertices(batches, vertices.data());
+  };
+  setParallelVertexGeneration(true);
+}
+
+TEST_CASE("Atlas packing", "[benchmark][graphics]") {
+  std::mt19937 generator(0);
+  std::uniform_int_distribution<int> size(4, 80);
+  std::vector<std::pair<int, int>> rects;
+  for (int i = 0; i < 2000; ++i)
+    rects.emplace_back(size(generator), size(generator));
+
+  BENCHMARK("Pack 2000 rects") {
+    PackedAtlasMap<int> atlas_map;
+    for (int i = 0; i < rects.size(); ++i)
+      atlas_map.addRect(i, rects[i].first, rects[i].second);
+    atlas_map.pack();
+    return atlas_map.width();
+  };
+}
+
+TEST_CASE("Font measurement", "[benchmark][graphics]") {
+  Font font(14, fonts::Lato_Regular_ttf, 1.0f);
+  std::u32string text = paragraph(4000);
+  font.stringWidth(text);
+
+  BENCHMARK("String width of 4000 characters") {
+    return font.stringWidth(text);
+  };
+
+  BENCHMARK("Line breaks of 4000 characters") {
+    return font.lineBreaks(text.c_str(), text.size(), 300.0f).size();
+  };
+}
+
+TEST_CASE("Palette lookup", "[benchmark][graphics]") {
+  static constexpr int kNumColors = 256;
+
+  Palette palette;
+  std::vector<theme::ColorId> color_ids;
+  for (int i = 0; i < kNumColors; ++i) {
+    color_ids.push_back(theme::ColorId::nextId("BenchmarkColor" + std::to_string(i), __FILE__, 0xff000000));
+    palette.setColor(color_ids.back(), Color(0xff000000 + i));
+  }
+
+  BENCHMARK("Look up 256 colors") {
+    Brush brush;
+    int found = 0;
+    for (const theme::ColorId& color_id : color_ids)
+      found += palette.color({}, color_id, brush);
+    return found;
+  };
+}
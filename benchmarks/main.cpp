@@ -0,0 +1,117 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <catch2/catch_session.hpp>
+#include <catch2/catch_test_case_info.hpp>
+#include <catch2/reporters/catch_reporter_event_listener.hpp>
+#include <catch2/reporters/catch_reporter_registrars.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+  struct BenchmarkResult {
+    std::string test_case;
+    std::string name;
+    double mean_ns = 0.0;
+    double mean_low_ns = 0.0;
+    double mean_high_ns = 0.0;
+    double standard_deviation_ns = 0.0;
+    int samples = 0;
+    int iterations = 0;
+  };
+
+  std::string escapeJson(const std::string& text) {
+    std::string result;
+    for (char c : text) {
+      if (c == '"' || c == '\\')
+        result.push_back('\\');
+      if (static_cast<unsigned char>(c) >= 0x20)
+        result.push_back(c);
+    }
+    return result;
+  }
+
+  class JsonBenchmarkListener : public Catch::EventListenerBase {
+  public:
+    static std::string& outputPath() {
+      static std::string path;
+      return path;
+    }
+
+    using EventListenerBase::EventListenerBase;
+
+    void testCaseStarting(const Catch::TestCaseInfo& test_info) override {
+      test_case_ = test_info.name;
+    }
+
+    void benchmarkEnded(const Catch::BenchmarkStats<>& stats) override {
+      BenchmarkResult result;
+      result.test_case = test_case_;
+      result.name = stats.info.name;
+      result.mean_ns = stats.mean.point.count();
+      result.mean_low_ns = stats.mean.lower_bound.count();
+      result.mean_high_ns = stats.mean.upper_bound.count();
+      result.standard_deviation_ns = stats.standardDeviation.point.count();
+      result.samples = static_cast<int>(stats.samples.size());
+      result.iterations = stats.info.iterations;
+      results_.push_back(std::move(result));
+    }
+
+    void testRunEnded(const Catch::TestRunStats&) override {
+      if (outputPath().empty())
+        return;
+
+      std::ofstream file(outputPath());
+      file << "{\n  \"benchmarks\": [";
+      for (size_t i = 0; i < results_.size(); ++i) {
+        const BenchmarkResult& result = results_[i];
+        file << (i ? ",\n" : "\n") << "    {\"test_case\": \"" << escapeJson(result.test_case)
+             << "\", \"name\": \"" << escapeJson(result.name) << "\", \"mean_ns\": " << result.mean_ns
+             << ", \"mean_low_ns\": " << result.mean_low_ns << ", \"mean_high_ns\": " << result.mean_high_ns
+             << ", \"standard_deviation_ns\": " << result.standard_deviation_ns
+             << ", \"samples\": " << result.samples << ", \"iterations\": " << result.iterations << "}";
+      }
+      file << "\n  ]\n}\n";
+    }
+
+  private:
+    std::string test_case_;
+    std::vector<BenchmarkResult> results_;
+  };
+}
+
+CATCH_REGISTER_LISTENER(JsonBenchmarkListener)
+
+int main(int argc, char* argv[]) {
+  Catch::Session session;
+
+  using namespace Catch::Clara;
+  auto cli = session.cli() |
+             Opt(JsonBenchmarkListener::outputPath(), "file")["--json"]("write benchmark results as JSON");
+  session.cli(cli);
+
+  int result = session.applyCommandLine(argc, argv);
+  if (result)
+    return result;
+
+  return session.run();
+}
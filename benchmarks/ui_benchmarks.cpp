@@ -0,0 +1,53 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "visage_ui/layout.h"
+#include "visage_utils/dimension.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+using namespace visage;
+using namespace visage::dimension;
+
+TEST_CASE("Flex layout", "[benchmark][ui]") {
+  static constexpr int kNumChildren = 10000;
+
+  Layout layout;
+  layout.setFlex(true);
+  layout.setFlexRows(false);
+  layout.setFlexWrap(true);
+  layout.setFlexGap(4_px);
+  layout.setPadding(8_px);
+
+  std::vector<Layout> children(kNumChildren);
+  std::vector<const Layout*> child_pointers;
+  for (int i = 0; i < kNumChildren; ++i) {
+    children[i].setDimensions(20 + i % 7, 16 + i % 5);
+    children[i].setFlexGrow(i % 3);
+    children[i].setMargin(1_px);
+    child_pointers.push_back(&children[i]);
+  }
+
+  BENCHMARK("Flex positions for 10k children") {
+    return layout.flexPositions(child_pointers, { 0, 0, 1920, 1080 }, 2.0f).size();
+  };
+}
@@ -0,0 +1,69 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "visage_utils/space.h"
+#include "visage_utils/string_utils.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+
+using namespace visage;
+
+TEST_CASE("Break into non overlapping", "[benchmark][utils]") {
+  std::mt19937 generator(0);
+  std::uniform_int_distribution<int> position(0, 1500);
+  std::uniform_int_distribution<int> size(10, 200);
+  std::vector<IBounds> rects;
+  for (int i = 0; i < 1000; ++i)
+    rects.emplace_back(position(generator), position(generator), size(generator), size(generator));
+
+  BENCHMARK("Break 1000 overlapping pairs") {
+    std::vector<IBounds> pieces;
+    for (int i = 1; i < rects.size(); ++i) {
+      IBounds rect1 = rects[i - 1];
+      IBounds rect2 = rects[i];
+      IBounds::breakIntoNonOverlapping(rect1, rect2, pieces);
+    }
+    return pieces.size();
+  };
+}
+
+TEST_CASE("String conversion", "[benchmark][utils]") {
+  static constexpr char32_t kCharacters[] = { U'a', U'Z', U' ', U'é', U'Ω', U'中',
+                                              U'\U0001F600' };
+  std::u32string utf32;
+  for (int i = 0; i < 100000; ++i)
+    utf32.push_back(kCharacters[i % std::size(kCharacters)]);
+  std::string utf8 = String::convertUtf32ToUtf8(utf32);
+
+  BENCHMARK("UTF-8 to UTF-32 for 100k characters") {
+    return String::convertUtf8ToUtf32<std::u32string>(utf8).size();
+  };
+
+  BENCHMARK("UTF-32 to UTF-8 for 100k characters") {
+    return String::convertUtf32ToUtf8(utf32).size();
+  };
+
+  BENCHMARK("String from UTF-8 for 100k characters") {
+    return String(utf8).length();
+  };
+}
@@ -189,6 +189,7 @@ int runExample() {
   compiler.watchShaderFolder(SHADERS_FOLDER);
 
   visage::ApplicationWindow editor;
+  editor.setSdfShapeBatching(true);
 
   editor.onDraw() = [&editor](visage::Canvas& canvas) {
     canvas.setColor(BackgroundColor);
@@ -151,6 +151,7 @@ namespace visage {
   }
 
   void ApplicationEditor::drawStaleChildren() {
+    frame_cache_.update(&top_level_, stale_children_);
     drawing_children_.clear();
     std::swap(stale_children_, drawing_children_);
     for (Frame* child : drawing_children_) {
@@ -75,6 +75,10 @@ namespace visage {
     Window* window() const { return window_; }
 
     void drawStaleChildren();
+    AutoCache& autoCache() { return frame_cache_; }
+    void setSdfShapeBatching(bool sdf_shape_batching) {
+      canvas_->setSdfShapeBatching(sdf_shape_batching);
+    }
 
     void setDimensions(float width, float height) { setBounds(x(), y(), width, height); }
     void setNativeDimensions(int width, int height) {
@@ -91,6 +95,7 @@ namespace visage {
 
   private:
     Window* window_ = nullptr;
+    AutoCache frame_cache_;
     TopLevelFrame top_level_;
     FrameEventHandler event_handler_;
     std::unique_ptr<Canvas> canvas_;
@@ -19,10 +19,15 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include "embedded/fonts.h"
 #include "visage/app.h"
 
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <visage/graphics.h>
 #include <visage/ui.h>
 #include <visage/widgets.h>
 
@@ -106,4 +111,337 @@ TEST_CASE("Screenshot horizontal gradient", "[integration]") {
       REQUIRE(data[index + 3] == 0xff);
     }
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Lines submit one draw per batch", "[integration]") {
+  static constexpr int kNumLines = 32;
+  static constexpr int kNumPoints = 50;
+
+  std::vector<Line> lines(kNumLines, Line(kNumPoints));
+  for (int i = 0; i < kNumLines; ++i) {
+    for (int p = 0; p < kNumPoints; ++p) {
+      lines[i].x[p] = p * 2.0f;
+      lines[i].y[p] = 20.0f + 10.0f * std::sin(p * 0.2f + i);
+    }
+  }
+
+  bool draw_lines = false;
+  Canvas* drawn_canvas = nullptr;
+  ApplicationEditor editor;
+  editor.onDraw() = [&](Canvas& canvas) {
+    drawn_canvas = &canvas;
+    canvas.setColor(0xff000000);
+    canvas.fill(0, 0, editor.width(), editor.height());
+    if (!draw_lines)
+      return;
+
+    canvas.setColor(0xff88aacc);
+    for (Line& line : lines)
+      canvas.line(&line, 0, 0, editor.width(), editor.height(), 2);
+    for (Line& line : lines)
+      canvas.lineFill(&line, 0, 0, editor.width(), editor.height(), editor.height());
+  };
+
+  editor.setWindowless(100, 50);
+  editor.takeScreenshot();
+  REQUIRE(drawn_canvas);
+  int background_draws = drawn_canvas->layer(0)->numDrawCalls();
+
+  draw_lines = true;
+  editor.takeScreenshot();
+  REQUIRE(drawn_canvas->layer(0)->numDrawCalls() == background_draws + 2);
+}
+
+TEST_CASE("SDF shape batching matches per type shaders", "[integration]") {
+  static constexpr int kWidth = 200;
+  static constexpr int kHeight = 40;
+  static constexpr int kNumKnobs = 20;
+
+  bool sdf_batching = false;
+  Canvas* drawn_canvas = nullptr;
+  ApplicationEditor editor;
+  editor.onDraw() = [&](Canvas& canvas) {
+    drawn_canvas = &canvas;
+    canvas.setSdfShapeBatching(sdf_batching);
+    canvas.setColor(0xff223344);
+    canvas.fill(0, 0, editor.width(), editor.height());
+    for (int i = 0; i < kNumKnobs; ++i) {
+      float x = i * 9.0f;
+      canvas.setColor(0xff445566);
+      canvas.roundedRectangle(x, 2, 14, 14, 3);
+      canvas.setColor(0xff88aacc);
+      canvas.circle(x + 2, 4, 10);
+      canvas.setColor(0xffeeddcc);
+      canvas.roundedArc(x, 2, 14, 2, 0.0f, 2.5f);
+      canvas.flatArc(x, 20, 14, 2, 1.0f, 2.0f);
+      canvas.diamond(x + 2, 22, 10, 2);
+      canvas.segment(x, 38, x + 12, 30, 1.5f, true);
+    }
+  };
+
+  editor.setWindowless(kWidth, kHeight);
+  Screenshot per_type = editor.takeScreenshot();
+  REQUIRE(drawn_canvas);
+  int per_type_draws = drawn_canvas->layer(0)->numDrawCalls();
+
+  sdf_batching = true;
+  Screenshot sdf = editor.takeScreenshot();
+  int sdf_draws = drawn_canvas->layer(0)->numDrawCalls();
+  REQUIRE(sdf_draws * 10 <= per_type_draws);
+
+  REQUIRE(sdf.width() == per_type.width());
+  REQUIRE(sdf.height() == per_type.height());
+  for (int i = 0; i < kWidth * kHeight * 4; ++i)
+    REQUIRE(std::abs(sdf.data()[i] - per_type.data()[i]) <= 2);
+}
+
+TEST_CASE("Batches larger than one draw are submitted in chunks", "[integration]") {
+  static constexpr int kWidth = 400;
+  static constexpr int kHeight = 250;
+
+  Canvas* drawn_canvas = nullptr;
+  ApplicationEditor editor;
+  editor.onDraw() = [&](Canvas& canvas) {
+    drawn_canvas = &canvas;
+    canvas.setColor(0xff000000);
+    canvas.fill(0, 0, editor.width(), editor.height());
+    // SDF shapes always take the quad path so the batch has to be split on the index range.
+    canvas.setSdfShapeBatching(true);
+    canvas.setColor(0xff00ff00);
+    for (int y = 0; y < kHeight; ++y) {
+      for (int x = 0; x < kWidth; ++x)
+        canvas.fill(x, y, 1, 1);
+    }
+  };
+
+  editor.setWindowless(kWidth, kHeight);
+  Screenshot screenshot = editor.takeScreenshot();
+  REQUIRE(drawn_canvas);
+  REQUIRE(drawn_canvas->layer(0)->numDrawCalls() > kWidth * kHeight / kMaxQuadsPerDraw);
+
+  for (int i = 0; i < kWidth * kHeight; ++i) {
+    REQUIRE(screenshot.data()[i * 4] == 0);
+    REQUIRE(screenshot.data()[i * 4 + 1] == 0xff);
+  }
+}
+
+TEST_CASE("Text larger than one draw keeps its blend mode in every chunk", "[integration]") {
+  static constexpr int kWidth = 400;
+  static constexpr int kHeight = 250;
+  static constexpr int kLineHeight = 10;
+  static constexpr int kNumPasses = 80;
+
+  Font font(kLineHeight, fonts::Lato_Regular_ttf);
+  String line(std::u32string(50, U'M'));
+  Canvas* drawn_canvas = nullptr;
+  ApplicationEditor editor;
+  editor.onDraw() = [&](Canvas& canvas) {
+    drawn_canvas = &canvas;
+    canvas.setColor(0xff000000);
+    canvas.fill(0, 0, editor.width(), editor.height());
+    // Fully transparent text only leaves the background untouched when every chunk blends.
+    canvas.setColor(0x00ffffff);
+    for (int pass = 0; pass < kNumPasses; ++pass) {
+      for (int y = 0; y < kHeight; y += kLineHeight)
+        canvas.text(line, font, Font::kLeft, 0, y, kWidth, kLineHeight);
+    }
+  };
+
+  editor.setWindowless(kWidth, kHeight);
+  Screenshot screenshot = editor.takeScreenshot();
+  REQUIRE(drawn_canvas);
+  REQUIRE(drawn_canvas->layer(0)->numDrawCalls() > 2);
+
+  for (int i = 0; i < kWidth * kHeight; ++i) {
+    REQUIRE(screenshot.data()[i * 4] == 0);
+    REQUIRE(screenshot.data()[i * 4 + 1] == 0);
+    REQUIRE(screenshot.data()[i * 4 + 2] == 0);
+  }
+}
+
+TEST_CASE("Caching another frame keeps cached frames from redrawing", "[integration]") {
+  Frame circle;
+  Frame rounded;
+  Frame panel;
+  circle.setCached(true);
+  rounded.setCached(true);
+  circle.onDraw() = [&circle](Canvas& canvas) {
+    canvas.setColor(0xffff0000);
+    canvas.circle(0, 0, circle.width());
+  };
+  rounded.onDraw() = [&rounded](Canvas& canvas) {
+    canvas.setColor(0xff0000ff);
+    canvas.roundedRectangle(0, 0, rounded.width(), rounded.height(), 8);
+  };
+  panel.onDraw() = [&panel](Canvas& canvas) {
+    canvas.setColor(0xff00ff00);
+    canvas.fill(0, 0, panel.width(), panel.height());
+  };
+
+  Canvas* drawn_canvas = nullptr;
+  ApplicationEditor editor;
+  editor.onDraw() = [&](Canvas& canvas) {
+    drawn_canvas = &canvas;
+    canvas.setColor(0xff000000);
+    canvas.fill(0, 0, editor.width(), editor.height());
+  };
+  editor.addChild(circle);
+  editor.addChild(rounded);
+  editor.addChild(panel);
+  circle.setBounds(0, 0, 100, 100);
+  rounded.setBounds(100, 0, 100, 100);
+  panel.setBounds(0, 100, 250, 200);
+
+  editor.setWindowless(400, 300);
+  editor.takeScreenshot();
+  REQUIRE(drawn_canvas);
+  if (!Renderer::instance().blitSupported())
+    return;
+
+  int cached_draws = drawn_canvas->layer(1)->numDrawCalls();
+
+  // The panel doesn't fit next to the others, so the cached layer has to grow.
+  panel.setCached(true);
+  Screenshot screenshot = editor.takeScreenshot();
+  REQUIRE(drawn_canvas->layer(1)->numDrawCalls() < cached_draws);
+
+  auto pixel = [&screenshot](int x, int y) { return screenshot.data() + (y * 400 + x) * 4; };
+  REQUIRE(pixel(50, 50)[0] == 0xff);
+  REQUIRE(pixel(50, 50)[2] == 0);
+  REQUIRE(pixel(150, 50)[0] == 0);
+  REQUIRE(pixel(150, 50)[2] == 0xff);
+  REQUIRE(pixel(100, 200)[1] == 0xff);
+}
+
+TEST_CASE("Opaque pages hide the frames underneath", "[integration]") {
+  static constexpr int kWidth = 200;
+  static constexpr int kHeight = 100;
+  static constexpr int kNumDots = 40;
+
+  auto draw_page = [](Frame& page, Color color, int num_dots) {
+    page.onDraw() = [&page, color, num_dots](Canvas& canvas) {
+      canvas.setColor(color);
+      canvas.fill(0, 0, page.width(), page.height());
+      canvas.setColor(0xffeeeeee);
+      for (int i = 0; i < num_dots; ++i)
+        canvas.circle((i * 7) % page.width(), (i * 3) % page.height(), 2);
+    };
+  };
+
+  Frame panel;
+  Frame back_page;
+  Frame front_page;
+  draw_page(panel, 0xff223344, kNumDots);
+  draw_page(back_page, 0xff445566, kNumDots);
+  draw_page(front_page, 0xff88aacc, 0);
+
+  Canvas* drawn_canvas = nullptr;
+  ApplicationEditor editor;
+  editor.onDraw() = [&](Canvas& canvas) {
+    drawn_canvas = &canvas;
+    canvas.setColor(0xff000000);
+    canvas.fill(0, 0, editor.width(), editor.height());
+  };
+  for (Frame* page : { &panel, &back_page, &front_page }) {
+    editor.addChild(page);
+    page->setBounds(0, 0, kWidth, kHeight);
+  }
+
+  editor.setWindowless(kWidth, kHeight);
+  editor.takeScreenshot();
+  REQUIRE(drawn_canvas);
+  int all_shapes = drawn_canvas->layer(0)->numSubmittedShapes();
+  REQUIRE(all_shapes >= 2 * (kNumDots + 1) + 2);
+
+  back_page.setOpaque(true);
+  front_page.setOpaque(true);
+  Screenshot screenshot = editor.takeScreenshot();
+  REQUIRE(drawn_canvas->layer(0)->numSubmittedShapes() <= all_shapes - 2 * (kNumDots + 1) - 1);
+
+  for (int i = 0; i < kWidth * kHeight; ++i) {
+    REQUIRE(screenshot.data()[i * 4] == 0x88);
+    REQUIRE(screenshot.data()[i * 4 + 1] == 0xaa);
+    REQUIRE(screenshot.data()[i * 4 + 2] == 0xcc);
+  }
+}
+
+TEST_CASE("Static frames under redrawing frames get cached automatically", "[integration]") {
+  static constexpr int kNumDots = 200;
+
+  Frame waveform;
+  Frame playhead;
+  waveform.onDraw() = [&waveform](Canvas& canvas) {
+    canvas.setColor(0xff88aacc);
+    for (int i = 0; i < kNumDots; ++i)
+      canvas.circle(i % waveform.width(), (i * 7) % waveform.height(), 3);
+  };
+  playhead.onDraw() = [&playhead](Canvas& canvas) {
+    canvas.setColor(0xffffffff);
+    canvas.fill(0, 0, playhead.width(), playhead.height());
+  };
+
+  ApplicationEditor editor;
+  editor.addChild(waveform);
+  editor.addChild(playhead);
+  waveform.setBounds(0, 0, 200, 100);
+  playhead.setBounds(50, 0, 2, 100);
+
+  AutoCache& auto_cache = editor.autoCache();
+  auto_cache.setEnabled(true);
+  auto_cache.setPromoteAfter(3);
+  auto_cache.setDemoteAfter(2);
+
+  editor.setWindowless(200, 100);
+  editor.takeScreenshot();
+  for (int i = 0; i < 5; ++i) {
+    playhead.redraw();
+    editor.drawWindow();
+  }
+
+  REQUIRE(waveform.isAutoCached());
+  REQUIRE_FALSE(playhead.isAutoCached());
+  REQUIRE(auto_cache.numPromotions() == 1);
+  REQUIRE(auto_cache.shapesSaved() >= kNumDots - 1);
+  REQUIRE(auto_cache.usedBytes() > 0);
+
+  for (int i = 0; i < 2; ++i) {
+    waveform.redraw();
+    editor.drawWindow();
+  }
+  REQUIRE_FALSE(waveform.isAutoCached());
+  REQUIRE(auto_cache.numDemotions() == 1);
+  REQUIRE(auto_cache.usedBytes() == 0);
+}
+
+TEST_CASE("Async image decoding reserves space before pixels arrive", "[integration]") {
+  static constexpr char kSvg[] =
+      "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"16\" height=\"16\">"
+      "<rect width=\"16\" height=\"16\" fill=\"#ff0000\"/></svg>";
+
+  ApplicationEditor editor;
+  editor.setWindowless(10, 5);
+
+  ImageAtlas atlas;
+  atlas.setAsyncDecoding(true);
+  REQUIRE(atlas.asyncDecoding());
+
+  ImageAtlas::PackedImage image = atlas.addImage(Svg(kSvg, sizeof(kSvg) - 1, 24, 24));
+  REQUIRE(image.w() == 24);
+  REQUIRE(image.h() == 24);
+  REQUIRE_FALSE(image.loaded());
+  REQUIRE(atlas.numPendingImages() == 1);
+
+  ImageAtlas::PackedImage same_image = atlas.addImage(Svg(kSvg, sizeof(kSvg) - 1, 24, 24));
+  REQUIRE(same_image.packedImageRect() == image.packedImageRect());
+  REQUIRE(atlas.numPendingImages() == 1);
+
+  int num_uploaded = 0;
+  for (int i = 0; i < 1000 && num_uploaded == 0; ++i) {
+    num_uploaded = atlas.uploadDecodedImages();
+    if (num_uploaded == 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  REQUIRE(num_uploaded == 1);
+  REQUIRE(image.loaded());
+  REQUIRE(atlas.numPendingImages() == 0);
+}
@@ -60,6 +60,9 @@ namespace visage {
   }
 
   int Canvas::submit(int submit_pass) {
+    if (image_atlas_.uploadDecodedImages())
+      invalidateLoadedImages(&window_region_);
+
     int submission = submit_pass;
     for (int i = layers_.size() - 1; i > 0; --i)
       submission = layers_[i]->submit(submission);
@@ -73,6 +76,7 @@ namespace visage {
 
       render_frame_++;
       FontCache::clearStaleFonts();
+      brush_cache_.removeUnusedBrushes();
       gradient_atlas_.clearStaleGradients();
       image_atlas_.clearStaleImages();
     }
@@ -83,6 +87,19 @@ namespace visage {
     return submission;
   }
 
+  void Canvas::invalidateLoadedImages(Region* region) {
+    auto& pending = region->pending_images_;
+    auto loaded = std::remove_if(pending.begin(), pending.end(),
+                                 [](const ImageAtlas::PackedImage& image) { return image.loaded(); });
+    if (loaded != pending.end()) {
+      pending.erase(loaded, pending.end());
+      region->invalidate();
+    }
+
+    for (Region* sub_region : region->sub_regions_)
+      invalidateLoadedImages(sub_region);
+  }
+
   void Canvas::requestScreenshot() {
     composite_layer_.requestScreenshot();
   }
@@ -98,12 +98,14 @@ namespace visage {
 
     void setBlendMode(BlendMode blend_mode) { state_.blend_mode = blend_mode; }
     void setBrush(const Brush& brush) {
-      state_.brush = state_.current_region->addBrush(&gradient_atlas_, brush.gradient(),
-                                                     brush.position() * state_.scale);
+      state_.brush = state_.current_region->addBrush(
+          brush_cache_.brush(brush.gradient(), brush.position() * state_.scale));
     }
     void setColor(const Brush& brush) { setBrush(brush); }
-    void setColor(unsigned int color) { setBrush(Brush::solid(color)); }
-    void setColor(const Color& color) { setBrush(Brush::solid(color)); }
+    void setColor(unsigned int color) { setColor(Color(color)); }
+    void setColor(const Color& color) {
+      state_.brush = state_.current_region->addBrush(brush_cache_.solidBrush(color));
+    }
     void setColor(theme::ColorId color_id) { setBrush(color(color_id)); }
 
     void setBlendedColor(theme::ColorId color_from, theme::ColorId color_to, float t) {
@@ -477,7 +479,13 @@ namespace visage {
       state_.current_region = region;
     }
 
-    void endRegion() { restoreState(); }
+    void endRegion() {
+      state_.current_region->checkFlattenedOut();
+      restoreState();
+    }
+
+    void setSdfShapeBatching(bool sdf_shape_batching) { sdf_shape_batching_ = sdf_shape_batching; }
+    bool sdfShapeBatching() const { return sdf_shape_batching_; }
 
     void setPalette(Palette* palette) { palette_ = palette; }
     void setPaletteOverride(theme::OverrideId override_id) {
@@ -513,6 +521,7 @@ namespace visage {
 
     ImageAtlas* imageAtlas() { return &image_atlas_; }
     GradientAtlas* gradientAtlas() { return &gradient_atlas_; }
+    BrushCache* brushCache() { return &brush_cache_; }
 
     State* state() { return &state_; }
 
@@ -528,6 +537,12 @@ namespace visage {
 
     template<typename T>
     void addShape(T shape) {
+      if constexpr (HasSdfKind<T>::value) {
+        if (sdf_shape_batching_) {
+          state_.current_region->shape_batcher_.addShape(SdfShape(shape), state_.blend_mode);
+          return;
+        }
+      }
       state_.current_region->shape_batcher_.addShape(std::move(shape), state_.blend_mode);
     }
 
@@ -721,26 +736,36 @@ namespace visage {
     }
 
     void addSvg(const Svg& svg, float x, float y) {
-      addShape(ImageWrapper(state_.clamp, state_.brush, state_.x + x, state_.y + y, svg.width,
-                            svg.height, svg, imageAtlas()));
+      addImageWrapper(ImageWrapper(state_.clamp, state_.brush, state_.x + x, state_.y + y,
+                                   svg.width, svg.height, svg, imageAtlas()));
     }
 
     void addImage(const Image& image, float x, float y) {
-      addShape(ImageWrapper(state_.clamp, state_.brush, state_.x + x, state_.y + y, image.width,
-                            image.height, image, imageAtlas()));
+      addImageWrapper(ImageWrapper(state_.clamp, state_.brush, state_.x + x, state_.y + y,
+                                   image.width, image.height, image, imageAtlas()));
+    }
+
+    void addImageWrapper(ImageWrapper image) {
+      if (image_atlas_.asyncDecoding() && !image.packed_image.loaded())
+        state_.current_region->pending_images_.push_back(image.packed_image);
+      addShape(std::move(image));
     }
 
+    void invalidateLoadedImages(Region* region);
+
     Palette* palette_ = nullptr;
     float dpi_scale_ = 1.0f;
     double render_time_ = 0.0;
     double delta_time_ = 0.0;
     int render_frame_ = 0;
+    bool sdf_shape_batching_ = false;
     int last_skipped_frame_ = 0;
 
     std::vector<State> state_memory_;
     State state_;
 
     GradientAtlas gradient_atlas_;
+    BrushCache brush_cache_ { &gradient_atlas_ };
     ImageAtlas image_atlas_;
 
     Region window_region_;
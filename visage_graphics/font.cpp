@@ -27,6 +27,7 @@
 #include <bgfx/bgfx.h>
 #include <freetype/freetype.h>
 #include <set>
+#include <string_view>
 #include <vector>
 
 namespace visage {
@@ -102,61 +103,216 @@ namespace visage {
     FT_Face face_ = nullptr;
   };
 
-  class PackedFont {
+  // Glyphs for the basic multilingual plane live in 256 entry pages indexed directly by
+  // character, allocated the first time a character in the page is used. Characters outside
+  // of it, mostly emoji, fall back to a hash map. Entries never move once created.
+  class GlyphTable {
   public:
-    PackedFont(int size, const unsigned char* data, int data_size) : size_(size), data_(data) {
-      std::unique_ptr<TypeFace> face = std::make_unique<TypeFace>(size, data, data_size);
-      std::unique_ptr<PackedGlyph[]> glyphs = std::make_unique<PackedGlyph[]>(face->numGlyphs());
-      type_faces_.push_back(std::move(face));
-
-      packed_glyphs_['\n'] = Font::kNullPackedGlyph;
+    static constexpr int kPageBits = 8;
+    static constexpr int kPageSize = 1 << kPageBits;
+    static constexpr int kNumPages = 0x10000 / kPageSize;
+
+    PackedGlyph* glyph(char32_t character) {
+      if (character >= kNumPages * kPageSize)
+        return &astral_glyphs_[character];
+
+      std::unique_ptr<PackedGlyph[]>& page = pages_[character >> kPageBits];
+      if (page == nullptr)
+        page = std::make_unique<PackedGlyph[]>(kPageSize);
+      return &page[character & (kPageSize - 1)];
     }
 
-    ~PackedFont() {
-      if (bgfx::isValid(texture_handle_))
-        bgfx::destroy(texture_handle_);
+    template<typename F>
+    void forEach(F&& function) {
+      for (int p = 0; p < kNumPages; ++p) {
+        if (pages_[p] == nullptr)
+          continue;
+
+        for (int i = 0; i < kPageSize; ++i)
+          function(static_cast<char32_t>(p * kPageSize + i), pages_[p][i]);
+      }
+
+      for (auto& glyph : astral_glyphs_)
+        function(glyph.first, glyph.second);
     }
 
-    void resize() {
+  private:
+    std::unique_ptr<PackedGlyph[]> pages_[kNumPages];
+    std::unordered_map<char32_t, PackedGlyph> astral_glyphs_;
+  };
+
+  class FontAtlasPage {
+  public:
+    FontAtlasPage(bgfx::TextureFormat::Enum format, int channels) :
+        format_(format), channels_(channels) { }
+
+    ~FontAtlasPage() { destroyTexture(); }
+
+    void destroyTexture() {
       if (bgfx::isValid(texture_handle_)) {
         bgfx::destroy(texture_handle_);
         texture_handle_ = BGFX_INVALID_HANDLE;
       }
+    }
+
+    bool addRect(char32_t character, int width, int height) {
+      return atlas_map_.addRect(character, width, height);
+    }
 
+    void pack() {
+      destroyTexture();
       atlas_map_.pack();
-      for (auto& glyph : packed_glyphs_) {
-        if (glyph.second.width == 0)
-          continue;
+      width_ = std::max(1, atlas_map_.width());
+      height_ = std::max(1, atlas_map_.height());
+      pixels_ = std::make_unique<unsigned char[]>(width_ * height_ * channels_);
+      markDirty(0, 0, width_, height_);
+    }
+
+    // Returns false if every glyph moved and needs to be rasterized again.
+    bool grow() {
+      int old_width = width_;
+      int old_height = height_;
+      std::unique_ptr<unsigned char[]> old_pixels = std::move(pixels_);
+      bool kept_placements = atlas_map_.grow();
+      width_ = std::max(1, atlas_map_.width());
+      height_ = std::max(1, atlas_map_.height());
+      pixels_ = std::make_unique<unsigned char[]>(width_ * height_ * channels_);
+      destroyTexture();
+      markDirty(0, 0, width_, height_);
+      if (!kept_placements || old_pixels == nullptr)
+        return false;
+
+      for (int y = 0; y < old_height; ++y) {
+        const unsigned char* row = old_pixels.get() + y * old_width * channels_;
+        std::copy(row, row + old_width * channels_, pixels_.get() + y * width_ * channels_);
+      }
+      return true;
+    }
+
+    const PackedRect& rectForId(char32_t character) const { return atlas_map_.rectForId(character); }
+    unsigned char* pixels() { return pixels_.get(); }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int channels() const { return channels_; }
+    int numBytes() const { return pixels_ ? width_ * height_ * channels_ : 0; }
+    bool staged() const { return dirty_right_ > dirty_left_ && dirty_bottom_ > dirty_top_; }
+    int numUploads() const { return num_uploads_; }
+
+    void markDirty(int x, int y, int width, int height) {
+      if (!staged()) {
+        dirty_left_ = x;
+        dirty_top_ = y;
+        dirty_right_ = x + width;
+        dirty_bottom_ = y + height;
+        return;
+      }
+
+      dirty_left_ = std::min(dirty_left_, x);
+      dirty_top_ = std::min(dirty_top_, y);
+      dirty_right_ = std::max(dirty_right_, x + width);
+      dirty_bottom_ = std::max(dirty_bottom_, y + height);
+    }
 
-        const PackedRect& rect = atlas_map_.rectForId(glyph.first);
-        glyph.second.atlas_left = rect.x;
-        glyph.second.atlas_top = rect.y;
+    bgfx::TextureHandle& textureHandle() {
+      if (pixels_ == nullptr) {
+        width_ = height_ = 1;
+        pixels_ = std::make_unique<unsigned char[]>(width_ * height_ * channels_);
+      }
+
+      if (!bgfx::isValid(texture_handle_)) {
+        texture_handle_ = bgfx::createTexture2D(width_, height_, false, 1, format_);
+        markDirty(0, 0, width_, height_);
       }
+
+      if (staged()) {
+        int pitch = width_ * channels_;
+        int offset = dirty_top_ * pitch + dirty_left_ * channels_;
+        int size = (dirty_bottom_ - dirty_top_ - 1) * pitch + (dirty_right_ - dirty_left_) * channels_;
+        bgfx::updateTexture2D(texture_handle_, 0, 0, dirty_left_, dirty_top_, dirty_right_ - dirty_left_,
+                              dirty_bottom_ - dirty_top_, bgfx::copy(pixels_.get() + offset, size), pitch);
+        num_uploads_++;
+        dirty_left_ = dirty_top_ = dirty_right_ = dirty_bottom_ = 0;
+      }
+
+      return texture_handle_;
+    }
+
+  private:
+    PackedAtlasMap<char32_t> atlas_map_;
+    bgfx::TextureFormat::Enum format_;
+    int channels_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    std::unique_ptr<unsigned char[]> pixels_;
+    int dirty_left_ = 0;
+    int dirty_top_ = 0;
+    int dirty_right_ = 0;
+    int dirty_bottom_ = 0;
+    int num_uploads_ = 0;
+    bgfx::TextureHandle texture_handle_ = BGFX_INVALID_HANDLE;
+  };
+
+  class PackedFont {
+  public:
+    static constexpr int kEmojiChannels = 4;
+
+    PackedFont(int size, const unsigned char* data, int data_size) :
+        size_(size), data_(data), glyph_page_(bgfx::TextureFormat::R8, 1),
+        emoji_page_(bgfx::TextureFormat::BGRA8, kEmojiChannels) {
+      std::unique_ptr<TypeFace> face = std::make_unique<TypeFace>(size, data, data_size);
+      std::unique_ptr<PackedGlyph[]> glyphs = std::make_unique<PackedGlyph[]>(face->numGlyphs());
+      type_faces_.push_back(std::move(face));
+
+      *packed_glyphs_.glyph('\n') = Font::kNullPackedGlyph;
+    }
+
+    // Returns true if the glyphs kept their places, otherwise every glyph was rasterized again
+    bool resize(FontAtlasPage& page) {
+      if (page.grow())
+        return true;
+
+      packed_glyphs_.forEach([this, &page](char32_t character, PackedGlyph& glyph) {
+        if (glyph.width <= 0 || &atlasPage(&glyph) != &page)
+          return;
+
+        const PackedRect& rect = page.rectForId(character);
+        glyph.atlas_left = rect.x;
+        glyph.atlas_top = rect.y;
+        rasterizeGlyph(character, &glyph);
+      });
+      return false;
+    }
+
+    FontAtlasPage& atlasPage(const PackedGlyph* packed_glyph) {
+      return packed_glyph->type_face ? glyph_page_ : emoji_page_;
     }
 
     void rasterizeGlyph(char32_t character, const PackedGlyph* packed_glyph) {
-      int size = packed_glyph->width * packed_glyph->height;
-      if (size == 0)
+      if (packed_glyph->width * packed_glyph->height == 0)
+        return;
+
+      FontAtlasPage& page = atlasPage(packed_glyph);
+      if (page.pixels() == nullptr)
         return;
 
-      std::unique_ptr<unsigned int[]> texture = std::make_unique<unsigned int[]>(size);
       if (packed_glyph->type_face) {
         FT_GlyphSlot glyph = packed_glyph->type_face->characterRasterData(character);
         for (int y = 0; y < packed_glyph->height; ++y) {
-          for (int x = 0; x < packed_glyph->width; ++x) {
-            int i = y * packed_glyph->width + x;
-            texture[i] = ((glyph->bitmap.buffer[y * packed_glyph->width + x]) << 24) + 0xffffff;
-          }
+          unsigned char* row = page.pixels() + (packed_glyph->atlas_top + y) * page.width() +
+                               packed_glyph->atlas_left;
+          std::copy(glyph->bitmap.buffer + y * packed_glyph->width,
+                    glyph->bitmap.buffer + (y + 1) * packed_glyph->width, row);
         }
       }
       else {
-        EmojiRasterizer::instance().drawIntoBuffer(character, size_, packed_glyph->width,
-                                                   texture.get(), packed_glyph->width, 0, 0);
+        unsigned int* pixels = reinterpret_cast<unsigned int*>(page.pixels());
+        EmojiRasterizer::instance().drawIntoBuffer(character, size_, packed_glyph->width, pixels,
+                                                   page.width(), packed_glyph->atlas_left,
+                                                   packed_glyph->atlas_top);
       }
 
-      bgfx::updateTexture2D(texture_handle_, 0, 0, packed_glyph->atlas_left,
-                            packed_glyph->atlas_top, packed_glyph->width, packed_glyph->height,
-                            bgfx::copy(texture.get(), size * ImageAtlas::kChannels));
+      page.markDirty(packed_glyph->atlas_left, packed_glyph->atlas_top, packed_glyph->width,
+                     packed_glyph->height);
     }
 
     PackedGlyph* packCharacterGlyph(PackedGlyph* packed_glyph, const TypeFace* type_face, char32_t character) {
@@ -187,7 +343,7 @@ namespace visage {
     }
 
     const PackedGlyph* packedGlyph(char32_t character) {
-      PackedGlyph* packed_glyph = &packed_glyphs_[character];
+      PackedGlyph* packed_glyph = packed_glyphs_.glyph(character);
       if (packed_glyph->atlas_left >= 0)
         return packed_glyph;
 
@@ -199,48 +355,39 @@ namespace visage {
       return packEmojiGlyph(packed_glyph, character);
     }
 
-    void checkInit() {
-      if (!bgfx::isValid(texture_handle_)) {
-        texture_handle_ = bgfx::createTexture2D(atlas_map_.width(), atlas_map_.height(), false, 1,
-                                                bgfx::TextureFormat::BGRA8);
-        int width = atlas_map_.width();
-        int height = atlas_map_.height();
-        std::unique_ptr<unsigned int[]> clear = std::make_unique<unsigned int[]>(width * height);
-        bgfx::updateTexture2D(texture_handle_, 0, 0, 0, 0, width, height,
-                              bgfx::copy(clear.get(), width * height * ImageAtlas::kChannels));
-
-        for (auto& glyph : packed_glyphs_)
-          rasterizeGlyph(glyph.first, &glyph.second);
-      }
-    }
-
-    int atlasWidth() const { return atlas_map_.width(); }
-    int atlasHeight() const { return atlas_map_.width(); }
-    bgfx::TextureHandle& textureHandle() { return texture_handle_; }
+    int atlasWidth() const { return glyph_page_.width(); }
+    int atlasHeight() const { return glyph_page_.height(); }
+    int emojiAtlasWidth() const { return emoji_page_.width(); }
+    int emojiAtlasHeight() const { return emoji_page_.height(); }
+    int atlasBytes() const { return glyph_page_.numBytes() + emoji_page_.numBytes(); }
+    int numStagedUploads() const { return glyph_page_.staged() + emoji_page_.staged(); }
+    int numUploads() const { return glyph_page_.numUploads() + emoji_page_.numUploads(); }
+    bgfx::TextureHandle& textureHandle() { return glyph_page_.textureHandle(); }
+    bgfx::TextureHandle& emojiTextureHandle() { return emoji_page_.textureHandle(); }
     int lineHeight() const { return type_faces_[0]->lineHeight(); }
     int size() const { return size_; }
     const unsigned char* data() const { return data_; }
 
   private:
     void packGlyph(PackedGlyph* packed_glyph, char32_t character) {
-      if (!atlas_map_.addRect(character, packed_glyph->width, packed_glyph->height))
-        resize();
+      FontAtlasPage& page = atlasPage(packed_glyph);
+      bool added = page.addRect(character, packed_glyph->width, packed_glyph->height) ||
+                   resize(page);
 
-      const PackedRect& rect = atlas_map_.rectForId(character);
+      const PackedRect& rect = page.rectForId(character);
       packed_glyph->atlas_left = rect.x;
       packed_glyph->atlas_top = rect.y;
-
-      if (bgfx::isValid(texture_handle_))
+      if (added)
         rasterizeGlyph(character, packed_glyph);
     }
 
-    PackedAtlasMap<char32_t> atlas_map_;
     std::vector<std::unique_ptr<TypeFace>> type_faces_;
     int size_ = 0;
     const unsigned char* data_ = nullptr;
 
-    std::map<char32_t, PackedGlyph> packed_glyphs_;
-    bgfx::TextureHandle texture_handle_ = { bgfx::kInvalidHandle };
+    GlyphTable packed_glyphs_;
+    FontAtlasPage glyph_page_;
+    FontAtlasPage emoji_page_;
   };
 
   bool Font::hasNewLine(const char32_t* string, int length) {
@@ -462,11 +609,34 @@ namespace visage {
     return packed_font_->atlasHeight();
   }
 
+  int Font::emojiAtlasWidth() const {
+    return packed_font_->emojiAtlasWidth();
+  }
+
+  int Font::emojiAtlasHeight() const {
+    return packed_font_->emojiAtlasHeight();
+  }
+
+  int Font::atlasBytes() const {
+    return packed_font_->atlasBytes();
+  }
+
+  int Font::numStagedAtlasUploads() const {
+    return packed_font_->numStagedUploads();
+  }
+
+  int Font::numAtlasUploads() const {
+    return packed_font_->numUploads();
+  }
+
   const bgfx::TextureHandle& Font::textureHandle() const {
-    packed_font_->checkInit();
     return packed_font_->textureHandle();
   }
 
+  const bgfx::TextureHandle& Font::emojiTextureHandle() const {
+    return packed_font_->emojiTextureHandle();
+  }
+
   FontCache::FontCache() {
     FreeTypeLibrary::instance();
   }
@@ -481,27 +651,120 @@ namespace visage {
     if (cache_.count(font_info) == 0)
       cache_[font_info] = std::make_unique<PackedFont>(size, data, data_size);
 
-    ref_count_[cache_[font_info].get()]++;
-    return cache_[font_info].get();
+    PackedFont* packed_font = cache_[font_info].get();
+    if (ref_count_[packed_font]++ == 0)
+      stale_fonts_.remove(packed_font);
+    return packed_font;
   }
 
   void FontCache::decrementPackedFont(PackedFont* packed_font) {
     VISAGE_ASSERT(Thread::isMainThread());
     ref_count_[packed_font]--;
     int count = ref_count_[packed_font];
-    has_stale_fonts_ = has_stale_fonts_ || count == 0;
+    if (count == 0) {
+      stale_fonts_.add(packed_font, packed_font->atlasBytes());
+      has_stale_fonts_ = true;
+    }
     VISAGE_ASSERT(ref_count_[packed_font] >= 0);
   }
 
+  size_t FontCache::usedBytes() {
+    size_t bytes = 0;
+    for (const auto& font : instance()->cache_)
+      bytes += font.second->atlasBytes();
+    return bytes;
+  }
+
   void FontCache::removeStaleFonts() {
-    for (auto it = ref_count_.begin(); it != ref_count_.end();) {
-      if (it->second)
-        ++it;
-      else {
-        cache_.erase({ it->first->size(), it->first->data() });
-        it = ref_count_.erase(it);
+    size_t used_bytes = usedBytes();
+    stale_fonts_.evict(used_bytes, memory_budget_, [this](PackedFont* packed_font) {
+      TextLayoutCache::instance()->removeFont(packed_font);
+      ref_count_.erase(packed_font);
+      cache_.erase({ packed_font->size(), packed_font->data() });
+    });
+    // Stale fonts kept under budget are checked again since atlases can grow
+    has_stale_fonts_ = !stale_fonts_.empty();
+  }
+
+  const std::vector<FontAtlasQuad>& TextLayoutCache::layout(const Font& font, const char32_t* text,
+                                                            int length, float width, float height,
+                                                            Font::Justification justification,
+                                                            bool multi_line, int character_override) {
+    VISAGE_ASSERT(Thread::isMainThread());
+
+    uint64_t hash = std::hash<std::u32string_view>()(std::u32string_view(text, length));
+    hash = hashCombine(hash, std::hash<const PackedFont*>()(font.packedFont()));
+    hash = hashCombine(hash, std::hash<float>()(width));
+    hash = hashCombine(hash, std::hash<float>()(height));
+    hash = hashCombine(hash, justification);
+    hash = hashCombine(hash, multi_line);
+    hash = hashCombine(hash, character_override);
+
+    auto found = lookup_.find(hash);
+    if (found != lookup_.end()) {
+      Entry& entry = *found->second;
+      if (entry.packed_font == font.packedFont() && entry.width == width && entry.height == height &&
+          entry.justification == justification && entry.multi_line == multi_line &&
+          entry.character_override == character_override &&
+          entry.text.compare(0, entry.text.size(), text, length) == 0) {
+        hits_++;
+        entries_.splice(entries_.begin(), entries_, found->second);
+        return entry.quads;
       }
+
+      entries_.erase(found->second);
+      lookup_.erase(found);
+    }
+
+    misses_++;
+    entries_.emplace_front();
+    Entry& entry = entries_.front();
+    entry.hash = hash;
+    entry.packed_font = font.packedFont();
+    entry.text.assign(text, length);
+    entry.width = width;
+    entry.height = height;
+    entry.justification = justification;
+    entry.multi_line = multi_line;
+    entry.character_override = character_override;
+    entry.quads.resize(length);
+    if (multi_line)
+      font.setMultiLineVertexPositions(entry.quads.data(), text, length, 0, 0, width, height, justification);
+    else {
+      font.setVertexPositions(entry.quads.data(), text, length, 0, 0, width, height, justification,
+                              character_override);
+    }
+    lookup_[hash] = entries_.begin();
+
+    evict();
+    return entry.quads;
+  }
+
+  void TextLayoutCache::removeFont(const PackedFont* packed_font) {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      if (it->packed_font == packed_font) {
+        lookup_.erase(it->hash);
+        it = entries_.erase(it);
+      }
+      else
+        ++it;
+    }
+  }
+
+  void TextLayoutCache::clear() {
+    entries_.clear();
+    lookup_.clear();
+  }
+
+  void TextLayoutCache::setMaxEntries(int max_entries) {
+    max_entries_ = std::max(1, max_entries);
+    evict();
+  }
+
+  void TextLayoutCache::evict() {
+    while (numEntries() > max_entries_) {
+      lookup_.erase(entries_.back().hash);
+      entries_.pop_back();
     }
-    has_stale_fonts_ = false;
   }
-}
\ No newline at end of file
+}
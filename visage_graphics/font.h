@@ -25,7 +25,10 @@
 #include "graphics_utils.h"
 #include "visage_file_embed/embedded_file.h"
 
+#include <list>
 #include <map>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace visage {
@@ -118,10 +121,16 @@ namespace visage {
 
     int atlasWidth() const;
     int atlasHeight() const;
+    int emojiAtlasWidth() const;
+    int emojiAtlasHeight() const;
+    int atlasBytes() const;
+    int numStagedAtlasUploads() const;
+    int numAtlasUploads() const;
     int size() const { return size_; }
     const char* fontData() const { return font_data_; }
     int dataSize() const { return data_size_; }
     const bgfx::TextureHandle& textureHandle() const;
+    const bgfx::TextureHandle& emojiTextureHandle() const;
 
     void setVertexPositions(FontAtlasQuad* quads, const char32_t* string, int length, float x, float y,
                             float width, float height, Justification justification = Justification::kCenter,
@@ -161,6 +170,16 @@ namespace visage {
         instance()->removeStaleFonts();
     }
 
+    // Fonts nothing uses anymore keep their glyph atlases, least recently used ones evicted
+    // first, until all font atlases together take more than this many bytes.
+    static void setMemoryBudget(size_t bytes) {
+      instance()->memory_budget_ = bytes;
+      instance()->has_stale_fonts_ = true;
+    }
+    static size_t memoryBudget() { return instance()->memory_budget_; }
+    static size_t usedBytes();
+    static int numFonts() { return instance()->cache_.size(); }
+
   private:
     static FontCache* instance() {
       static FontCache cache;
@@ -187,6 +206,59 @@ namespace visage {
 
     std::map<std::pair<int, unsigned const char*>, std::unique_ptr<PackedFont>> cache_;
     std::map<PackedFont*, int> ref_count_;
+    StaleCache<PackedFont*> stale_fonts_;
+    size_t memory_budget_ = 0;
     bool has_stale_fonts_ = false;
   };
+
+  class TextLayoutCache {
+  public:
+    static constexpr int kDefaultMaxEntries = 2048;
+
+    static TextLayoutCache* instance() {
+      static TextLayoutCache cache;
+      return &cache;
+    }
+
+    const std::vector<FontAtlasQuad>& layout(const Font& font, const char32_t* text, int length,
+                                             float width, float height,
+                                             Font::Justification justification, bool multi_line,
+                                             int character_override);
+
+    void removeFont(const PackedFont* packed_font);
+    void clear();
+
+    void setMaxEntries(int max_entries);
+    int maxEntries() const { return max_entries_; }
+    int numEntries() const { return entries_.size(); }
+    int hits() const { return hits_; }
+    int misses() const { return misses_; }
+    void resetCounters() {
+      hits_ = 0;
+      misses_ = 0;
+    }
+
+  private:
+    struct Entry {
+      uint64_t hash = 0;
+      const PackedFont* packed_font = nullptr;
+      std::u32string text;
+      float width = 0.0f;
+      float height = 0.0f;
+      Font::Justification justification = Font::kCenter;
+      bool multi_line = false;
+      int character_override = 0;
+      std::vector<FontAtlasQuad> quads;
+    };
+
+    TextLayoutCache() = default;
+
+    void evict();
+
+    std::list<Entry> entries_;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> lookup_;
+    int max_entries_ = kDefaultMaxEntries;
+    int hits_ = 0;
+    int misses_ = 0;
+  };
 }
\ No newline at end of file
@@ -22,6 +22,7 @@
 #include "gradient.h"
 
 #include <bgfx/bgfx.h>
+#include <cstring>
 
 namespace visage {
   std::string Gradient::encode() const {
@@ -102,6 +103,7 @@ namespace visage {
   void GradientAtlas::resize() {
     texture_.reset();
     atlas_map_.pack();
+    generation_++;
 
     for (auto& gradient : gradients_) {
       const PackedRect& rect = atlas_map_.rectForId(gradient.second.get());
@@ -164,4 +166,78 @@ namespace visage {
     gradient_.decode(stream);
     position_.decode(stream);
   }
-}
\ No newline at end of file
+
+  static uint64_t floatBits(float value) {
+    uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  static bool samePosition(const GradientPosition& a, const GradientPosition& b) {
+    return a.shape == b.shape && a.point_from == b.point_from && a.point_to == b.point_to;
+  }
+
+  uint64_t BrushCache::hash(const Color& color) {
+    uint64_t result = hashCombine(floatBits(color.alpha()), floatBits(color.red()));
+    result = hashCombine(result, floatBits(color.green()));
+    result = hashCombine(result, floatBits(color.blue()));
+    return hashCombine(result, floatBits(color.hdr()));
+  }
+
+  uint64_t BrushCache::hash(const Gradient& gradient, const GradientPosition& position) {
+    uint64_t result = hashCombine(static_cast<uint64_t>(position.shape), gradient.resolution());
+    result = hashCombine(result, floatBits(position.point_from.x));
+    result = hashCombine(result, floatBits(position.point_from.y));
+    result = hashCombine(result, floatBits(position.point_to.x));
+    result = hashCombine(result, floatBits(position.point_to.y));
+    for (const Color& color : gradient.colors())
+      result = hashCombine(result, hash(color));
+    return result;
+  }
+
+  std::shared_ptr<const PackedBrush> BrushCache::solidBrush(const Color& color) {
+    auto& entry = solid_brushes_[hash(color)];
+    if (entry && Color::compare(entry->gradient()->gradient().colors()[0], color) == 0) {
+      num_hits_++;
+      return entry;
+    }
+
+    num_misses_++;
+    auto result = std::make_shared<const PackedBrush>(atlas_, Gradient(color), GradientPosition());
+    if (entry == nullptr)
+      entry = result;
+    return result;
+  }
+
+  std::shared_ptr<const PackedBrush> BrushCache::brush(const Gradient& gradient,
+                                                       const GradientPosition& position) {
+    if (position.shape == GradientPosition::InterpolationShape::Solid && gradient.resolution() == 1)
+      return solidBrush(gradient.colors()[0]);
+
+    auto& entry = brushes_[hash(gradient, position)];
+    if (entry && samePosition(entry->position(), position) &&
+        Gradient::compare(entry->gradient()->gradient(), gradient) == 0) {
+      num_hits_++;
+      return entry;
+    }
+
+    num_misses_++;
+    auto result = std::make_shared<const PackedBrush>(atlas_, gradient, position);
+    if (entry == nullptr)
+      entry = result;
+    return result;
+  }
+
+  void BrushCache::removeUnusedBrushes() {
+    auto remove_unused = [](auto& brushes) {
+      for (auto it = brushes.begin(); it != brushes.end();) {
+        if (it->second.use_count() == 1)
+          it = brushes.erase(it);
+        else
+          ++it;
+      }
+    };
+    remove_unused(solid_brushes_);
+    remove_unused(brushes_);
+  }
+}
@@ -27,6 +27,8 @@
 #include <functional>
 #include <iosfwd>
 #include <map>
+#include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -181,9 +183,10 @@ namespace visage {
         packed_gradient_rect->x = rect.x;
         packed_gradient_rect->y = rect.y;
         updateGradient(packed_gradient_rect.get());
+        used_bytes_ += gradientBytes(gradient);
         gradients_[gradient] = std::move(packed_gradient_rect);
       }
-      stale_gradients_.erase(gradient);
+      stale_gradients_.remove(gradient);
 
       if (auto reference = references_[gradient].lock())
         return PackedGradient(reference);
@@ -194,13 +197,19 @@ namespace visage {
     }
 
     void clearStaleGradients() {
-      for (const auto& stale : stale_gradients_) {
-        gradients_.erase(stale.first);
-        atlas_map_.removeRect(stale.second);
-      }
-      stale_gradients_.clear();
+      stale_gradients_.evict(used_bytes_, memory_budget_, [this](const Gradient& gradient) {
+        atlas_map_.removeRect(gradients_[gradient].get());
+        gradients_.erase(gradient);
+        references_.erase(gradient);
+      });
     }
 
+    // Gradients that are no longer drawn stay in the atlas, least recently used ones evicted
+    // first, until it holds more than this many bytes of gradients.
+    void setMemoryBudget(size_t bytes) { memory_budget_ = bytes; }
+    size_t memoryBudget() const { return memory_budget_; }
+    size_t usedBytes() const { return used_bytes_; }
+
     void checkInit();
     void destroy();
     void setHdr(bool hdr) {
@@ -209,6 +218,7 @@ namespace visage {
     }
     int width() const { return atlas_map_.width(); }
     int height() const { return atlas_map_.height(); }
+    int generation() const { return generation_; }
 
     const bgfx::TextureHandle& colorTextureHandle();
 
@@ -216,9 +226,13 @@ namespace visage {
     void updateGradient(const PackedGradientRect* gradient);
     void resize();
 
+    static size_t gradientBytes(const Gradient& gradient) {
+      return gradient.resolution() * sizeof(uint64_t);
+    }
+
     void removeGradient(const Gradient& gradient) {
       VISAGE_ASSERT(gradients_.count(gradient));
-      stale_gradients_[gradient] = gradients_[gradient].get();
+      stale_gradients_.add(gradient, gradientBytes(gradient));
     }
 
     void removeGradient(const PackedGradientRect* packed_gradient_rect) {
@@ -227,9 +241,12 @@ namespace visage {
 
     std::map<Gradient, std::weak_ptr<PackedGradientReference>> references_;
     std::map<Gradient, std::unique_ptr<PackedGradientRect>> gradients_;
-    std::map<Gradient, const PackedGradientRect*> stale_gradients_;
+    StaleCache<Gradient> stale_gradients_;
+    size_t used_bytes_ = 0;
+    size_t memory_budget_ = 0;
 
     bool hdr_ = false;
+    int generation_ = 0;
     PackedAtlasMap<const PackedGradientRect*> atlas_map_;
     std::unique_ptr<GradientAtlasTexture> texture_;
     std::shared_ptr<GradientAtlas*> reference_;
@@ -431,4 +448,36 @@ namespace visage {
 
     VISAGE_LEAK_CHECKER(PackedBrush)
   };
+
+  class BrushCache {
+  public:
+    static uint64_t hash(const Color& color);
+    static uint64_t hash(const Gradient& gradient, const GradientPosition& position);
+
+    explicit BrushCache(GradientAtlas* atlas) : atlas_(atlas) { }
+
+    std::shared_ptr<const PackedBrush> brush(const Gradient& gradient, const GradientPosition& position);
+    std::shared_ptr<const PackedBrush> brush(const Brush& brush) {
+      return this->brush(brush.gradient(), brush.position());
+    }
+    std::shared_ptr<const PackedBrush> solidBrush(const Color& color);
+    void removeUnusedBrushes();
+    void clear() {
+      solid_brushes_.clear();
+      brushes_.clear();
+    }
+
+    int numBrushes() const { return solid_brushes_.size() + brushes_.size(); }
+    int numHits() const { return num_hits_; }
+    int numMisses() const { return num_misses_; }
+
+  private:
+    GradientAtlas* atlas_ = nullptr;
+    std::unordered_map<uint64_t, std::shared_ptr<const PackedBrush>> solid_brushes_;
+    std::unordered_map<uint64_t, std::shared_ptr<const PackedBrush>> brushes_;
+    int num_hits_ = 0;
+    int num_misses_ = 0;
+
+    VISAGE_LEAK_CHECKER(BrushCache)
+  };
 }
\ No newline at end of file
@@ -183,4 +183,57 @@ namespace visage {
     cache_->cache[name] = bgfx::createUniform(name, bgfx_type, size);
     return cache_->cache[name];
   }
+
+  struct QuadBuffers {
+    bgfx::VertexBufferHandle unit_quad_vertices = BGFX_INVALID_HANDLE;
+    bgfx::IndexBufferHandle unit_quad_indices = BGFX_INVALID_HANDLE;
+    bgfx::IndexBufferHandle quad_indices = BGFX_INVALID_HANDLE;
+  };
+
+  QuadBufferCache::QuadBufferCache() {
+    buffers_ = std::make_unique<QuadBuffers>();
+  }
+
+  QuadBufferCache::~QuadBufferCache() {
+    if (bgfx::isValid(buffers_->unit_quad_vertices))
+      bgfx::destroy(buffers_->unit_quad_vertices);
+    if (bgfx::isValid(buffers_->unit_quad_indices))
+      bgfx::destroy(buffers_->unit_quad_indices);
+    if (bgfx::isValid(buffers_->quad_indices))
+      bgfx::destroy(buffers_->quad_indices);
+  }
+
+  const bgfx::VertexBufferHandle& QuadBufferCache::unitQuadVertices() const {
+    static const QuadCornerVertex kCorners[kVerticesPerQuad] = {
+      { -1.0f, -1.0f }, { 1.0f, -1.0f }, { -1.0f, 1.0f }, { 1.0f, 1.0f }
+    };
+
+    if (!bgfx::isValid(buffers_->unit_quad_vertices)) {
+      const bgfx::Memory* memory = bgfx::makeRef(kCorners, sizeof(kCorners));
+      buffers_->unit_quad_vertices = bgfx::createVertexBuffer(memory, QuadCornerVertex::layout());
+    }
+    return buffers_->unit_quad_vertices;
+  }
+
+  const bgfx::IndexBufferHandle& QuadBufferCache::unitQuadIndices() const {
+    if (!bgfx::isValid(buffers_->unit_quad_indices)) {
+      const bgfx::Memory* memory = bgfx::makeRef(kQuadTriangles, sizeof(kQuadTriangles));
+      buffers_->unit_quad_indices = bgfx::createIndexBuffer(memory);
+    }
+    return buffers_->unit_quad_indices;
+  }
+
+  const bgfx::IndexBufferHandle& QuadBufferCache::quadIndices() const {
+    if (!bgfx::isValid(buffers_->quad_indices)) {
+      int num_indices = kMaxQuadsPerDraw * kIndicesPerQuad;
+      const bgfx::Memory* memory = bgfx::alloc(num_indices * sizeof(uint16_t));
+      uint16_t* indices = reinterpret_cast<uint16_t*>(memory->data);
+      for (int i = 0; i < kMaxQuadsPerDraw; ++i) {
+        for (int v = 0; v < kIndicesPerQuad; ++v)
+          indices[i * kIndicesPerQuad + v] = i * kVerticesPerQuad + kQuadTriangles[v];
+      }
+      buffers_->quad_indices = bgfx::createIndexBuffer(memory);
+    }
+    return buffers_->quad_indices;
+  }
 }
\ No newline at end of file
@@ -28,6 +28,7 @@ namespace visage {
   struct ShaderCacheMap;
   struct ProgramCacheMap;
   struct UniformCacheMap;
+  struct QuadBuffers;
   struct EmbeddedFile;
 
   class ShaderCache {
@@ -148,4 +149,32 @@ namespace visage {
 
     std::unique_ptr<UniformCacheMap> cache_;
   };
+
+  // Static geometry shared by every quad draw
+  class QuadBufferCache {
+  public:
+    static QuadBufferCache* instance() {
+      static QuadBufferCache cache;
+      return &cache;
+    }
+
+    static const bgfx::VertexBufferHandle& unitQuadVertexBuffer() {
+      return instance()->unitQuadVertices();
+    }
+    static const bgfx::IndexBufferHandle& unitQuadIndexBuffer() {
+      return instance()->unitQuadIndices();
+    }
+    // Indices for kMaxQuadsPerDraw consecutive quads, draws bind as many as they need
+    static const bgfx::IndexBufferHandle& quadIndexBuffer() { return instance()->quadIndices(); }
+
+  private:
+    QuadBufferCache();
+    ~QuadBufferCache();
+
+    const bgfx::VertexBufferHandle& unitQuadVertices() const;
+    const bgfx::IndexBufferHandle& unitQuadIndices() const;
+    const bgfx::IndexBufferHandle& quadIndices() const;
+
+    std::unique_ptr<QuadBuffers> buffers_;
+  };
 }
\ No newline at end of file
@@ -256,8 +256,26 @@ namespace visage {
 
 namespace visage {
   struct PackedAtlasData {
-    stbrp_context pack_context {};
-    std::unique_ptr<stbrp_node[]> pack_nodes;
+    struct Area {
+      int x = 0;
+      int y = 0;
+      stbrp_context pack_context {};
+      std::unique_ptr<stbrp_node[]> pack_nodes;
+    };
+
+    void addArea(int x, int y, int width, int height) {
+      if (width <= 0 || height <= 0)
+        return;
+
+      auto area = std::make_unique<Area>();
+      area->x = x;
+      area->y = y;
+      area->pack_nodes = std::make_unique<stbrp_node[]>(width);
+      stbrp_init_target(&area->pack_context, width, height, area->pack_nodes.get(), width);
+      areas.push_back(std::move(area));
+    }
+
+    std::vector<std::unique_ptr<Area>> areas;
   };
 
   AtlasPacker::AtlasPacker() : data_(std::make_unique<PackedAtlasData>()) { }
@@ -273,12 +291,14 @@ namespace visage {
     r.h = rect.h + padding_;
     r.id = rect_index_++;
 
-    packed_ = stbrp_pack_rects(&data_->pack_context, &r, 1);
-    if (packed_) {
-      rect.x = r.x;
-      rect.y = r.y;
+    for (auto& area : data_->areas) {
+      if (stbrp_pack_rects(&area->pack_context, &r, 1)) {
+        rect.x = r.x + area->x;
+        rect.y = r.y + area->y;
+        return true;
+      }
     }
-    return packed_;
+    return false;
   }
 
   void AtlasPacker::clear() {
@@ -286,7 +306,8 @@ namespace visage {
   }
 
   bool AtlasPacker::pack(std::vector<PackedRect>& rects, int width, int height) {
-    data_->pack_nodes = std::make_unique<stbrp_node[]>(width);
+    data_->areas.clear();
+    data_->addArea(0, 0, width, height);
     std::vector<stbrp_rect> packed_rects;
     rect_index_ = 0;
     for (const PackedRect& rect : rects) {
@@ -297,8 +318,8 @@ namespace visage {
       packed_rects.push_back(r);
     }
 
-    stbrp_init_target(&data_->pack_context, width, height, data_->pack_nodes.get(), width);
-    packed_ = stbrp_pack_rects(&data_->pack_context, packed_rects.data(), packed_rects.size());
+    stbrp_context* context = &data_->areas.back()->pack_context;
+    packed_ = stbrp_pack_rects(context, packed_rects.data(), packed_rects.size());
     if (packed_) {
       for (int i = 0; i < packed_rects.size(); ++i) {
         rects[i].x = packed_rects[i].x;
@@ -308,6 +329,18 @@ namespace visage {
     return packed_;
   }
 
+  // The space added to the right and below the old bounds becomes two more skylines, so rects
+  // that are already placed keep their positions.
+  void AtlasPacker::grow(int old_width, int old_height, int width, int height,
+                         bool reuse_free_space) {
+    VISAGE_ASSERT(packed_);
+    if (!reuse_free_space)
+      data_->areas.clear();
+
+    data_->addArea(old_width, 0, width - old_width, height);
+    data_->addArea(0, old_height, old_width, height - old_height);
+  }
+
   bgfx::VertexLayout& UvVertex::layout() {
     static bgfx::VertexLayout layout;
     static bool initialized = false;
@@ -331,7 +364,10 @@ namespace visage {
       initialized = true;
       layout.begin()
           .add(bgfx::Attrib::Position, 2, bgfx::AttribType::Float)
-          .add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float)
+          .add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Float)
+          .add(bgfx::Attrib::Color1, 4, bgfx::AttribType::Float)
+          .add(bgfx::Attrib::TexCoord0, 3, bgfx::AttribType::Float)
+          .add(bgfx::Attrib::TexCoord1, 4, bgfx::AttribType::Float)
           .end();
     }
 
@@ -357,6 +393,18 @@ namespace visage {
     return layout;
   }
 
+  bgfx::VertexLayout& QuadCornerVertex::layout() {
+    static bgfx::VertexLayout layout;
+    static bool initialized = false;
+
+    if (!initialized) {
+      initialized = true;
+      layout.begin().add(bgfx::Attrib::Position, 2, bgfx::AttribType::Float).end();
+    }
+
+    return layout;
+  }
+
   bgfx::VertexLayout& ComplexShapeVertex::layout() {
     static bgfx::VertexLayout layout;
     static bool initialized = false;
@@ -377,6 +425,27 @@ namespace visage {
     return layout;
   }
 
+  bgfx::VertexLayout& SdfShapeVertex::layout() {
+    static bgfx::VertexLayout layout;
+    static bool initialized = false;
+
+    if (!initialized) {
+      initialized = true;
+      layout.begin()
+          .add(bgfx::Attrib::Position, 2, bgfx::AttribType::Float)
+          .add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Float)
+          .add(bgfx::Attrib::Color1, 4, bgfx::AttribType::Float)
+          .add(bgfx::Attrib::TexCoord0, 4, bgfx::AttribType::Float)
+          .add(bgfx::Attrib::TexCoord1, 4, bgfx::AttribType::Float)
+          .add(bgfx::Attrib::TexCoord2, 4, bgfx::AttribType::Float)
+          .add(bgfx::Attrib::TexCoord3, 4, bgfx::AttribType::Float)
+          .add(bgfx::Attrib::TexCoord4, 1, bgfx::AttribType::Float)
+          .end();
+    }
+
+    return layout;
+  }
+
   bgfx::VertexLayout& TextureVertex::layout() {
     static bgfx::VertexLayout layout;
     static bool initialized = false;
@@ -389,6 +458,65 @@ namespace visage {
           .add(bgfx::Attrib::Color1, 4, bgfx::AttribType::Float)
           .add(bgfx::Attrib::TexCoord0, 4, bgfx::AttribType::Float)
           .add(bgfx::Attrib::TexCoord1, 4, bgfx::AttribType::Float)
+          .add(bgfx::Attrib::TexCoord2, 1, bgfx::AttribType::Float)
+          .end();
+    }
+
+    return layout;
+  }
+
+  bgfx::VertexLayout& CompactShapeVertex::layout() {
+    static bgfx::VertexLayout layout;
+    static bool initialized = false;
+
+    if (!initialized) {
+      initialized = true;
+      layout.begin()
+          .add(bgfx::Attrib::Position, 2, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::Color1, 4, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::TexCoord0, 4, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::TexCoord1, 4, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::TexCoord2, 4, bgfx::AttribType::Half)
+          .end();
+    }
+
+    return layout;
+  }
+
+  bgfx::VertexLayout& CompactComplexShapeVertex::layout() {
+    static bgfx::VertexLayout layout;
+    static bool initialized = false;
+
+    if (!initialized) {
+      initialized = true;
+      layout.begin()
+          .add(bgfx::Attrib::Position, 2, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::Color1, 4, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::TexCoord0, 4, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::TexCoord1, 4, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::TexCoord2, 4, bgfx::AttribType::Half)
+          .add(bgfx::Attrib::TexCoord3, 4, bgfx::AttribType::Half)
+          .end();
+    }
+
+    return layout;
+  }
+
+  bgfx::VertexLayout& CompactTextureVertex::layout() {
+    static bgfx::VertexLayout layout;
+    static bool initialized = false;
+
+    if (!initialized) {
+      initialized = true;
+      layout.begin()
+          .add(bgfx::Attrib::Position, 2, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::Color1, 4, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::TexCoord0, 4, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::TexCoord1, 4, bgfx::AttribType::Int16, true)
+          .add(bgfx::Attrib::TexCoord2, 2, bgfx::AttribType::Int16)
           .end();
     }
 
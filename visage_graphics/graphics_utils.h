@@ -23,6 +23,11 @@
 
 #include "visage_utils/defines.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <list>
 #include <map>
 #include <memory>
 #include <string>
@@ -35,8 +40,8 @@ namespace bgfx {
   struct ProgramHandle;
   struct UniformHandle;
   struct IndexBufferHandle;
+  struct VertexBufferHandle;
   struct FrameBufferHandle;
-  struct TransientIndexBuffer;
   struct TransientVertexBuffer;
 }
 
@@ -56,6 +61,10 @@ namespace visage {
   static constexpr float kHdrColorMultiplier = 1.0f / kHdrColorRange;
   static constexpr int kVerticesPerQuad = 4;
   static constexpr int kIndicesPerQuad = 6;
+  static constexpr int kMaxQuadsPerDraw = (1 << 16) / kVerticesPerQuad;
+  static constexpr float kCompactPixelRange = 32767.0f / 4.0f;
+  static constexpr float kCompactTextureRange = 32767.0f / 2.0f;
+  static constexpr float kCompactHalfRange = 1024.0f;
 
   bool preprocessWebGlShader(std::string& result, const std::string& code,
                              const std::string& utils_source, const std::string& varying_source);
@@ -88,6 +97,7 @@ namespace visage {
     bool addRect(PackedRect& rect);
     void clear();
     bool pack(std::vector<PackedRect>& rects, int width, int height);
+    void grow(int old_width, int old_height, int width, int height, bool reuse_free_space);
     void setPadding(int padding) { padding_ = padding; }
     int padding() const { return padding_; }
 
@@ -100,29 +110,66 @@ namespace visage {
     int rect_index_ = 0;
   };
 
+  inline uint64_t hashCombine(uint64_t seed, uint64_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+  }
+
   template<typename T = int>
   class PackedAtlasMap {
   public:
+    static constexpr int kDefaultWidth = 64;
+    static constexpr int kMaxMultiples = 8;
+    static constexpr int kMaxWidth = kDefaultWidth << (kMaxMultiples - 1);
+
     bool addRect(T id, int width, int height) {
       VISAGE_ASSERT(lookup_.count(id) == 0);
 
       int index = packed_rects_.size();
       lookup_[id] = index;
       packed_rects_.push_back({ 0, 0, std::max(0, width), std::max(0, height) });
+      used_area_ += paddedArea(packed_rects_.back());
       return packer_.addRect(packed_rects_.back());
     }
 
+    // Places the rect where the smallest removed rect that fits used to be, without packing.
+    // The rest of that space stays unused until the next pack.
+    bool addRectInRemovedSpace(T id, int width, int height) {
+      VISAGE_ASSERT(lookup_.count(id) == 0);
+
+      auto best = removed_indices_.end();
+      int64_t best_area = std::numeric_limits<int64_t>::max();
+      for (auto it = removed_indices_.begin(); it != removed_indices_.end(); ++it) {
+        const PackedRect& removed = packed_rects_[*it];
+        int64_t area = static_cast<int64_t>(removed.w) * removed.h;
+        if (removed.w >= width && removed.h >= height && area < best_area) {
+          best = it;
+          best_area = area;
+        }
+      }
+
+      if (best == removed_indices_.end())
+        return false;
+
+      int index = *best;
+      removed_indices_.erase(best);
+      lookup_[id] = index;
+      packed_rects_[index].w = std::max(0, width);
+      packed_rects_[index].h = std::max(0, height);
+      used_area_ += paddedArea(packed_rects_[index]);
+      return true;
+    }
+
     bool hasId(T id) const { return lookup_.count(id) > 0; }
 
     void removeRect(T id) {
       VISAGE_ASSERT(lookup_.count(id) > 0);
+      int index = lookup_[id];
+      used_area_ -= paddedArea(packed_rects_[index]);
+      removed_indices_.push_back(index);
       lookup_.erase(id);
     }
 
     void pack() {
-      static constexpr int kDefaultWidth = 64;
-      static constexpr int kMaxMultiples = 8;
-
       checkRemovedRects();
       bool packed = false;
       if (packed_rects_.size() == 1) {
@@ -140,10 +187,40 @@ namespace visage {
       VISAGE_ASSERT(packed);
     }
 
+    // Called after addRect fails. Doubles the atlas until the newest rect fits, leaving every
+    // other rect where it was, and returns false if everything had to be repacked instead.
+    // Without reuse_free_space new rects only go into the added area, so the old area can be
+    // copied over after rects were added. If removed rects left at least half of the atlas
+    // unused, it's defragmented instead of grown.
+    bool grow(bool reuse_free_space = true) {
+      bool fragmented = packed_rects_.size() != lookup_.size() &&
+                        2 * used_area_ <= static_cast<int64_t>(width_) * height_;
+      if (!packer_.packed() || packed_rects_.size() <= 1 || fragmented) {
+        pack();
+        return false;
+      }
+
+      while (width_ < kMaxWidth && height_ < kMaxWidth) {
+        int old_width = width_;
+        int old_height = height_;
+        width_ *= 2;
+        height_ *= 2;
+        packer_.grow(old_width, old_height, width_, height_, reuse_free_space);
+        if (packer_.addRect(packed_rects_.back()))
+          return true;
+        reuse_free_space = true;
+      }
+
+      pack();
+      return false;
+    }
+
     void clear() {
       lookup_.clear();
       packer_.clear();
       packed_rects_.clear();
+      removed_indices_.clear();
+      used_area_ = 0;
     }
 
     void setPadding(int padding) { packer_.setPadding(padding); }
@@ -180,9 +257,15 @@ namespace visage {
     int height() const { return height_; }
     bool packed() const { return packer_.packed(); }
     int numRects() const { return packed_rects_.size(); }
+    int64_t usedArea() const { return used_area_; }
 
   private:
+    int64_t paddedArea(const PackedRect& rect) const {
+      return static_cast<int64_t>(rect.w + packer_.padding()) * (rect.h + packer_.padding());
+    }
+
     void checkRemovedRects() {
+      removed_indices_.clear();
       if (packed_rects_.size() == lookup_.size())
         return;
 
@@ -197,11 +280,64 @@ namespace visage {
 
     int width_ = 0;
     int height_ = 0;
+    int64_t used_area_ = 0;
     std::vector<PackedRect> packed_rects_;
+    std::vector<int> removed_indices_;
     AtlasPacker packer_;
     std::map<T, int> lookup_;
   };
 
+  // Entries nothing references anymore, least recently used first. Atlases keep them around
+  // while they're under their memory budget so they can be drawn again without being rebuilt.
+  template<typename T>
+  class StaleCache {
+  public:
+    void add(const T& key, size_t bytes) {
+      remove(key);
+      entries_.push_back({ key, bytes });
+      lookup_[key] = std::prev(entries_.end());
+    }
+
+    bool remove(const T& key) {
+      auto found = lookup_.find(key);
+      if (found == lookup_.end())
+        return false;
+
+      entries_.erase(found->second);
+      lookup_.erase(found);
+      return true;
+    }
+
+    // Evicts the oldest entries until used_bytes fits in budget. A budget of 0 evicts everything.
+    template<typename F>
+    void evict(size_t& used_bytes, size_t budget, F&& evict_entry) {
+      while (!entries_.empty() && (budget == 0 || used_bytes > budget)) {
+        Entry entry = entries_.front();
+        lookup_.erase(entry.key);
+        entries_.pop_front();
+        used_bytes -= std::min(used_bytes, entry.bytes);
+        evict_entry(entry.key);
+      }
+    }
+
+    bool contains(const T& key) const { return lookup_.count(key) > 0; }
+    bool empty() const { return entries_.empty(); }
+    int size() const { return entries_.size(); }
+
+  private:
+    struct Entry {
+      T key;
+      size_t bytes = 0;
+    };
+
+    std::list<Entry> entries_;
+    std::map<T, typename std::list<Entry>::iterator> lookup_;
+  };
+
+  struct CompactShapeVertex;
+  struct CompactComplexShapeVertex;
+  struct CompactTextureVertex;
+
   struct UvVertex {
     float x;
     float y;
@@ -214,8 +350,21 @@ namespace visage {
   struct LineVertex {
     float x;
     float y;
+    float gradient_color_from_x;
+    float gradient_color_from_y;
+    float gradient_color_to_x;
+    float gradient_color_to_y;
+    float gradient_position_from_x;
+    float gradient_position_from_y;
+    float gradient_position_to_x;
+    float gradient_position_to_y;
     float fill;
     float value;
+    float line_width;
+    float clamp_left;
+    float clamp_top;
+    float clamp_right;
+    float clamp_bottom;
 
     static bgfx::VertexLayout& layout();
   };
@@ -244,9 +393,63 @@ namespace visage {
     float value_1;
     float value_2;
 
+    using Compact = CompactShapeVertex;
     static bgfx::VertexLayout& layout();
   };
 
+  struct QuadCornerVertex {
+    float coordinate_x;
+    float coordinate_y;
+
+    static bgfx::VertexLayout& layout();
+  };
+
+  struct ShapeInstance {
+    float x;
+    float y;
+    float dimension_x;
+    float dimension_y;
+    float gradient_color_from_x;
+    float gradient_color_from_y;
+    float gradient_color_to_x;
+    float gradient_color_to_y;
+    float gradient_position_from_x;
+    float gradient_position_from_y;
+    float gradient_position_to_x;
+    float gradient_position_to_y;
+    float clamp_left;
+    float clamp_top;
+    float clamp_right;
+    float clamp_bottom;
+    float thickness;
+    float fade;
+    float value_1;
+    float value_2;
+
+    static ShapeInstance fromVertex(const ShapeVertex& vertex) {
+      return { vertex.x,
+               vertex.y,
+               vertex.dimension_x,
+               vertex.dimension_y,
+               vertex.gradient_color_from_x,
+               vertex.gradient_color_from_y,
+               vertex.gradient_color_to_x,
+               vertex.gradient_color_to_y,
+               vertex.gradient_position_from_x,
+               vertex.gradient_position_from_y,
+               vertex.gradient_position_to_x,
+               vertex.gradient_position_to_y,
+               vertex.clamp_left,
+               vertex.clamp_top,
+               vertex.clamp_right,
+               vertex.clamp_bottom,
+               vertex.thickness,
+               vertex.fade,
+               vertex.value_1,
+               vertex.value_2 };
+    }
+  };
+
   struct ComplexShapeVertex {
     float x;
     float y;
@@ -275,6 +478,39 @@ namespace visage {
     float value_5;
     float value_6;
 
+    using Compact = CompactComplexShapeVertex;
+    static bgfx::VertexLayout& layout();
+  };
+
+  struct SdfShapeVertex {
+    float x;
+    float y;
+    float gradient_color_from_x;
+    float gradient_color_from_y;
+    float gradient_color_to_x;
+    float gradient_color_to_y;
+    float gradient_position_from_x;
+    float gradient_position_from_y;
+    float gradient_position_to_x;
+    float gradient_position_to_y;
+    float coordinate_x;
+    float coordinate_y;
+    float dimension_x;
+    float dimension_y;
+    float clamp_left;
+    float clamp_top;
+    float clamp_right;
+    float clamp_bottom;
+    float thickness;
+    float fade;
+    float value_1;
+    float value_2;
+    float value_3;
+    float value_4;
+    float value_5;
+    float value_6;
+    float shape_kind;
+
     static bgfx::VertexLayout& layout();
   };
 
@@ -299,10 +535,295 @@ namespace visage {
     float clamp_top;
     float clamp_right;
     float clamp_bottom;
+    float atlas_page;
 
+    using Compact = CompactTextureVertex;
     static bgfx::VertexLayout& layout();
   };
 
+  inline uint16_t halfFromFloat(float value) {
+    uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = static_cast<int>((bits >> 23) & 0xff);
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponent == 0xff)
+      return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+
+    int half_exponent = exponent - 127 + 15;
+    if (half_exponent >= 0x1f)
+      return sign | 0x7c00;
+
+    if (half_exponent <= 0) {
+      if (half_exponent < -10)
+        return sign;
+
+      mantissa |= 0x800000;
+      int shift = 14 - half_exponent;
+      uint32_t half_mantissa = mantissa >> shift;
+      uint32_t remainder = mantissa & ((1u << shift) - 1);
+      uint32_t halfway = 1u << (shift - 1);
+      if (remainder > halfway || (remainder == halfway && (half_mantissa & 1)))
+        ++half_mantissa;
+      return sign | half_mantissa;
+    }
+
+    uint32_t half = sign | (half_exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+      ++half;
+    return half;
+  }
+
+  inline float floatFromHalf(uint16_t half) {
+    uint32_t sign = (half & 0x8000) << 16;
+    int exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    if (exponent == 0) {
+      float value = std::ldexp(static_cast<float>(mantissa), -24);
+      return sign ? -value : value;
+    }
+
+    uint32_t bits = sign | (mantissa << 13);
+    if (exponent == 0x1f)
+      bits |= 0x7f800000;
+    else
+      bits |= (exponent - 15 + 127) << 23;
+
+    float result = 0.0f;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+  }
+
+  inline bool compactHalf(float value, uint16_t* result) {
+    if (!(std::abs(value) < kCompactHalfRange))
+      return false;
+
+    *result = halfFromFloat(value);
+    return true;
+  }
+
+  inline bool compactSigned(float value, float range, int16_t* result) {
+    float scaled = value * (32767.0f / range);
+    if (!(scaled >= -32767.0f && scaled <= 32767.0f))
+      return false;
+
+    *result = static_cast<int16_t>(std::lround(scaled));
+    return true;
+  }
+
+  inline bool compactPage(float page, int16_t* result) {
+    if (!(page >= 0.0f && page <= 32767.0f))
+      return false;
+
+    *result = static_cast<int16_t>(page);
+    return true;
+  }
+
+  inline float expandSigned(int16_t value, float range) {
+    return std::max(-1.0f, value / 32767.0f) * range;
+  }
+
+  struct CompactShapeVertex {
+    int16_t x;
+    int16_t y;
+    int16_t gradient_color_from_x;
+    int16_t gradient_color_from_y;
+    int16_t gradient_color_to_x;
+    int16_t gradient_color_to_y;
+    int16_t gradient_position_from_x;
+    int16_t gradient_position_from_y;
+    int16_t gradient_position_to_x;
+    int16_t gradient_position_to_y;
+    int16_t coordinate_x;
+    int16_t coordinate_y;
+    int16_t dimension_x;
+    int16_t dimension_y;
+    int16_t clamp_left;
+    int16_t clamp_top;
+    int16_t clamp_right;
+    int16_t clamp_bottom;
+    uint16_t thickness;
+    uint16_t fade;
+    uint16_t value_1;
+    uint16_t value_2;
+
+    static bgfx::VertexLayout& layout();
+  };
+
+  struct CompactComplexShapeVertex {
+    int16_t x;
+    int16_t y;
+    int16_t gradient_color_from_x;
+    int16_t gradient_color_from_y;
+    int16_t gradient_color_to_x;
+    int16_t gradient_color_to_y;
+    int16_t gradient_position_from_x;
+    int16_t gradient_position_from_y;
+    int16_t gradient_position_to_x;
+    int16_t gradient_position_to_y;
+    int16_t coordinate_x;
+    int16_t coordinate_y;
+    int16_t dimension_x;
+    int16_t dimension_y;
+    int16_t clamp_left;
+    int16_t clamp_top;
+    int16_t clamp_right;
+    int16_t clamp_bottom;
+    uint16_t thickness;
+    uint16_t fade;
+    uint16_t value_1;
+    uint16_t value_2;
+    uint16_t value_3;
+    uint16_t value_4;
+    uint16_t value_5;
+    uint16_t value_6;
+
+    static bgfx::VertexLayout& layout();
+  };
+
+  struct CompactTextureVertex {
+    int16_t x;
+    int16_t y;
+    int16_t gradient_color_from_x;
+    int16_t gradient_color_from_y;
+    int16_t gradient_color_to_x;
+    int16_t gradient_color_to_y;
+    int16_t gradient_position_from_x;
+    int16_t gradient_position_from_y;
+    int16_t gradient_position_to_x;
+    int16_t gradient_position_to_y;
+    int16_t texture_x;
+    int16_t texture_y;
+    int16_t direction_x;
+    int16_t direction_y;
+    int16_t clamp_left;
+    int16_t clamp_top;
+    int16_t clamp_right;
+    int16_t clamp_bottom;
+    int16_t atlas_page;
+    int16_t reserved;
+
+    static bgfx::VertexLayout& layout();
+  };
+
+  template<typename V, typename C>
+  inline bool compactGradient(const V& vertex, C* result) {
+    return compactSigned(vertex.gradient_color_from_x, 1.0f, &result->gradient_color_from_x) &&
+           compactSigned(vertex.gradient_color_from_y, 1.0f, &result->gradient_color_from_y) &&
+           compactSigned(vertex.gradient_color_to_x, 1.0f, &result->gradient_color_to_x) &&
+           compactSigned(vertex.gradient_color_to_y, 1.0f, &result->gradient_color_to_y) &&
+           compactSigned(vertex.gradient_position_from_x, kCompactPixelRange,
+                         &result->gradient_position_from_x) &&
+           compactSigned(vertex.gradient_position_from_y, kCompactPixelRange,
+                         &result->gradient_position_from_y) &&
+           compactSigned(vertex.gradient_position_to_x, kCompactPixelRange,
+                         &result->gradient_position_to_x) &&
+           compactSigned(vertex.gradient_position_to_y, kCompactPixelRange,
+                         &result->gradient_position_to_y);
+  }
+
+  template<typename C, typename V>
+  inline void expandGradient(const C& compact, V* result) {
+    result->gradient_color_from_x = expandSigned(compact.gradient_color_from_x, 1.0f);
+    result->gradient_color_from_y = expandSigned(compact.gradient_color_from_y, 1.0f);
+    result->gradient_color_to_x = expandSigned(compact.gradient_color_to_x, 1.0f);
+    result->gradient_color_to_y = expandSigned(compact.gradient_color_to_y, 1.0f);
+    result->gradient_position_from_x = expandSigned(compact.gradient_position_from_x, kCompactPixelRange);
+    result->gradient_position_from_y = expandSigned(compact.gradient_position_from_y, kCompactPixelRange);
+    result->gradient_position_to_x = expandSigned(compact.gradient_position_to_x, kCompactPixelRange);
+    result->gradient_position_to_y = expandSigned(compact.gradient_position_to_y, kCompactPixelRange);
+  }
+
+  template<typename V, typename C>
+  inline bool compactClamp(const V& vertex, C* result) {
+    return compactSigned(vertex.clamp_left, kCompactPixelRange, &result->clamp_left) &&
+           compactSigned(vertex.clamp_top, kCompactPixelRange, &result->clamp_top) &&
+           compactSigned(vertex.clamp_right, kCompactPixelRange, &result->clamp_right) &&
+           compactSigned(vertex.clamp_bottom, kCompactPixelRange, &result->clamp_bottom);
+  }
+
+  template<typename C, typename V>
+  inline void expandClamp(const C& compact, V* result) {
+    result->clamp_left = expandSigned(compact.clamp_left, kCompactPixelRange);
+    result->clamp_top = expandSigned(compact.clamp_top, kCompactPixelRange);
+    result->clamp_right = expandSigned(compact.clamp_right, kCompactPixelRange);
+    result->clamp_bottom = expandSigned(compact.clamp_bottom, kCompactPixelRange);
+  }
+
+  template<typename V, typename C>
+  inline bool compactShapeVertex(const V& vertex, C* result) {
+    return compactSigned(vertex.x, kCompactPixelRange, &result->x) &&
+           compactSigned(vertex.y, kCompactPixelRange, &result->y) && compactGradient(vertex, result) &&
+           compactSigned(vertex.coordinate_x, kCompactPixelRange, &result->coordinate_x) &&
+           compactSigned(vertex.coordinate_y, kCompactPixelRange, &result->coordinate_y) &&
+           compactSigned(vertex.dimension_x, kCompactPixelRange, &result->dimension_x) &&
+           compactSigned(vertex.dimension_y, kCompactPixelRange, &result->dimension_y) &&
+           compactClamp(vertex, result) && compactHalf(vertex.thickness, &result->thickness) &&
+           compactHalf(vertex.fade, &result->fade) && compactHalf(vertex.value_1, &result->value_1) &&
+           compactHalf(vertex.value_2, &result->value_2);
+  }
+
+  inline bool compactVertex(const ShapeVertex& vertex, CompactShapeVertex* result) {
+    return compactShapeVertex(vertex, result);
+  }
+
+  inline bool compactVertex(const ComplexShapeVertex& vertex, CompactComplexShapeVertex* result) {
+    return compactShapeVertex(vertex, result) && compactHalf(vertex.value_3, &result->value_3) &&
+           compactHalf(vertex.value_4, &result->value_4) &&
+           compactHalf(vertex.value_5, &result->value_5) && compactHalf(vertex.value_6, &result->value_6);
+  }
+
+  inline bool compactVertex(const TextureVertex& vertex, CompactTextureVertex* result) {
+    return compactSigned(vertex.x, kCompactPixelRange, &result->x) &&
+           compactSigned(vertex.y, kCompactPixelRange, &result->y) && compactGradient(vertex, result) &&
+           compactSigned(vertex.texture_x, kCompactTextureRange, &result->texture_x) &&
+           compactSigned(vertex.texture_y, kCompactTextureRange, &result->texture_y) &&
+           compactSigned(vertex.direction_x, kCompactTextureRange, &result->direction_x) &&
+           compactSigned(vertex.direction_y, kCompactTextureRange, &result->direction_y) &&
+           compactClamp(vertex, result) && compactPage(vertex.atlas_page, &result->atlas_page);
+  }
+
+  template<typename C, typename V>
+  inline void expandShapeVertex(const C& compact, V* result) {
+    result->x = expandSigned(compact.x, kCompactPixelRange);
+    result->y = expandSigned(compact.y, kCompactPixelRange);
+    expandGradient(compact, result);
+    result->coordinate_x = expandSigned(compact.coordinate_x, kCompactPixelRange);
+    result->coordinate_y = expandSigned(compact.coordinate_y, kCompactPixelRange);
+    result->dimension_x = expandSigned(compact.dimension_x, kCompactPixelRange);
+    result->dimension_y = expandSigned(compact.dimension_y, kCompactPixelRange);
+    expandClamp(compact, result);
+    result->thickness = floatFromHalf(compact.thickness);
+    result->fade = floatFromHalf(compact.fade);
+    result->value_1 = floatFromHalf(compact.value_1);
+    result->value_2 = floatFromHalf(compact.value_2);
+  }
+
+  inline void expandVertex(const CompactShapeVertex& compact, ShapeVertex* result) {
+    expandShapeVertex(compact, result);
+  }
+
+  inline void expandVertex(const CompactComplexShapeVertex& compact, ComplexShapeVertex* result) {
+    expandShapeVertex(compact, result);
+    result->value_3 = floatFromHalf(compact.value_3);
+    result->value_4 = floatFromHalf(compact.value_4);
+    result->value_5 = floatFromHalf(compact.value_5);
+    result->value_6 = floatFromHalf(compact.value_6);
+  }
+
+  inline void expandVertex(const CompactTextureVertex& compact, TextureVertex* result) {
+    result->x = expandSigned(compact.x, kCompactPixelRange);
+    result->y = expandSigned(compact.y, kCompactPixelRange);
+    expandGradient(compact, result);
+    result->texture_x = expandSigned(compact.texture_x, kCompactTextureRange);
+    result->texture_y = expandSigned(compact.texture_y, kCompactTextureRange);
+    result->direction_x = expandSigned(compact.direction_x, kCompactTextureRange);
+    result->direction_y = expandSigned(compact.direction_y, kCompactTextureRange);
+    expandClamp(compact, result);
+    result->atlas_page = compact.atlas_page;
+  }
+
   struct PostEffectVertex {
     float x;
     float y;
@@ -21,10 +21,13 @@
 
 #include "image.h"
 
+#include "visage_utils/thread_utils.h"
+
 #include <bgfx/bgfx.h>
 #include <bimg/decode.h>
 #include <bx/allocator.h>
 #include <cstring>
+#include <mutex>
 #include <nanosvg/src/nanosvg.h>
 #include <nanosvg/src/nanosvgrast.h>
 
@@ -66,10 +69,74 @@ namespace visage {
     }
   }
 
+  static int readBigEndian16(const unsigned char* data) {
+    return (data[0] << 8) | data[1];
+  }
+
+  static uint32_t readBigEndian32(const unsigned char* data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+           (static_cast<uint32_t>(data[2]) << 8) | data[3];
+  }
+
+  // Corrupt headers fall back to the full parse instead of packing a size the atlas can't hold
+  static bool setEncodedDimensions(uint32_t encoded_width, uint32_t encoded_height, int* width,
+                                   int* height) {
+    static constexpr uint32_t kMaxDimension = PackedAtlasMap<>::kMaxWidth;
+    if (encoded_width == 0 || encoded_height == 0 || encoded_width > kMaxDimension ||
+        encoded_height > kMaxDimension) {
+      return false;
+    }
+
+    *width = encoded_width;
+    *height = encoded_height;
+    return true;
+  }
+
+  static bool encodedDimensions(const ImageFile& image, int* width, int* height) {
+    static constexpr unsigned char kPngSignature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    static constexpr int kPngHeaderSize = 24;
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(image.data);
+    int size = image.data_size;
+    if (size >= kPngHeaderSize && memcmp(data, kPngSignature, sizeof(kPngSignature)) == 0) {
+      return setEncodedDimensions(readBigEndian32(data + 16), readBigEndian32(data + 20), width,
+                                  height);
+    }
+
+    if (size < 4 || data[0] != 0xff || data[1] != 0xd8)
+      return false;
+
+    int index = 2;
+    while (index + 4 <= size) {
+      if (data[index] != 0xff)
+        return false;
+
+      int marker = data[index + 1];
+      if (marker == 0xff) {
+        index++;
+        continue;
+      }
+      if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd9)) {
+        index += 2;
+        continue;
+      }
+
+      bool frame_header = marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 &&
+                          marker != 0xcc;
+      if (frame_header && index + 9 <= size) {
+        return setEncodedDimensions(readBigEndian16(data + index + 7),
+                                    readBigEndian16(data + index + 5), width, height);
+      }
+
+      index += 2 + readBigEndian16(data + index + 2);
+    }
+    return false;
+  }
+
   class SvgRasterizer {
   public:
     static SvgRasterizer& instance() {
-      static SvgRasterizer instance;
+      static thread_local SvgRasterizer instance;
       return instance;
     }
 
@@ -102,6 +169,80 @@ namespace visage {
     NSVGrasterizer* rasterizer_ = nullptr;
   };
 
+  static std::unique_ptr<unsigned char[]> decodeImage(const ImageFile& image, int width, int height) {
+    if (image.svg) {
+      std::unique_ptr<unsigned char[]> data = SvgRasterizer::instance().rasterize(image);
+
+      if (image.blur_radius)
+        ImageAtlas::blurImage(data.get(), image.width, image.height, image.blur_radius);
+
+      return data;
+    }
+
+    bimg::ImageContainer* image_container = bimg::imageParse(allocator(), image.data, image.data_size,
+                                                             bimg::TextureFormat::RGBA8);
+    if (image_container == nullptr)
+      return nullptr;
+
+    int size = width * height * ImageAtlas::kChannels;
+    std::unique_ptr<unsigned char[]> data = std::make_unique<unsigned char[]>(size);
+    unsigned char* image_data = static_cast<unsigned char*>(image_container->m_data);
+    if (image_container->m_width == width && image_container->m_height == height)
+      memcpy(data.get(), image_data, size);
+    else {
+      stbir_resize_uint8_srgb(image_data, image_container->m_width, image_container->m_height,
+                              image_container->m_width * ImageAtlas::kChannels, data.get(), width,
+                              height, width * ImageAtlas::kChannels, STBIR_BGRA);
+    }
+    bimg::imageFree(image_container);
+    return data;
+  }
+
+  class ImageDecoder {
+  public:
+    static constexpr int kMaxThreads = 4;
+
+    struct Result {
+      ImageFile image;
+      int width = 0;
+      int height = 0;
+      std::unique_ptr<unsigned char[]> pixels;
+    };
+
+    ImageDecoder() :
+        queue_(std::clamp<int>(std::thread::hardware_concurrency() / 2, 1, kMaxThreads),
+               "Image Decoder") { }
+
+    void decode(const ImageFile& image, int width, int height) {
+      std::shared_ptr<char[]> data(new char[image.data_size]);
+      memcpy(data.get(), image.data, image.data_size);
+      queue_.add([this, image, width, height, data] {
+        ImageFile copy = image;
+        copy.data = data.get();
+        Result result;
+        result.image = image;
+        result.width = width;
+        result.height = height;
+        result.pixels = decodeImage(copy, width, height);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        results_.push_back(std::move(result));
+      });
+    }
+
+    std::vector<Result> takeResults() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::vector<Result> results = std::move(results_);
+      results_.clear();
+      return results;
+    }
+
+  private:
+    std::mutex mutex_;
+    std::vector<Result> results_;
+    TaskQueue queue_;
+  };
+
   class ImageAtlasTexture {
   public:
     explicit ImageAtlasTexture(int width, int height) : width_(width), height_(height) { }
@@ -119,9 +260,29 @@ namespace visage {
 
     bgfx::TextureHandle& handle() { return texture_handle_; }
 
+    static bool blitSupported() {
+      return bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_BLIT;
+    }
+
     void checkHandle() {
-      if (!bgfx::isValid(texture_handle_))
-        texture_handle_ = bgfx::createTexture2D(width_, height_, false, 1, bgfx::TextureFormat::RGBA8);
+      if (!bgfx::isValid(texture_handle_)) {
+        uint64_t flags = blitSupported() ? BGFX_TEXTURE_BLIT_DST : BGFX_TEXTURE_NONE;
+        texture_handle_ = bgfx::createTexture2D(width_, height_, false, 1,
+                                                bgfx::TextureFormat::RGBA8, flags);
+      }
+    }
+
+    void copyFrom(const ImageAtlasTexture& other) {
+      VISAGE_ASSERT(bgfx::isValid(texture_handle_) && bgfx::isValid(other.texture_handle_));
+      bgfx::blit(0, texture_handle_, 0, 0, other.texture_handle_, 0, 0, other.width_,
+                 other.height_);
+    }
+
+    void clearTexture() {
+      VISAGE_ASSERT(bgfx::isValid(texture_handle_));
+      const bgfx::Memory* memory = bgfx::alloc(width_ * height_ * ImageAtlas::kChannels);
+      memset(memory->data, 0, memory->size);
+      bgfx::updateTexture2D(texture_handle_, 0, 0, 0, 0, width_, height_, memory);
     }
 
     void updateTexture(const unsigned char* data, int x, int y, int width, int height) {
@@ -174,7 +335,7 @@ namespace visage {
     if (images_.count(image) == 0) {
       int width = image.width;
       int height = image.height;
-      if (image.width == 0 && !image.svg) {
+      if (image.width == 0 && !image.svg && !encodedDimensions(image, &width, &height)) {
         bimg::ImageContainer* image_container = bimg::imageParse(allocator(), image.data, image.data_size);
         if (image_container) {
           width = image_container->m_width;
@@ -189,9 +350,10 @@ namespace visage {
 
       loadImageRect(packed_image_rect.get());
       updateImage(packed_image_rect.get());
+      used_bytes_ += imageBytes(packed_image_rect.get());
       images_[image] = std::move(packed_image_rect);
     }
-    stale_images_.erase(image);
+    stale_images_.remove(image);
 
     if (auto reference = references_[image].lock())
       return PackedImage(reference);
@@ -202,12 +364,31 @@ namespace visage {
   }
 
   void ImageAtlas::resize() {
+    // A grown atlas keeps every image where it was. If the old texture exists, the GPU copies
+    // it into the new one, so images aren't decoded again.
+    bool has_texture = texture_ && texture_->hasHandle();
+    bool copy_texture = has_texture && ImageAtlasTexture::blitSupported();
+    if ((copy_texture || !has_texture) && atlas_map_.grow(!copy_texture)) {
+      std::unique_ptr<ImageAtlasTexture> old_texture = std::move(texture_);
+      texture_ = std::make_unique<ImageAtlasTexture>(atlas_map_.width(), atlas_map_.height());
+      if (copy_texture) {
+        texture_->checkHandle();
+        if (decoder_)
+          texture_->clearTexture();
+        texture_->copyFrom(*old_texture);
+      }
+      return;
+    }
+
     clearStaleImages();
 
     atlas_map_.pack();
     texture_ = std::make_unique<ImageAtlasTexture>(atlas_map_.width(), atlas_map_.height());
-    for (auto& image : images_)
+    for (auto& image : images_) {
       loadImageRect(image.second.get());
+      if (decoder_)
+        updateImage(image.second.get());
+    }
   }
 
   void ImageAtlas::loadImageRect(PackedImageRect* packed_image_rect) const {
@@ -216,51 +397,86 @@ namespace visage {
     packed_image_rect->y = rect.y;
     packed_image_rect->w = rect.w;
     packed_image_rect->h = rect.h;
+    packed_image_rect->loaded = false;
   }
 
-  void ImageAtlas::updateImage(const PackedImageRect* image) const {
+  void ImageAtlas::updateImage(PackedImageRect* image) const {
     if (image->w == 0 && image->image.svg)
       return;
 
+    if (decoder_) {
+      if (!image->loaded && !image->pending) {
+        image->pending = true;
+        decoder_->decode(image->image, image->w, image->h);
+      }
+      return;
+    }
+
     if (texture_ == nullptr || !bgfx::isValid(texture_->handle()))
       return;
 
-    PackedRect packed_rect = atlas_map_.rectForId(image);
-    if (image->image.svg) {
-      std::unique_ptr<unsigned char[]> data = SvgRasterizer::instance().rasterize(image->image);
+    std::unique_ptr<unsigned char[]> data = decodeImage(image->image, image->w, image->h);
+    if (data)
+      texture_->updateTexture(data.get(), image->x, image->y, image->w, image->h);
+    image->loaded = true;
+  }
 
-      if (image->image.blur_radius)
-        blurImage(data.get(), image->image.width, image->image.height, image->image.blur_radius);
+  void ImageAtlas::setAsyncDecoding(bool async) {
+#if VISAGE_EMSCRIPTEN
+    async = false;
+#endif
+    if (async == asyncDecoding())
+      return;
 
-      texture_->updateTexture(data.get(), packed_rect.x, packed_rect.y, packed_rect.w, packed_rect.h);
+    if (async) {
+      decoder_ = std::make_unique<ImageDecoder>();
+      return;
     }
-    else {
-      bimg::ImageContainer* image_container = bimg::imageParse(allocator(), image->image.data,
-                                                               image->image.data_size,
-                                                               bimg::TextureFormat::RGBA8);
-      if (image_container) {
-        unsigned char* image_data = static_cast<unsigned char*>(image_container->m_data);
-        if (image_container->m_width == packed_rect.w && image_container->m_height == packed_rect.h) {
-          texture_->updateTexture(image_data, packed_rect.x, packed_rect.y, packed_rect.w,
-                                  packed_rect.h);
-        }
-        else {
-          int size = packed_rect.w * packed_rect.h * kChannels;
-          std::unique_ptr<unsigned char[]> resampled = std::make_unique<unsigned char[]>(size);
-          stbir_resize_uint8_srgb(image_data, image_container->m_width, image_container->m_height,
-                                  image_container->m_width * kChannels, resampled.get(),
-                                  packed_rect.w, packed_rect.h, packed_rect.w * kChannels, STBIR_BGRA);
-          texture_->updateTexture(resampled.get(), packed_rect.x, packed_rect.y, packed_rect.w,
-                                  packed_rect.h);
-        }
-        bimg::imageFree(image_container);
+
+    decoder_ = nullptr;
+    for (auto& image : images_) {
+      image.second->pending = false;
+      updateImage(image.second.get());
+    }
+  }
+
+  int ImageAtlas::numPendingImages() const {
+    return std::count_if(images_.begin(), images_.end(),
+                         [](const auto& image) { return image.second->pending; });
+  }
+
+  int ImageAtlas::uploadDecodedImages() {
+    if (decoder_ == nullptr)
+      return 0;
+
+    int num_uploaded = 0;
+    for (ImageDecoder::Result& result : decoder_->takeResults()) {
+      auto found = images_.find(result.image);
+      if (found == images_.end())
+        continue;
+
+      PackedImageRect* image = found->second.get();
+      image->pending = false;
+      if (image->w != result.width || image->h != result.height) {
+        updateImage(image);
+        continue;
+      }
+
+      image->loaded = true;
+      if (result.pixels) {
+        textureHandle();
+        texture_->updateTexture(result.pixels.get(), image->x, image->y, image->w, image->h);
       }
+      num_uploaded++;
     }
+    return num_uploaded;
   }
 
   const bgfx::TextureHandle& ImageAtlas::textureHandle() const {
     if (!texture_->hasHandle()) {
       texture_->checkHandle();
+      if (decoder_)
+        texture_->clearTexture();
       for (auto& image : images_)
         updateImage(image.second.get());
     }
@@ -285,6 +501,7 @@ namespace visage {
     for (int i = 0; i < kVerticesPerQuad; ++i) {
       vertices[i].direction_x = 1.0f;
       vertices[i].direction_y = 0.0f;
+      vertices[i].atlas_page = 0.0f;
     }
   }
 }
\ No newline at end of file
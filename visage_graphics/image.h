@@ -70,6 +70,7 @@ namespace visage {
   };
 
   class ImageAtlasTexture;
+  class ImageDecoder;
 
   class ImageAtlas {
   public:
@@ -86,6 +87,8 @@ namespace visage {
       int y = 0;
       int w = 0;
       int h = 0;
+      bool loaded = false;
+      bool pending = false;
     };
 
     struct PackedImageReference {
@@ -124,6 +127,11 @@ namespace visage {
         return reference_->packed_image_rect->image;
       }
 
+      bool loaded() const {
+        VISAGE_ASSERT(reference_->atlas.lock().get());
+        return reference_->packed_image_rect->loaded;
+      }
+
       const PackedImageRect* packedImageRect() const {
         VISAGE_ASSERT(reference_->atlas.lock().get());
         return reference_->packed_image_rect;
@@ -141,13 +149,29 @@ namespace visage {
 
     PackedImage addImage(const ImageFile& image);
     void clearStaleImages() {
-      for (const auto& stale : stale_images_) {
-        images_.erase(stale.first);
-        atlas_map_.removeRect(stale.second);
-      }
-      stale_images_.clear();
+      stale_images_.evict(used_bytes_, memory_budget_, [this](const ImageFile& image) {
+        atlas_map_.removeRect(images_[image].get());
+        images_.erase(image);
+        references_.erase(image);
+      });
     }
 
+    // Images that are no longer drawn stay packed, least recently used ones evicted first, until
+    // the atlas holds more than this many bytes of images. Space they leave is reclaimed the
+    // next time the atlas has to grow.
+    void setMemoryBudget(size_t bytes) { memory_budget_ = bytes; }
+    size_t memoryBudget() const { return memory_budget_; }
+    size_t usedBytes() const { return used_bytes_; }
+    size_t textureBytes() const {
+      return static_cast<size_t>(atlas_map_.width()) * atlas_map_.height() * kChannels;
+    }
+    int numStaleImages() const { return stale_images_.size(); }
+
+    void setAsyncDecoding(bool async);
+    bool asyncDecoding() const { return decoder_ != nullptr; }
+    int numPendingImages() const;
+    int uploadDecodedImages();
+
     int width() const { return atlas_map_.width(); }
     int height() const { return atlas_map_.height(); }
     const bgfx::TextureHandle& textureHandle() const;
@@ -156,11 +180,15 @@ namespace visage {
   private:
     void resize();
     void loadImageRect(PackedImageRect* image) const;
-    void updateImage(const PackedImageRect* image) const;
+    void updateImage(PackedImageRect* image) const;
+
+    static size_t imageBytes(const PackedImageRect* image) {
+      return static_cast<size_t>(image->w) * image->h * kChannels;
+    }
 
     void removeImage(const ImageFile& image) {
       VISAGE_ASSERT(images_.count(image));
-      stale_images_[image] = images_[image].get();
+      stale_images_.add(image, imageBytes(images_[image].get()));
     }
 
     void removeImage(const PackedImageRect* packed_image_rect) {
@@ -169,10 +197,13 @@ namespace visage {
 
     std::map<ImageFile, std::weak_ptr<PackedImageReference>> references_;
     std::map<ImageFile, std::unique_ptr<PackedImageRect>> images_;
-    std::map<ImageFile, const PackedImageRect*> stale_images_;
+    StaleCache<ImageFile> stale_images_;
+    size_t used_bytes_ = 0;
+    size_t memory_budget_ = 0;
 
     PackedAtlasMap<const PackedImageRect*> atlas_map_;
     std::unique_ptr<ImageAtlasTexture> texture_;
+    std::unique_ptr<ImageDecoder> decoder_;
     std::shared_ptr<ImageAtlas*> reference_;
   };
 }
\ No newline at end of file
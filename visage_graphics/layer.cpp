@@ -26,87 +26,240 @@
 #include "renderer.h"
 
 #include <bgfx/bgfx.h>
+#include <deque>
+#include <limits>
+#include <unordered_map>
 
 namespace visage {
   struct FrameBufferData {
     bgfx::TextureHandle read_back_handle = BGFX_INVALID_HANDLE;
     bgfx::FrameBufferHandle handle = BGFX_INVALID_HANDLE;
+    bgfx::FrameBufferHandle copy_source = BGFX_INVALID_HANDLE;
     bgfx::TextureFormat::Enum format = bgfx::TextureFormat::RGBA8;
   };
 
+  struct RetainedQuadBuffers {
+    bgfx::VertexBufferHandle vertex_buffer = BGFX_INVALID_HANDLE;
+    int num_quads = 0;
+    bool used = true;
+
+    ~RetainedQuadBuffers() {
+      if (bgfx::isValid(vertex_buffer))
+        bgfx::destroy(vertex_buffer);
+    }
+  };
+
+  struct RetainedGeometry {
+    std::unordered_map<uint64_t, std::unique_ptr<RetainedQuadBuffers>> buffers;
+  };
+
   struct RegionPosition {
-    RegionPosition(Region* region, std::vector<IBounds> invalid_rects, int position, int x = 0, int y = 0) :
+    RegionPosition(Region* region, DirtyRegion invalid_rects, int position, int x = 0, int y = 0) :
         region(region), invalid_rects(std::move(invalid_rects)), position(position), x(x), y(y) { }
     RegionPosition() = default;
 
     Region* region = nullptr;
-    std::vector<IBounds> invalid_rects;
+    DirtyRegion invalid_rects;
+    // Kept separately when opaque sub regions hide part of the region's own shapes
+    DirtyRegion sub_region_rects;
+    bool covered_by_sub_regions = false;
     int position = 0;
     int x = 0;
     int y = 0;
+    int order = 0;
 
+    const DirtyRegion& subRegionRects() const {
+      return covered_by_sub_regions ? sub_region_rects : invalid_rects;
+    }
     SubmitBatch* currentBatch() const { return region->submitBatchAtPosition(position); }
     bool isDone() const { return position >= region->numSubmitBatches(); }
+    IBounds bounds() const { return { x, y, region->width(), region->height() }; }
+    bool overlaps(const RegionPosition& other) const { return bounds().overlaps(other.bounds()); }
   };
 
-  inline void moveToVector(std::vector<IBounds>& rects, std::vector<IBounds>& pieces) {
-    rects.insert(rects.end(), pieces.begin(), pieces.end());
-    pieces.clear();
-  }
+  // Merges the batch streams of the regions being drawn. Batches go out in order of id and blend
+  // mode after the last submitted one, wrapping around to the lowest when none are left past it.
+  // Regions with matching batches share a submit in the order they were added. As with the original
+  // linear scan, a batch matching the last submitted one is only taken again right away when it
+  // belongs to the first region still drawing.
+  class BatchMerge {
+  public:
+    void add(RegionPosition* position) {
+      int compare = position->currentBatch()->compare(current_id_, current_blend_mode_);
+      std::vector<RegionPosition*>& heap = compare > 0 ? ahead_ : (compare == 0 ? same_ : behind_);
+      heap.push_back(position);
+      std::push_heap(heap.begin(), heap.end(), later);
+    }
 
-  static void addSubRegions(std::vector<RegionPosition>& positions, std::vector<RegionPosition>& overlapping,
-                            const RegionPosition& done_position) {
-    auto begin = done_position.region->subRegions().cbegin();
-    auto end = done_position.region->subRegions().cend();
-    for (auto it = begin; it != end; ++it) {
-      Region* sub_region = *it;
-      if (!sub_region->isVisible())
-        continue;
+    bool isEmpty() const { return ahead_.empty() && same_.empty() && behind_.empty(); }
 
-      if (sub_region->needsLayer())
-        sub_region = sub_region->intermediateRegion();
+    void takeNext(const RegionPosition* first, std::vector<RegionPosition*>& matching) {
+      if (!same_.empty() && first->currentBatch()->compare(current_id_, current_blend_mode_) == 0) {
+        while (!same_.empty())
+          popFront(same_, matching);
+        return;
+      }
 
-      bool overlaps = std::any_of(begin, it, [sub_region](const Region* other) {
-        return other->isVisible() && sub_region->overlaps(other);
-      });
+      for (RegionPosition* position : same_) {
+        behind_.push_back(position);
+        std::push_heap(behind_.begin(), behind_.end(), later);
+      }
+      same_.clear();
 
-      IBounds bounds(done_position.x + sub_region->x(), done_position.y + sub_region->y(),
-                     sub_region->width(), sub_region->height());
+      if (ahead_.empty())
+        std::swap(ahead_, behind_);
 
-      std::vector<IBounds> invalid_rects;
-      for (const IBounds& invalid_rect : done_position.invalid_rects) {
-        if (bounds.overlaps(invalid_rect))
-          invalid_rects.push_back(invalid_rect.intersection(bounds));
-      }
+      const SubmitBatch* next = ahead_.front()->currentBatch();
+      while (!ahead_.empty() && ahead_.front()->currentBatch()->compare(next) == 0)
+        popFront(ahead_, matching);
+
+      current_id_ = next->id();
+      current_blend_mode_ = next->blendMode();
+    }
+
+    void collectOverlapping(const IBounds& bounds,
+                            std::vector<const RegionPosition*>& result) const {
+      auto collect = [&bounds, &result](const std::vector<RegionPosition*>& heap) {
+        for (const RegionPosition* position : heap) {
+          if (bounds.overlaps(position->bounds()))
+            result.push_back(position);
+        }
+      };
+      collect(ahead_);
+      collect(same_);
+      collect(behind_);
+    }
+
+  private:
+    static bool later(const RegionPosition* a, const RegionPosition* b) {
+      int compare = a->currentBatch()->compare(b->currentBatch());
+      return compare > 0 || (compare == 0 && a->order > b->order);
+    }
+
+    static void popFront(std::vector<RegionPosition*>& heap, std::vector<RegionPosition*>& result) {
+      std::pop_heap(heap.begin(), heap.end(), later);
+      result.push_back(heap.back());
+      heap.pop_back();
+    }
 
-      if (invalid_rects.empty())
+    const void* current_id_ = nullptr;
+    BlendMode current_blend_mode_ = BlendMode::Opaque;
+    std::vector<RegionPosition*> ahead_;
+    std::vector<RegionPosition*> same_;
+    std::vector<RegionPosition*> behind_;
+  };
+
+  // Opaque sub regions listed after index are drawn over it, so what they cover can be dropped.
+  static void subtractOpaqueSubRegions(DirtyRegion& invalid_rects, Region* region, int index, int x,
+                                       int y) {
+    const std::vector<Region::FlatRegion>& sub_regions = region->flatSubRegions();
+    const std::vector<int>& opaque = region->opaqueSubRegions();
+    auto it = std::upper_bound(opaque.begin(), opaque.end(), index);
+    for (; it != opaque.end() && !invalid_rects.isEmpty(); ++it) {
+      const Region::FlatRegion& sub_region = sub_regions[*it];
+      if (sub_region.region->isEmpty())
         continue;
 
-      if (overlaps)
-        overlapping.emplace_back(sub_region, std::move(invalid_rects), 0, bounds.x(), bounds.y());
-      else if (sub_region->isEmpty())
-        addSubRegions(positions, overlapping,
-                      { sub_region, std::move(invalid_rects), 0, bounds.x(), bounds.y() });
-      else
-        positions.emplace_back(sub_region, std::move(invalid_rects), 0, bounds.x(), bounds.y());
+      const IBounds& bounds = sub_region.opaque_bounds;
+      invalid_rects.subtract({ x + bounds.x(), y + bounds.y(), bounds.width(), bounds.height() });
     }
   }
 
-  static void checkOverlappingRegions(std::vector<RegionPosition>& positions,
+  // A region's own shapes go out before its sub regions, so opaque ones hide those as well. The
+  // sub regions still redraw the whole area.
+  static void hideUnderOpaqueSubRegions(RegionPosition& position) {
+    if (position.region->opaqueSubRegions().empty())
+      return;
+
+    position.sub_region_rects = position.invalid_rects;
+    position.covered_by_sub_regions = true;
+    subtractOpaqueSubRegions(position.invalid_rects, position.region, -1, position.x, position.y);
+    if (position.invalid_rects.isEmpty())
+      position.position = position.region->numSubmitBatches();
+  }
+
+  static void addSubRegions(std::vector<RegionPosition>& positions, std::vector<RegionPosition>& overlapping,
+                            const RegionPosition& done_position) {
+    const std::vector<Region::FlatRegion>& sub_regions = done_position.region->flatSubRegions();
+    std::vector<std::pair<DirtyRegion, int>> containers;
+    for (int i = 0; i < sub_regions.size();) {
+      while (!containers.empty() && containers.back().second <= i)
+        containers.pop_back();
+
+      const Region::FlatRegion& sub_region = sub_regions[i];
+      IBounds bounds(done_position.x + sub_region.x, done_position.y + sub_region.y,
+                     sub_region.region->width(), sub_region.region->height());
+
+      DirtyRegion invalid_rects = containers.empty() ? done_position.subRegionRects() :
+                                                       containers.back().first;
+      invalid_rects.intersect(bounds);
+      if (!sub_region.container)
+        subtractOpaqueSubRegions(invalid_rects, done_position.region, i, done_position.x,
+                                 done_position.y);
+      if (invalid_rects.isEmpty()) {
+        i = sub_region.end;
+        continue;
+      }
+
+      RegionPosition position(sub_region.region, std::move(invalid_rects), 0, bounds.x(), bounds.y());
+      if (sub_region.container)
+        containers.emplace_back(std::move(position.invalid_rects), sub_region.end);
+      else {
+        hideUnderOpaqueSubRegions(position);
+        if (sub_region.overlaps)
+          overlapping.push_back(std::move(position));
+        else if (position.isDone())
+          addSubRegions(positions, overlapping, position);
+        else
+          positions.push_back(std::move(position));
+      }
+      ++i;
+    }
+  }
+
+  static void checkOverlappingRegions(const BatchMerge& merge,
+                                      std::vector<RegionPosition>& positions,
                                       std::vector<RegionPosition>& overlapping) {
-    std::vector<RegionPosition> new_overlapping;
+    if (overlapping.empty())
+      return;
+
+    // Only regions touching the area the waiting ones cover can hold them back, so the rest of the
+    // drawing regions are filtered out once instead of being checked against every waiting region.
+    int left = std::numeric_limits<int>::max();
+    int top = std::numeric_limits<int>::max();
+    int right = std::numeric_limits<int>::min();
+    int bottom = std::numeric_limits<int>::min();
+    for (const RegionPosition& position : overlapping) {
+      left = std::min(left, position.x);
+      top = std::min(top, position.y);
+      right = std::max(right, position.x + position.region->width());
+      bottom = std::max(bottom, position.y + position.region->height());
+    }
+    IBounds waiting_bounds(left, top, right - left, bottom - top);
+
+    std::vector<const RegionPosition*> nearby;
+    merge.collectOverlapping(waiting_bounds, nearby);
+    std::vector<int> nearby_added;
+    for (int i = 0; i < positions.size(); ++i) {
+      if (waiting_bounds.overlaps(positions[i].bounds()))
+        nearby_added.push_back(i);
+    }
 
+    std::vector<RegionPosition> new_overlapping;
     for (auto it = overlapping.begin(); it != overlapping.end();) {
-      bool overlaps = std::any_of(positions.begin(), positions.end(), [it](const RegionPosition& other) {
-        return it->x < other.x + other.region->width() && it->x + it->region->width() > other.x &&
-               it->y < other.y + other.region->height() && it->y + it->region->height() > other.y;
-      });
+      size_t num_positions = positions.size();
+      auto overlaps_nearby = [it](const RegionPosition* other) { return it->overlaps(*other); };
+      auto overlaps_added = [it, &positions](int index) { return it->overlaps(positions[index]); };
+      bool overlaps = std::any_of(nearby.begin(), nearby.end(), overlaps_nearby) ||
+                      std::any_of(nearby_added.begin(), nearby_added.end(), overlaps_added);
 
       if (!overlaps) {
         if (it->isDone())
           addSubRegions(positions, new_overlapping, *it);
         else
           positions.push_back(*it);
+        for (int i = num_positions; i < positions.size(); ++i)
+          nearby_added.push_back(i);
         it = overlapping.erase(it);
       }
       else
@@ -116,28 +269,9 @@ namespace visage {
     overlapping.insert(overlapping.end(), new_overlapping.begin(), new_overlapping.end());
   }
 
-  static const SubmitBatch* nextBatch(const std::vector<RegionPosition>& positions,
-                                      const void* current_batch_id, BlendMode current_blend_mode) {
-    const SubmitBatch* next_batch = positions[0].currentBatch();
-    for (auto& position : positions) {
-      const SubmitBatch* batch = position.currentBatch();
-      if (next_batch->compare(batch) > 0) {
-        if (batch->compare(current_batch_id, current_blend_mode) > 0 ||
-            next_batch->compare(current_batch_id, current_blend_mode) < 0) {
-          next_batch = position.currentBatch();
-        }
-      }
-      else if (next_batch->compare(current_batch_id, current_blend_mode) < 0 &&
-               batch->compare(current_batch_id, current_blend_mode) > 0) {
-        next_batch = position.currentBatch();
-      }
-    }
-
-    return next_batch;
-  }
-
   Layer::Layer(GradientAtlas* gradient_atlas) : gradient_atlas_(gradient_atlas) {
     frame_buffer_data_ = std::make_unique<FrameBufferData>();
+    retained_geometry_ = std::make_unique<RetainedGeometry>();
     clear_brush_ = std::make_unique<const PackedBrush>(gradient_atlas, Brush::solid(0));
   }
 
@@ -169,8 +303,11 @@ namespace visage {
         frame_buffer_data_->read_back_handle = bgfx::createTexture2D(width_, height_, false, 1,
                                                                      bgfx::TextureFormat::RGBA8, flags);
       }
+      uint64_t flags = kFrameBufferFlags;
+      if (intermediate_layer_ && Renderer::instance().blitSupported())
+        flags |= BGFX_TEXTURE_BLIT_DST;
       frame_buffer_data_->handle = bgfx::createFrameBuffer(width_, height_, frame_buffer_data_->format,
-                                                           kFrameBufferFlags);
+                                                           flags);
     }
 
     bottom_left_origin_ = bgfx::getCaps()->originBottomLeft;
@@ -181,6 +318,10 @@ namespace visage {
       bgfx::destroy(frame_buffer_data_->handle);
       frame_buffer_data_->handle = BGFX_INVALID_HANDLE;
     }
+    if (bgfx::isValid(frame_buffer_data_->copy_source)) {
+      bgfx::destroy(frame_buffer_data_->copy_source);
+      frame_buffer_data_->copy_source = BGFX_INVALID_HANDLE;
+    }
   }
 
   bgfx::FrameBufferHandle& Layer::frameBuffer() const {
@@ -191,38 +332,66 @@ namespace visage {
     return frame_buffer_data_->format;
   }
 
-  void Layer::invalidateRectInRegion(IBounds rect, const Region* region) {
-    IBounds region_bounds = boundsForRegion(region);
-    rect = rect + IPoint(region_bounds.x(), region_bounds.y());
-    rect = rect.intersection(region_bounds);
+  bool Layer::setRetainedQuadBuffers(uint64_t key) {
+    key = hashCombine(key, gradient_atlas_->generation());
+    auto found = retained_geometry_->buffers.find(key);
+    if (found == retained_geometry_->buffers.end())
+      return false;
 
-    std::vector<IBounds>& invalid_rects = invalid_rects_[region];
+    found->second->used = true;
+    bgfx::setVertexBuffer(0, found->second->vertex_buffer);
+    setQuadIndexBuffer(found->second->num_quads);
+    return true;
+  }
 
-    for (auto it = invalid_rects.begin(); it != invalid_rects.end();) {
-      IBounds& invalid_rect = *it;
-      if (invalid_rect.contains(rect)) {
-        moveToVector(invalid_rects, invalid_rect_pieces_);
-        return;
-      }
+  bool Layer::retainQuadBuffers(uint64_t key, const void* vertices, int num_quads,
+                                const bgfx::VertexLayout& layout) {
+    if (num_quads > kMaxQuadsPerDraw)
+      return false;
+
+    auto buffers = std::make_unique<RetainedQuadBuffers>();
+    uint32_t vertex_bytes = num_quads * kVerticesPerQuad * layout.getStride();
+    buffers->vertex_buffer = bgfx::createVertexBuffer(bgfx::copy(vertices, vertex_bytes), layout);
+    buffers->num_quads = num_quads;
+    if (!bgfx::isValid(buffers->vertex_buffer))
+      return false;
+
+    bgfx::setVertexBuffer(0, buffers->vertex_buffer);
+    setQuadIndexBuffer(num_quads);
+    retained_geometry_->buffers[hashCombine(key, gradient_atlas_->generation())] = std::move(buffers);
+    return true;
+  }
 
-      if (rect.contains(invalid_rect)) {
-        it = invalid_rects.erase(it);
-        continue;
+  int Layer::numRetainedQuadBuffers() const {
+    return retained_geometry_->buffers.size();
+  }
+
+  void Layer::releaseUnusedRetainedBuffers() {
+    auto& buffers = retained_geometry_->buffers;
+    for (auto it = buffers.begin(); it != buffers.end();) {
+      if (it->second->used) {
+        it->second->used = false;
+        ++it;
       }
-      IBounds::breakIntoNonOverlapping(rect, invalid_rect, invalid_rect_pieces_);
-      ++it;
+      else
+        it = buffers.erase(it);
     }
+  }
 
-    invalid_rects.push_back(rect);
-    moveToVector(invalid_rects, invalid_rect_pieces_);
+  void Layer::invalidateRectInRegion(IBounds rect, const Region* region) {
+    IBounds region_bounds = boundsForRegion(region);
+    rect = rect + IPoint(region_bounds.x(), region_bounds.y());
+    rect = rect.intersection(region_bounds);
+
+    invalid_rects_[region].add(rect);
   }
 
   void Layer::clearInvalidRectAreas(int submit_pass) {
     ShapeBatch<Fill> clear_batch(BlendMode::Opaque);
-    std::vector<IBounds> invalid_rects;
+    DirtyRegion invalid_rects(std::numeric_limits<int>::max(), 0.0f);
     for (auto& region_invalid_rects : invalid_rects_) {
       for (const IBounds& rect : region_invalid_rects.second) {
-        invalid_rects.push_back(rect);
+        invalid_rects.add(rect);
         float x = rect.x();
         float y = rect.y();
         float width = rect.width();
@@ -235,8 +404,78 @@ namespace visage {
     clear_batch.submit(*this, submit_pass, { positioned_clear });
   }
 
+  void Layer::moveRegions(const std::map<const Region*, IBounds>& old_bounds) {
+    bool resized = width_ != atlas_map_.width() || height_ != atlas_map_.height();
+    std::vector<const Region*> moved;
+    for (const auto& old : old_bounds) {
+      if (!(boundsForRegion(old.first) == old.second))
+        moved.push_back(old.first);
+    }
+
+    if (!resized && moved.empty())
+      return;
+
+    // Regions that were already drawn are copied from the old frame buffer into their new spot
+    // at the next submit instead of being drawn again. A copy still waiting on an earlier move
+    // already points into the old frame buffer, so it's kept as is.
+    bool can_copy = bgfx::isValid(frame_buffer_data_->handle) &&
+                    Renderer::instance().blitSupported();
+    if (can_copy && !bgfx::isValid(frame_buffer_data_->copy_source)) {
+      frame_buffer_data_->copy_source = frame_buffer_data_->handle;
+      frame_buffer_data_->handle = BGFX_INVALID_HANDLE;
+      copied_regions_ = old_bounds;
+    }
+    else if (!bgfx::isValid(frame_buffer_data_->copy_source)) {
+      width_ = atlas_map_.width();
+      height_ = atlas_map_.height();
+      destroyFrameBuffer();
+      invalidate();
+      return;
+    }
+
+    width_ = atlas_map_.width();
+    height_ = atlas_map_.height();
+    for (const Region* region : moved) {
+      auto found = invalid_rects_.find(region);
+      if (found != invalid_rects_.end() && !found->second.isEmpty()) {
+        found->second.clear();
+        found->second.add(boundsForRegion(region));
+      }
+    }
+  }
+
+  void Layer::checkCopiedRegions() {
+    if (bgfx::isValid(frame_buffer_data_->copy_source))
+      return;
+
+    for (const auto& copied : copied_regions_)
+      invalid_rects_[copied.first].add(boundsForRegion(copied.first));
+    copied_regions_.clear();
+  }
+
+  void Layer::copyRegions(int submit_pass) {
+    if (!bgfx::isValid(frame_buffer_data_->copy_source))
+      return;
+
+    bgfx::TextureHandle source = bgfx::getTexture(frame_buffer_data_->copy_source);
+    bgfx::TextureHandle destination = bgfx::getTexture(frame_buffer_data_->handle);
+    for (const auto& copied : copied_regions_) {
+      IBounds from = copied.second;
+      IBounds to = boundsForRegion(copied.first);
+      bgfx::blit(submit_pass, destination, to.x(), to.y(), source, from.x(), from.y(),
+                 from.width(), from.height());
+    }
+
+    bgfx::destroy(frame_buffer_data_->copy_source);
+    frame_buffer_data_->copy_source = BGFX_INVALID_HANDLE;
+    copied_regions_.clear();
+  }
+
   int Layer::submit(int submit_pass) {
-    if (!anyInvalidRects())
+    num_draw_calls_ = 0;
+    num_submitted_shapes_ = 0;
+    checkCopiedRegions();
+    if (!anyInvalidRects() && copied_regions_.empty())
       return submit_pass;
 
     checkFrameBuffer();
@@ -246,60 +485,74 @@ namespace visage {
     if (bgfx::isValid(frame_buffer_data_->handle))
       bgfx::setViewFrameBuffer(submit_pass, frame_buffer_data_->handle);
 
+    copyRegions(submit_pass);
+
     if (intermediate_layer_)
       clearInvalidRectAreas(submit_pass);
 
-    std::vector<RegionPosition> region_positions;
+    std::vector<RegionPosition> added_positions;
     std::vector<RegionPosition> overlapping_regions;
     for (Region* region : regions_) {
       IPoint point = coordinatesForRegion(region);
-      if (region->isEmpty()) {
-        addSubRegions(region_positions, overlapping_regions,
-                      { region, invalid_rects_[region], 0, point.x, point.y });
-      }
+      RegionPosition position(region, invalid_rects_[region], 0, point.x, point.y);
+      hideUnderOpaqueSubRegions(position);
+      if (position.isDone())
+        addSubRegions(added_positions, overlapping_regions, position);
       else
-        region_positions.emplace_back(region, invalid_rects_[region], 0, point.x, point.y);
+        added_positions.push_back(std::move(position));
     }
 
     invalid_rects_.clear();
 
-    const void* current_batch_id = nullptr;
-    BlendMode current_blend_mode = BlendMode::Opaque;
+    std::deque<RegionPosition> region_positions;
+    BatchMerge merge;
+    auto add_positions = [&] {
+      for (RegionPosition& position : added_positions) {
+        position.order = region_positions.size();
+        region_positions.push_back(std::move(position));
+        merge.add(&region_positions.back());
+      }
+      added_positions.clear();
+    };
+    add_positions();
+
     std::vector<PositionedBatch> batches;
-    std::vector<RegionPosition> done_regions;
-
-    while (!region_positions.empty()) {
-      const SubmitBatch* next_batch = nextBatch(region_positions, current_batch_id, current_blend_mode);
-      for (auto& region_position : region_positions) {
-        SubmitBatch* batch = region_position.currentBatch();
-        if (batch->id() != next_batch->id() || batch->blendMode() != next_batch->blendMode())
-          continue;
-
-        batches.push_back({ batch, &region_position.invalid_rects, region_position.x,
-                            region_position.y });
-        region_position.position++;
+    std::vector<RegionPosition*> matching;
+    size_t first = 0;
+
+    while (!merge.isEmpty()) {
+      while (region_positions[first].isDone())
+        first++;
+
+      merge.takeNext(&region_positions[first], matching);
+      for (RegionPosition* region_position : matching) {
+        batches.push_back({ region_position->currentBatch(), &region_position->invalid_rects,
+                            region_position->x, region_position->y });
+        num_submitted_shapes_ += region_position->currentBatch()->areas().size();
+        region_position->position++;
       }
 
       batches.front().batch->submit(*this, submit_pass, batches);
       batches.clear();
 
-      auto done_it = std::partition(region_positions.begin(), region_positions.end(),
-                                    [](const RegionPosition& position) { return position.isDone(); });
-      done_regions.insert(done_regions.end(), std::make_move_iterator(region_positions.begin()),
-                          std::make_move_iterator(done_it));
-      region_positions.erase(region_positions.begin(), done_it);
-
-      for (auto& region_position : done_regions)
-        addSubRegions(region_positions, overlapping_regions, region_position);
-
-      if (!done_regions.empty())
-        checkOverlappingRegions(region_positions, overlapping_regions);
+      bool any_done = false;
+      for (RegionPosition* region_position : matching) {
+        if (region_position->isDone()) {
+          addSubRegions(added_positions, overlapping_regions, *region_position);
+          any_done = true;
+        }
+        else
+          merge.add(region_position);
+      }
+      matching.clear();
 
-      done_regions.clear();
-      current_batch_id = next_batch->id();
-      current_blend_mode = next_batch->blendMode();
+      if (any_done)
+        checkOverlappingRegions(merge, added_positions, overlapping_regions);
+      add_positions();
     }
 
+    releaseUnusedRetainedBuffers();
+
     if (screenshot_requested_ && bgfx::isValid(frame_buffer_data_->read_back_handle)) {
       screenshot_requested_ = false;
       bgfx::blit(submit_pass, frame_buffer_data_->read_back_handle, 0, 0,
@@ -328,16 +581,25 @@ namespace visage {
 
   void Layer::addPackedRegion(Region* region) {
     addRegion(region);
-    if (!atlas_map_.addRect(region, region->width(), region->height())) {
-      atlas_map_.pack();
-      invalidate();
-      setDimensions(atlas_map_.width(), atlas_map_.height());
+    if (atlas_map_.addRectInRemovedSpace(region, region->width(), region->height()) ||
+        atlas_map_.addRect(region, region->width(), region->height())) {
+      return;
     }
+
+    std::map<const Region*, IBounds> old_bounds;
+    for (const Region* packed : regions_) {
+      if (packed != region)
+        old_bounds[packed] = boundsForRegion(packed);
+    }
+
+    atlas_map_.grow();
+    moveRegions(old_bounds);
   }
 
   void Layer::removePackedRegion(const Region* region) {
     removeRegion(region);
     atlas_map_.removeRect(region);
+    copied_regions_.erase(region);
   }
 
   IBounds Layer::boundsForRegion(const Region* region) const {
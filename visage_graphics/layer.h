@@ -29,6 +29,7 @@
 namespace visage {
   class Region;
   struct FrameBufferData;
+  struct RetainedGeometry;
 
   class Layer {
   public:
@@ -48,6 +49,14 @@ namespace visage {
     void clearInvalidRectAreas(int submit_pass);
     int submit(int submit_pass);
 
+    bool setRetainedQuadBuffers(uint64_t key);
+    bool retainQuadBuffers(uint64_t key, const void* vertices, int num_quads,
+                           const bgfx::VertexLayout& layout);
+    int numRetainedQuadBuffers() const;
+    int numDrawCalls() const { return num_draw_calls_; }
+    void countDrawCall() const { num_draw_calls_++; }
+    int numSubmittedShapes() const { return num_submitted_shapes_; }
+
     void setIntermediateLayer(bool intermediate_layer) { intermediate_layer_ = intermediate_layer; }
     void addRegion(Region* region);
     void removeRegion(const Region* region) {
@@ -75,7 +84,7 @@ namespace visage {
     void invalidate() {
       invalid_rects_.clear();
       for (const auto& region : regions_)
-        invalid_rects_[region].push_back(boundsForRegion(region));
+        invalid_rects_[region].add(boundsForRegion(region));
     }
 
     void invalidateRectInRegion(IBounds rect, const Region* region);
@@ -126,15 +135,25 @@ namespace visage {
     void clear() {
       regions_.clear();
       atlas_map_.clear();
+      copied_regions_.clear();
     }
 
+    int numCopiedRegions() const { return copied_regions_.size(); }
+
   private:
+    void releaseUnusedRetainedBuffers();
+    void moveRegions(const std::map<const Region*, IBounds>& old_bounds);
+    void checkCopiedRegions();
+    void copyRegions(int submit_pass);
+
     bool bottom_left_origin_ = false;
     bool hdr_ = false;
     int width_ = 0;
     int height_ = 0;
     double render_time_ = 0.0;
     bool intermediate_layer_ = false;
+    mutable int num_draw_calls_ = 0;
+    int num_submitted_shapes_ = 0;
 
     void* window_handle_ = nullptr;
     bool headless_render_ = false;
@@ -144,9 +163,10 @@ namespace visage {
     GradientAtlas* gradient_atlas_ = nullptr;
     std::unique_ptr<const PackedBrush> clear_brush_;
     std::unique_ptr<FrameBufferData> frame_buffer_data_;
+    std::unique_ptr<RetainedGeometry> retained_geometry_;
     PackedAtlasMap<const Region*> atlas_map_;
-    std::map<const Region*, std::vector<IBounds>> invalid_rects_;
-    std::vector<IBounds> invalid_rect_pieces_;
+    std::map<const Region*, DirtyRegion> invalid_rects_;
+    std::map<const Region*, IBounds> copied_regions_;
     std::vector<Region*> regions_;
   };
 }
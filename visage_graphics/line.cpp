@@ -0,0 +1,123 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "line.h"
+
+#include "visage_utils/sample_ring.h"
+
+namespace visage {
+  int Line::decimationLevel(float scale) {
+    if (!min_max_decimation || offset || num_points < 2)
+      return -1;
+
+    float pixel_width = (x[num_points - 1] - x[0]) * scale;
+    if (pixel_width <= 0.0f)
+      return -1;
+
+    float points_per_pixel = num_points / pixel_width;
+    if (points_per_pixel < kMinDecimationRun)
+      return -1;
+
+    updateDecimation();
+    int num_levels = decimation_levels.size();
+    if (num_levels == 0)
+      return -1;
+
+    int level = 0;
+    while (level + 1 < num_levels && (kMinDecimationRun << (level + 1)) <= points_per_pixel)
+      level++;
+    return level;
+  }
+
+  void Line::readSamples(SampleRing& ring, float y_center, float y_scale) {
+    if (num_points == 0)
+      return;
+
+    ring.skip(std::max(0, ring.numAvailable() - num_points));
+    int num_samples = ring.numAvailable();
+    while (num_samples > 0) {
+      int num = ring.pop(y.data() + offset, std::min(num_samples, num_points - offset));
+      for (int i = offset; i < offset + num; ++i)
+        y[i] = y_center + y[i] * y_scale;
+
+      pointsChanged(offset, offset + num);
+      offset = (offset + num) % num_points;
+      num_samples -= num;
+    }
+  }
+
+  void Line::updateDecimation() {
+    if (decimation_levels.empty()) {
+      for (int run = kMinDecimationRun; run < num_points; run *= 2) {
+        int num_runs = (num_points + run - 1) / run;
+        decimation_levels.emplace_back(2 * num_runs);
+      }
+      dirty_start = 0;
+      dirty_end = num_points;
+    }
+
+    dirty_start = std::max(0, dirty_start);
+    dirty_end = std::min(num_points, dirty_end);
+    if (dirty_start >= dirty_end)
+      return;
+
+    auto set_run = [this](std::vector<int>& level, int run, const int* candidates,
+                          int num_candidates) {
+      int min_index = candidates[0];
+      int max_index = candidates[0];
+      for (int i = 1; i < num_candidates; ++i) {
+        if (y[candidates[i]] < y[min_index])
+          min_index = candidates[i];
+        if (y[candidates[i]] > y[max_index])
+          max_index = candidates[i];
+      }
+      level[2 * run] = std::min(min_index, max_index);
+      level[2 * run + 1] = std::max(min_index, max_index);
+    };
+
+    int num_levels = decimation_levels.size();
+    int run_size = kMinDecimationRun;
+    for (int l = 0; l < num_levels; ++l, run_size *= 2) {
+      std::vector<int>& level = decimation_levels[l];
+      int num_runs = level.size() / 2;
+      int last_run = std::min(num_runs - 1, (dirty_end - 1) / run_size);
+      for (int run = dirty_start / run_size; run <= last_run; ++run) {
+        if (l == 0) {
+          int start = run * run_size;
+          int end = std::min(num_points, start + run_size);
+          int candidates[kMinDecimationRun];
+          for (int i = start; i < end; ++i)
+            candidates[i - start] = i;
+          set_run(level, run, candidates, end - start);
+        }
+        else {
+          const std::vector<int>& below = decimation_levels[l - 1];
+          int first_child = 2 * run;
+          int num_children = std::min(2, static_cast<int>(below.size() / 2) - first_child);
+          set_run(level, run, below.data() + 2 * first_child, 2 * num_children);
+        }
+      }
+    }
+
+    dirty_start = num_points;
+    dirty_end = 0;
+  }
+}
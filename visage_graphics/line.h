@@ -21,10 +21,16 @@
 
 #pragma once
 
+#include <algorithm>
+#include <vector>
+
 namespace visage {
+  class SampleRing;
+
   struct Line {
     static constexpr int kLineVerticesPerPoint = 6;
     static constexpr int kFillVerticesPerPoint = 2;
+    static constexpr int kMinDecimationRun = 4;
 
     explicit Line(int points = 0) { setNumPoints(points); }
 
@@ -36,6 +42,45 @@ namespace visage {
       x.resize(num_points, 0.0f);
       y.resize(num_points, 0.0f);
       values.resize(num_points, 0.0f);
+      offset = 0;
+      decimation_levels.clear();
+      pointsChanged(0, num_points);
+    }
+
+    // Draws with a min/max pyramid of y values, like a peak file, when there are several points
+    // per pixel. Only valid when x increases with the point index and skipped while offset.
+    void setMinMaxDecimation(bool decimate) {
+      min_max_decimation = decimate;
+      decimation_levels.clear();
+      pointsChanged(0, num_points);
+    }
+
+    // Call after writing y values directly so the affected decimation runs are rebuilt.
+    void pointsChanged(int start, int end) {
+      dirty_start = std::min(dirty_start, start);
+      dirty_end = std::max(dirty_end, end);
+    }
+    void pointChanged(int index) { pointsChanged(index, index + 1); }
+
+    // Returns the decimation level for drawing at the given scale or -1 for every point.
+    // Brings the pyramid up to date so it must be called from the thread writing the points.
+    int decimationLevel(float scale);
+
+    // Pulls the newest samples out of the ring and writes them over the oldest points, moving
+    // offset instead of shifting the rest. A sample s ends up at y_center + s * y_scale.
+    void readSamples(SampleRing& ring, float y_center, float y_scale);
+
+    // Point i takes its y and value from this index, so y and values act as a circular buffer.
+    int storageIndex(int index) const {
+      int storage_index = index + offset;
+      return storage_index < num_points ? storage_index : storage_index - num_points;
+    }
+
+    int numDrawPoints(int level) const {
+      return level < 0 ? num_points : static_cast<int>(decimation_levels[level].size());
+    }
+    int drawPointIndex(int level, int index) const {
+      return level < 0 ? index : decimation_levels[level][index];
     }
 
     int num_points = 0;
@@ -45,8 +90,19 @@ namespace visage {
     std::vector<float> x {};
     std::vector<float> y {};
     std::vector<float> values {};
+    int offset = 0;
 
     float line_value_scale = 1.0f;
     float fill_value_scale = 1.0f;
+
+  private:
+    void updateDecimation();
+
+    bool min_max_decimation = false;
+    int dirty_start = 0;
+    int dirty_end = 0;
+    // Level n holds the indices of the min and max y, in index order, for each run of
+    // kMinDecimationRun << n points.
+    std::vector<std::vector<int>> decimation_levels;
   };
 }
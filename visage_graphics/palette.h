@@ -22,6 +22,8 @@
 #pragma once
 
 #include "color.h"
+#include "gradient.h"
+#include "theme.h"
 
 #include <iosfwd>
 #include <map>
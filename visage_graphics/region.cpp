@@ -23,6 +23,10 @@
 
 #include "canvas.h"
 
+#include <map>
+#include <queue>
+#include <set>
+
 namespace visage {
   void Region::invalidateRect(IBounds rect) {
     if (canvas_ == nullptr)
@@ -46,6 +50,107 @@ namespace visage {
     canvas_->invalidateRectInRegion(rect, region, region->layer_index_);
   }
 
+  const std::vector<Region::FlatRegion>& Region::flatSubRegions() {
+    if (flat_sub_regions_dirty_ || !flatSubRegionsMatch()) {
+      flat_sub_regions_.clear();
+      flattenSubRegions(flat_sub_regions_, 0, 0, nullptr);
+      flat_sub_regions_dirty_ = false;
+
+      opaque_sub_regions_.clear();
+      for (int i = 0; i < flat_sub_regions_.size(); ++i) {
+        if (flat_sub_regions_[i].opaque_bounds.hasArea())
+          opaque_sub_regions_.push_back(i);
+      }
+    }
+    return flat_sub_regions_;
+  }
+
+  // Sweeps the visible sub regions left to right, keeping the ones still spanning the sweep
+  // ordered by top edge. Only sub regions whose tops fall within the tallest active height above
+  // the current one get compared, so siblings laid out in rows or columns stay close to linear.
+  // Each overlapping pair flags the later sub region, the one that has to wait to be drawn.
+  std::vector<bool> Region::overlappingSubRegions() {
+    std::vector<int> order;
+    for (int i = 0; i < sub_regions_.size(); ++i) {
+      if (sub_regions_[i]->isVisible() && !sub_regions_[i]->drawsNothing())
+        order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(),
+              [this](int a, int b) { return sub_regions_[a]->x_ < sub_regions_[b]->x_; });
+
+    using ActiveMap = std::multimap<int, int>;
+    ActiveMap active;
+    std::vector<ActiveMap::iterator> active_positions(sub_regions_.size());
+    std::multiset<int> active_heights;
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<>> ends;
+
+    std::vector<bool> overlaps(sub_regions_.size(), false);
+    num_overlap_checks_ = 0;
+    for (int index : order) {
+      const Region* region = sub_regions_[index];
+      while (!ends.empty() && ends.top().first <= region->x_) {
+        int other = ends.top().second;
+        ends.pop();
+        active.erase(active_positions[other]);
+        active_heights.erase(active_heights.find(sub_regions_[other]->height_));
+      }
+
+      if (!active.empty()) {
+        int min_top = region->y_ - *active_heights.rbegin() + 1;
+        auto end = active.lower_bound(region->y_ + region->height_);
+        for (auto it = active.lower_bound(min_top); it != end; ++it) {
+          num_overlap_checks_++;
+          if (region->overlaps(sub_regions_[it->second]))
+            overlaps[std::max(index, it->second)] = true;
+        }
+      }
+
+      active_positions[index] = active.insert({ region->y_, index });
+      active_heights.insert(region->height_);
+      ends.push({ region->x_ + region->width_, index });
+    }
+    return overlaps;
+  }
+
+  void Region::flattenSubRegions(std::vector<FlatRegion>& flat, int x, int y, const IBounds* clip) {
+    std::vector<bool> overlaps = overlappingSubRegions();
+    for (int i = 0; i < sub_regions_.size(); ++i) {
+      Region* sub_region = sub_regions_[i];
+      sub_region->flattened_out_ = sub_region->drawsNothing();
+      if (!sub_region->isVisible() || sub_region->flattened_out_)
+        continue;
+
+      bool opaque = sub_region->isOpaque() && sub_region->postEffect() == nullptr;
+      if (sub_region->needsLayer())
+        sub_region = sub_region->intermediateRegion();
+
+      int index = flat.size();
+      int sub_x = x + sub_region->x();
+      int sub_y = y + sub_region->y();
+      IBounds bounds(sub_x, sub_y, sub_region->width(), sub_region->height());
+      if (clip)
+        bounds = bounds.intersection(*clip);
+
+      flat.push_back({ sub_region, sub_x, sub_y, index + 1, overlaps[i], false });
+      if (opaque)
+        flat[index].opaque_bounds = bounds;
+      if (!overlaps[i] && sub_region->isEmpty()) {
+        flat[index].container = true;
+        sub_region->flattenSubRegions(flat, sub_x, sub_y, &bounds);
+        flat[index].end = flat.size();
+      }
+    }
+  }
+
+  // Drawing into a region changes whether it's flattened through, so that's checked every time
+  // instead of tracked.
+  bool Region::flatSubRegionsMatch() const {
+    auto matches = [](const FlatRegion& flat) {
+      return flat.overlaps || flat.container == flat.region->isEmpty();
+    };
+    return std::all_of(flat_sub_regions_.begin(), flat_sub_regions_.end(), matches);
+  }
+
   Layer* Region::layer() const {
     return canvas_->layer(layer_index_);
   }
@@ -54,8 +159,8 @@ namespace visage {
     if (intermediate_region_) {
       intermediate_region_->setBounds(x_, y_, width_, height_);
       intermediate_region_->clearAll();
-      const PackedBrush* brush = intermediate_region_->addBrush(canvas_->gradientAtlas(),
-                                                                Brush::solid(0xffffffff));
+      const PackedBrush* brush = intermediate_region_->addBrush(
+          canvas_->brushCache()->solidBrush(Color(0xffffffff)));
       SampleRegion sample_region({ 0.0f, 0.0f, width_ * 1.0f, height_ * 1.0f }, brush, 0, 0, width_,
                                  height_, this, post_effect_);
       intermediate_region_->shape_batcher_.addShape(sample_region);
@@ -79,6 +184,9 @@ namespace visage {
       decrementLayer();
     }
 
+    if (parent_)
+      parent_->invalidateFlatSubRegions();
+
     invalidate();
   }
 
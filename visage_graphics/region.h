@@ -32,6 +32,19 @@ namespace visage {
   public:
     friend class Canvas;
 
+    // A visible sub region, x and y relative to the region it was flattened into. Sub regions
+    // that don't draw anything themselves are followed by their own sub regions up to end.
+    // Opaque ones keep the area they're guaranteed to cover once clipped by their containers.
+    struct FlatRegion {
+      Region* region = nullptr;
+      int x = 0;
+      int y = 0;
+      int end = 0;
+      bool overlaps = false;
+      bool container = false;
+      IBounds opaque_bounds;
+    };
+
     Region() = default;
 
     SubmitBatch* submitBatchAtPosition(int position) const {
@@ -39,6 +52,12 @@ namespace visage {
     }
     int numSubmitBatches() const { return shape_batcher_.numBatches(); }
     bool isEmpty() const { return shape_batcher_.isEmpty(); }
+    int numShapes() const {
+      int total = 0;
+      for (int i = 0; i < numSubmitBatches(); ++i)
+        total += submitBatchAtPosition(i)->areas().size();
+      return total;
+    }
     const std::vector<Region*>& subRegions() const { return sub_regions_; }
     int numRegions() const { return sub_regions_.size(); }
 
@@ -46,6 +65,7 @@ namespace visage {
       VISAGE_ASSERT(region->parent_ == nullptr);
       sub_regions_.push_back(region);
       region->parent_ = this;
+      invalidateFlatSubRegions();
 
       if (canvas_)
         region->setCanvas(canvas_);
@@ -58,6 +78,7 @@ namespace visage {
       region->parent_ = nullptr;
       region->setCanvas(nullptr);
       sub_regions_.erase(std::find(sub_regions_.begin(), sub_regions_.end(), region));
+      invalidateFlatSubRegions();
     }
 
     void setCanvas(Canvas* canvas) {
@@ -75,12 +96,36 @@ namespace visage {
       y_ = y;
       width_ = width;
       height_ = height;
+      if (parent_)
+        parent_->invalidateFlatSubRegions();
       setupIntermediateRegion();
       invalidate();
     }
 
-    void setVisible(bool visible) { visible_ = visible; }
+    void setRetainedGeometry(bool retained) { shape_batcher_.setRetainedGeometry(retained); }
+    bool retainedGeometry() const { return shape_batcher_.retainedGeometry(); }
+
+    void setVisible(bool visible) {
+      if (visible_ == visible)
+        return;
+
+      visible_ = visible;
+      if (parent_)
+        parent_->invalidateFlatSubRegions();
+    }
     bool isVisible() const { return visible_; }
+
+    // Opaque regions promise to cover their whole bounds so anything underneath can be skipped.
+    void setOpaque(bool opaque) {
+      if (opaque_ == opaque)
+        return;
+
+      opaque_ = opaque;
+      if (parent_)
+        parent_->invalidateFlatSubRegions();
+    }
+    bool isOpaque() const { return opaque_; }
+
     bool overlaps(const Region* other) const {
       return x_ < other->x_ + other->width_ && x_ + width_ > other->x_ &&
              y_ < other->y_ + other->height_ && y_ + height_ > other->y_;
@@ -102,9 +147,11 @@ namespace visage {
 
     void clear() {
       shape_batcher_.clear();
-      text_store_.clear();
+      pending_images_.clear();
+      text_store_.resize(num_texts_);
+      num_texts_ = 0;
       old_brushes_.clear();
-      old_brushes_ = std::move(brushes_);
+      old_brushes_.swap(brushes_);
     }
 
     void setupIntermediateRegion();
@@ -112,17 +159,27 @@ namespace visage {
     void setPostEffect(PostEffect* post_effect) {
       post_effect_ = post_effect;
       setupIntermediateRegion();
+      if (parent_)
+        parent_->invalidateFlatSubRegions();
     }
     PostEffect* postEffect() const { return post_effect_; }
     bool needsLayer() const { return intermediate_region_.get(); }
     Region* intermediateRegion() const { return intermediate_region_.get(); }
-    const PackedBrush* addBrush(GradientAtlas* atlas, const Brush& brush) {
-      brushes_.push_back(std::make_unique<PackedBrush>(atlas, brush));
-      return brushes_.back().get();
+    const std::vector<FlatRegion>& flatSubRegions();
+    const std::vector<int>& opaqueSubRegions() {
+      flatSubRegions();
+      return opaque_sub_regions_;
+    }
+    // Sibling pairs tested for overlap the last time this region's sub regions were flattened
+    int numOverlapChecks() const { return num_overlap_checks_; }
+    void invalidateFlatSubRegions() {
+      for (Region* region = this; region; region = region->parent_)
+        region->flat_sub_regions_dirty_ = true;
     }
-    const PackedBrush* addBrush(GradientAtlas* atlas, const Gradient& gradient,
-                                const GradientPosition& position) {
-      brushes_.push_back(std::make_unique<PackedBrush>(atlas, gradient, position));
+
+    const PackedBrush* addBrush(std::shared_ptr<const PackedBrush> brush) {
+      if (brushes_.empty() || brushes_.back() != brush)
+        brushes_.push_back(std::move(brush));
       return brushes_.back().get();
     }
 
@@ -132,11 +189,33 @@ namespace visage {
     void decrementLayer() { setLayerIndex(layer_index_ - 1); }
 
     Text* addText(const String& string, const Font& font, Font::Justification justification) {
-      text_store_.push_back(std::make_unique<Text>(string, font, justification));
-      return text_store_.back().get();
+      if (num_texts_ == text_store_.size()) {
+        text_store_.push_back(std::make_unique<Text>(string, font, justification));
+        return text_store_[num_texts_++].get();
+      }
+
+      Text* text = text_store_[num_texts_++].get();
+      text->setText(string);
+      text->setFont(font);
+      text->setJustification(justification);
+      text->setMultiLine(false);
+      text->setCharacterOverride(0);
+      return text;
+    }
+
+    void clearSubRegions() {
+      sub_regions_.clear();
+      invalidateFlatSubRegions();
     }
 
-    void clearSubRegions() { sub_regions_.clear(); }
+    bool drawsNothing() const { return !needsLayer() && isEmpty() && sub_regions_.empty(); }
+    std::vector<bool> overlappingSubRegions();
+    void flattenSubRegions(std::vector<FlatRegion>& flat, int x, int y, const IBounds* clip);
+    bool flatSubRegionsMatch() const;
+    void checkFlattenedOut() {
+      if (flattened_out_ && !drawsNothing() && parent_)
+        parent_->invalidateFlatSubRegions();
+    }
 
     void clearAll() {
       clear();
@@ -155,10 +234,18 @@ namespace visage {
     Region* parent_ = nullptr;
     PostEffect* post_effect_ = nullptr;
     ShapeBatcher shape_batcher_;
-    std::vector<std::unique_ptr<PackedBrush>> brushes_;
-    std::vector<std::unique_ptr<PackedBrush>> old_brushes_;
+    std::vector<std::shared_ptr<const PackedBrush>> brushes_;
+    std::vector<std::shared_ptr<const PackedBrush>> old_brushes_;
     std::vector<std::unique_ptr<Text>> text_store_;
+    int num_texts_ = 0;
+    std::vector<ImageAtlas::PackedImage> pending_images_;
     std::vector<Region*> sub_regions_;
+    std::vector<FlatRegion> flat_sub_regions_;
+    bool flat_sub_regions_dirty_ = true;
+    int num_overlap_checks_ = 0;
+    std::vector<int> opaque_sub_regions_;
+    bool flattened_out_ = false;
+    bool opaque_ = false;
     std::unique_ptr<Region> intermediate_region_;
   };
 }
\ No newline at end of file
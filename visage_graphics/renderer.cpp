@@ -101,6 +101,7 @@ namespace visage {
     bgfx_init.resolution.width = 0;
     bgfx_init.resolution.height = 0;
     bgfx_init.callback = callback_handler_.get();
+    bgfx_init.limits.transientVbSize = transient_vertex_buffer_size_;
 
     bgfx_init.platformData.ndt = display;
     bgfx_init.platformData.nwh = model_window;
@@ -142,6 +143,7 @@ namespace visage {
     bgfx::init(bgfx_init);
     VISAGE_ASSERT(bgfx::getRendererType() == bgfx_init.type);
     swap_chain_supported_ = bgfx::getCaps()->supported & BGFX_CAPS_SWAP_CHAIN;
+    blit_supported_ = bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_BLIT;
   }
 
   void Renderer::setScreenshotData(const uint8_t* data, int width, int height, int pitch, bool blue_red) {
@@ -29,18 +29,30 @@ namespace visage {
 
   class Renderer : public Thread {
   public:
+    static constexpr int kDefaultTransientVertexBufferSize = 16 << 20;
+
     static Renderer& instance();
 
     Renderer();
     ~Renderer() override;
 
     void checkInitialization(void* model_window, void* display);
+
+    // Bytes of per-frame vertex memory. Quads beyond this still draw from short lived
+    // buffers, just slower. Only takes effect before the renderer is initialized.
+    void setTransientVertexBufferSize(int bytes) {
+      VISAGE_ASSERT(!initialized_);
+      transient_vertex_buffer_size_ = bytes;
+    }
+    int transientVertexBufferSize() const { return transient_vertex_buffer_size_; }
+
     void setScreenshotData(const uint8_t* data, int width, int height, int pitch, bool blue_red);
     const Screenshot& screenshot() const { return screenshot_; }
 
     const std::string& errorMessage() const { return error_message_; }
     bool supported() const { return supported_; }
     bool swapChainSupported() const { return swap_chain_supported_; }
+    bool blitSupported() const { return blit_supported_; }
     bool initialized() const { return initialized_; }
 
   private:
@@ -51,6 +63,8 @@ namespace visage {
     bool initialized_ = false;
     bool supported_ = false;
     bool swap_chain_supported_ = false;
+    bool blit_supported_ = false;
+    int transient_vertex_buffer_size_ = kDefaultTransientVertexBufferSize;
 
     Screenshot screenshot_;
     std::string error_message_;
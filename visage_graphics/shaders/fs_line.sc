@@ -1,24 +1,22 @@
-$input v_shader_values, v_position
+$input v_shader_values, v_shader_values1, v_position, v_gradient_pos, v_gradient_color_pos
 
 #include <shader_include.sh>
 
-uniform vec4 u_gradient_color_position;
-uniform vec4 u_gradient_position;
-uniform vec4 u_line_width;
-uniform vec4 u_time;
-
 SAMPLER2D(s_gradient, 0);
 
 void main() {
-  vec2 gradient_pos = gradient(u_gradient_color_position.xy, u_gradient_color_position.zw, u_gradient_position.xy, u_gradient_position.zw, v_position);
+  vec2 gradient_pos = gradient(v_gradient_color_pos.xy, v_gradient_color_pos.zw, v_gradient_pos.xy, v_gradient_pos.zw, v_position);
   vec4 color = texture2D(s_gradient, gradient_pos);
 
+  float line_width = v_shader_values.z;
   float depth_out = v_shader_values.x;
   float dist_from_edge = min(depth_out, 1.0 - depth_out);
-  float mult = 1.0 + max(dist_from_edge - 2.0 / u_line_width.x, 0.0);
+  float mult = 1.0 + max(dist_from_edge - 2.0 / line_width, 0.0);
   vec4 result = min(1.0, mult) * color;
-  float scale = u_line_width.x * dist_from_edge;
+  float scale = line_width * dist_from_edge;
   result.a = min(result.a * scale * 0.5, 1.0);
   result.rgb = result.rgb * v_shader_values.y;
-  gl_FragColor = result;
+
+  vec2 inside = step(v_shader_values1.xy, v_position) * step(v_position, v_shader_values1.zw);
+  gl_FragColor = result * (inside.x * inside.y);
 }
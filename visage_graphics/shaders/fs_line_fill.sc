@@ -1,15 +1,16 @@
-$input v_shader_values, v_position
+$input v_shader_values, v_shader_values1, v_position, v_gradient_pos, v_gradient_color_pos
 
 #include <shader_include.sh>
 
-uniform vec4 u_gradient_color_position;
-uniform vec4 u_gradient_position;
 uniform vec4 u_color_mult;
 
 SAMPLER2D(s_gradient, 0);
 
 void main() {
-  vec2 gradient_pos = gradient(u_gradient_color_position.xy, u_gradient_color_position.zw, u_gradient_position.xy, u_gradient_position.zw, v_position);
+  vec2 gradient_pos = gradient(v_gradient_color_pos.xy, v_gradient_color_pos.zw, v_gradient_pos.xy, v_gradient_pos.zw, v_position);
   gl_FragColor = u_color_mult * texture2D(s_gradient, gradient_pos);
   gl_FragColor.a = (v_shader_values.y + 1.0) * gl_FragColor.a;
+
+  vec2 inside = step(v_shader_values1.xy, v_position) * step(v_position, v_shader_values1.zw);
+  gl_FragColor = gl_FragColor * (inside.x * inside.y);
 }
@@ -0,0 +1,42 @@
+$input v_coordinates, v_dimensions, v_shader_values, v_shader_values1, v_position, v_gradient_pos, v_gradient_color_pos, v_shape_kind
+
+#include <shader_include.sh>
+
+uniform vec4 u_color_mult;
+uniform vec4 u_origin_flip;
+
+SAMPLER2D(s_gradient, 0);
+
+void main() {
+  vec2 gradient_pos = gradient(v_gradient_color_pos.xy, v_gradient_color_pos.zw, v_gradient_pos.xy, v_gradient_pos.zw, v_position);
+  gl_FragColor = u_color_mult * texture2D(s_gradient, gradient_pos);
+
+  float shape_kind = floor(v_shape_kind + 0.5);
+  float alpha = 1.0;
+  if (shape_kind == 1.0)
+    alpha = rectangle(v_coordinates, v_dimensions, v_shader_values.x, v_shader_values.y);
+  else if (shape_kind == 2.0)
+    alpha = roundedRectangle(v_coordinates, v_dimensions, 2.0 * v_shader_values.z, v_shader_values.x, v_shader_values.y);
+  else if (shape_kind == 3.0)
+    alpha = circle(v_coordinates, v_dimensions.x, v_shader_values.x, v_shader_values.y);
+  else if (shape_kind == 4.0)
+    alpha = squircle(v_coordinates, v_dimensions, v_shader_values.z, v_shader_values.x, v_shader_values.y);
+  else if (shape_kind == 5.0)
+    alpha = flatArc(v_coordinates, v_shader_values1.xy, v_shader_values1.zw, v_dimensions.x, v_shader_values.x);
+  else if (shape_kind == 6.0)
+    alpha = arc(v_coordinates, v_shader_values1.xy, v_shader_values1.zw, v_dimensions.x, v_shader_values.x);
+  else if (shape_kind == 7.0)
+    alpha = roundedDiamond(v_coordinates, v_dimensions, 2.0 * v_shader_values.z, v_shader_values.x, v_shader_values.y);
+  else if (shape_kind == 8.0) {
+    vec2 flip_mult = vec2(1.0, u_origin_flip.x);
+    alpha = flatSegment(v_coordinates, v_dimensions, v_shader_values.zw * flip_mult, v_shader_values1.xy * flip_mult, v_shader_values.x);
+  }
+  else if (shape_kind == 9.0)
+    alpha = segment(v_coordinates, v_dimensions, v_shader_values.zw, v_shader_values1.xy, v_shader_values.x);
+  else if (shape_kind == 10.0)
+    alpha = trianglePoints(v_coordinates, v_dimensions, v_shader_values.zw, v_shader_values1.xy, v_shader_values1.zw, v_shader_values.x, v_shader_values.y);
+  else if (shape_kind == 11.0)
+    alpha = quadraticBezier(v_coordinates, v_dimensions, v_shader_values.zw, v_shader_values1.xy, v_shader_values1.zw, v_shader_values.x);
+
+  gl_FragColor.a = gl_FragColor.a * alpha;
+}
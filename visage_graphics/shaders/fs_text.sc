@@ -0,0 +1,16 @@
+$input v_coordinates, v_position, v_gradient_pos, v_gradient_color_pos, v_shader_values
+
+#include <shader_include.sh>
+
+uniform vec4 u_color_mult;
+
+SAMPLER2D(s_gradient, 0);
+SAMPLER2D(s_texture, 1);
+SAMPLER2D(s_texture2, 2);
+
+void main() {
+  vec2 gradient_pos = gradient(v_gradient_color_pos.xy, v_gradient_color_pos.zw, v_gradient_pos.xy, v_gradient_pos.zw, v_position);
+  vec4 glyph = vec4(1.0, 1.0, 1.0, texture2D(s_texture, v_coordinates).r);
+  vec4 emoji = texture2D(s_texture2, v_coordinates);
+  gl_FragColor = u_color_mult * texture2D(s_gradient, gradient_pos) * mix(glyph, emoji, v_shader_values.x);
+}
@@ -57,5 +57,7 @@ vec4 vec4_splat(float _x) { return vec4(_x, _x, _x, _x); }
 #define kPi 3.141592653589793238462643383279
 #define kArcRounded 1.5
 #define kArcFlat 0.5
+#define kCompactPixelRange 8191.75
+#define kCompactTextureRange 16383.5
 
 #include <shader_utils.sh>
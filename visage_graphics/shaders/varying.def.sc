@@ -4,6 +4,7 @@ vec2 v_dimensions         : TEXCOORD1 = vec2(0.0, 0.0);
 vec4 v_shader_values      : TEXCOORD2 = vec4(0.0, 0.0, 0.0, 0.0);
 vec4 v_shader_values1     : TEXCOORD3 = vec4(0.0, 0.0, 0.0, 0.0);
 vec2 v_position           : TEXCOORD4 = vec2(0.0, 0.0);
+float v_shape_kind        : TEXCOORD5 = 0.0;
 vec4 v_gradient_pos       : COLOR0    = vec4(0.0, 0.0, 1.0, 1.0);
 vec4 v_gradient_color_pos : COLOR1    = vec4(0.0, 0.0, 1.0, 1.0);
 
@@ -14,3 +15,10 @@ vec4 a_texcoord0     : TEXCOORD0;
 vec4 a_texcoord1     : TEXCOORD1;
 vec4 a_texcoord2     : TEXCOORD2;
 vec4 a_texcoord3     : TEXCOORD3;
+vec4 a_texcoord4     : TEXCOORD4;
+
+vec4 i_data0         : TEXCOORD7;
+vec4 i_data1         : TEXCOORD6;
+vec4 i_data2         : TEXCOORD5;
+vec4 i_data3         : TEXCOORD4;
+vec4 i_data4         : TEXCOORD3;
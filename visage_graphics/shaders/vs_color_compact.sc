@@ -0,0 +1,18 @@
+$input a_position, a_color0, a_color1, a_texcoord0, a_texcoord1
+$output v_position, v_gradient_pos, v_gradient_color_pos
+
+#include <shader_include.sh>
+
+uniform vec4 u_bounds;
+
+void main() {
+  vec2 position = a_position.xy * kCompactPixelRange;
+  vec2 min = a_texcoord1.xy * kCompactPixelRange;
+  vec2 max = a_texcoord1.zw * kCompactPixelRange;
+  vec2 clamped = clamp(position + a_texcoord0.xy * kCompactPixelRange, min, max);
+
+  v_position = clamped;
+  v_gradient_color_pos = a_color0;
+  v_gradient_pos = a_color1 * kCompactPixelRange;
+  gl_Position = vec4(clamped * u_bounds.xy + u_bounds.zw, 0.5, 1.0);
+}
@@ -0,0 +1,18 @@
+$input a_position, i_data0, i_data1, i_data2, i_data3
+$output v_position, v_gradient_pos, v_gradient_color_pos
+
+#include <shader_include.sh>
+
+uniform vec4 u_bounds;
+
+void main() {
+  vec2 position = i_data0.xy + (a_position.xy * 0.5 + vec2(0.5, 0.5)) * i_data0.zw;
+  vec2 min = i_data3.xy;
+  vec2 max = i_data3.zw;
+  vec2 clamped = clamp(position + a_position.xy, min, max);
+
+  v_position = clamped;
+  v_gradient_color_pos = i_data1;
+  v_gradient_pos = i_data2;
+  gl_Position = vec4(clamped * u_bounds.xy + u_bounds.zw, 0.5, 1.0);
+}
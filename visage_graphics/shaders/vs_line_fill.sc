@@ -1,17 +1,16 @@
-$input a_position, a_texcoord0
-$output v_shader_values, v_position
+$input a_position, a_color0, a_color1, a_texcoord0, a_texcoord1
+$output v_shader_values, v_shader_values1, v_position, v_gradient_pos, v_gradient_color_pos
 
 #include <shader_include.sh>
 
 uniform vec4 u_bounds;
-uniform vec4 u_center_position;
-uniform vec4 u_dimensions;
 
 void main() {
   v_position = a_position.xy;
-  v_shader_values.x = (a_position.y - u_center_position.y) / (1.0 - u_center_position.y);
-  v_shader_values.y = a_texcoord0.y;
+  v_gradient_color_pos = a_color0;
+  v_gradient_pos = a_color1;
+  v_shader_values = vec4(0.0, a_texcoord0.y, 0.0, 0.0);
+  v_shader_values1 = a_texcoord1;
   vec2 adjusted_position = a_position.xy * u_bounds.xy + u_bounds.zw;
-  v_shader_values.zw = abs(a_position.xy - u_center_position.xy) / u_dimensions.xy;
   gl_Position = vec4(adjusted_position, 0.5, 1.0);
 }
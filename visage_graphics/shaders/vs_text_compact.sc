@@ -0,0 +1,28 @@
+$input a_position, a_color0, a_color1, a_texcoord0, a_texcoord1, a_texcoord2
+$output v_coordinates, v_position, v_gradient_pos, v_gradient_color_pos, v_shader_values
+
+#include <shader_include.sh>
+
+uniform vec4 u_bounds;
+uniform vec4 u_atlas_scale;
+
+void main() {
+  vec2 position = a_position.xy * kCompactPixelRange;
+  vec4 texture_values = a_texcoord0 * kCompactTextureRange;
+  vec2 min = a_texcoord1.xy * kCompactPixelRange;
+  vec2 max = a_texcoord1.zw * kCompactPixelRange;
+  vec2 clamped = clamp(position, min, max);
+  vec2 delta = clamped - position;
+
+  float emoji = a_texcoord2.x;
+  vec2 atlas_scale = mix(u_atlas_scale.xy, u_atlas_scale.zw, emoji);
+
+  v_position = clamped;
+  v_gradient_color_pos = a_color0;
+  v_gradient_pos = a_color1 * kCompactPixelRange;
+  v_shader_values = vec4(emoji, 0.0, 0.0, 0.0);
+  vec2 rotated_delta = texture_values.z * delta + texture_values.w * delta.yx;
+  v_coordinates = (texture_values.xy + rotated_delta) * atlas_scale;
+  vec2 adjusted_position = clamped * u_bounds.xy + u_bounds.zw;
+  gl_Position = vec4(adjusted_position, 0.5, 1.0);
+}
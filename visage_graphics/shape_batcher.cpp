@@ -24,10 +24,12 @@
 #include "embedded/shaders.h"
 #include "font.h"
 #include "graphics_caches.h"
+#include "layer.h"
 #include "line.h"
 #include "shader.h"
 #include "uniforms.h"
 #include "visage_utils/space.h"
+#include "visage_utils/thread_utils.h"
 
 #include <bgfx/bgfx.h>
 
@@ -83,26 +85,9 @@ namespace visage {
     bgfx::setTexture(stage, uniform, handle);
   }
 
-  inline void setUniformBounds(int x, int y, int width, int height) {
-    float scale_x = 2.0f / width;
-    float scale_y = -2.0f / height;
-    float view_bounds[4] = { scale_x, scale_y, x * scale_x - 1.0f, y * scale_y + 1.0f };
-    setUniform<Uniforms::kBounds>(view_bounds);
-  }
-
-  inline void setScissor(const BaseShape& shape, int full_width, int full_height) {
-    const ClampBounds& clamp = shape.clamp;
-    int width = std::min<int>(shape.width, clamp.right - clamp.left);
-    int height = std::min<int>(shape.height, clamp.bottom - clamp.top);
-    int x = std::max<int>(shape.x, clamp.left);
-    int y = std::max<int>(shape.y, clamp.top);
-
-    int scissor_x = std::min(full_width, std::max<int>(0, x));
-    int scissor_y = std::min(full_height, std::max<int>(0, y));
-    int scissor_right = std::min(full_width, std::max<int>(0, x + width));
-    int scissor_bottom = std::min(full_height, std::max<int>(0, y + height));
-    if (scissor_x < scissor_right && scissor_y < scissor_bottom)
-      bgfx::setScissor(scissor_x, scissor_y, scissor_right - scissor_x, scissor_bottom - scissor_y);
+  inline void submitDraw(const Layer& layer, int submit_pass, bgfx::ProgramHandle program) {
+    layer.countDrawCall();
+    bgfx::submit(submit_pass, program);
   }
 
   inline float inverseSqrt(float value) {
@@ -126,19 +111,25 @@ namespace visage {
     return point * inverseMagnitudeOfPoint(point);
   }
 
-  static void setLineVertices(const LineWrapper& line_wrapper, bgfx::TransientVertexBuffer vertex_buffer) {
-    LineVertex* line_data = reinterpret_cast<LineVertex*>(vertex_buffer.data);
+  static void setLineVertices(const LineWrapper& line_wrapper, LineVertex* line_data) {
     Line* line = line_wrapper.line;
+    int level = line_wrapper.decimation_level;
+    int num_points = line->numDrawPoints(level);
 
-    for (int i = 0; i < line->num_line_vertices; i += 2) {
+    for (int i = 0; i < num_points * Line::kLineVerticesPerPoint; i += 2) {
       line_data[i].fill = 0.0f;
       line_data[i + 1].fill = 1.0f;
     }
 
+    auto line_point = [line, level](int i) {
+      int index = line->drawPointIndex(level, i);
+      return Point(line->x[index], line->y[line->storageIndex(index)]);
+    };
+
     Point prev_normalized_delta;
-    for (int i = 0; i < line->num_points - 1; ++i) {
-      if (line->x[i] != line->x[i + 1] || line->y[i] != line->y[i + 1]) {
-        prev_normalized_delta = normalize(Point(line->x[i + 1] - line->x[i], line->y[i + 1] - line->y[i]));
+    for (int i = 0; i < num_points - 1; ++i) {
+      if (!(line_point(i) == line_point(i + 1))) {
+        prev_normalized_delta = normalize(line_point(i + 1) - line_point(i));
         break;
       }
     }
@@ -148,12 +139,12 @@ namespace visage {
     float prev_magnitude = radius;
     float scale = line_wrapper.scale;
 
-    for (int i = 0; i < line->num_points; ++i) {
-      Point point(line->x[i] * scale, line->y[i] * scale);
+    for (int i = 0; i < num_points; ++i) {
+      Point point = line_point(i) * scale;
       int next_index = i + 1;
-      int clamped_next_index = std::min(next_index, line->num_points - 1);
+      int clamped_next_index = std::min(next_index, num_points - 1);
 
-      Point next_point(line->x[clamped_next_index] * scale, line->y[clamped_next_index] * scale);
+      Point next_point = line_point(clamped_next_index) * scale;
       Point delta = next_point - point;
       if (point == next_point)
         delta = prev_normalized_delta;
@@ -218,7 +209,8 @@ namespace visage {
 
       int index = i * Line::kLineVerticesPerPoint;
 
-      float value = line->values[i] * line->line_value_scale;
+      int storage_index = line->storageIndex(line->drawPointIndex(level, i));
+      float value = line->values[storage_index] * line->line_value_scale;
       line_data[index].x = x1;
       line_data[index].y = y1;
       line_data[index].value = value;
@@ -271,36 +263,130 @@ namespace visage {
     setUniform<Uniforms::kOriginFlip>(flip);
   }
 
-  bool initTransientQuadBuffers(int num_quads, const bgfx::VertexLayout& layout,
-                                bgfx::TransientVertexBuffer* vertex_buffer,
-                                bgfx::TransientIndexBuffer* index_buffer) {
-    int num_vertices = num_quads * kVerticesPerQuad;
-    int num_indices = num_quads * kIndicesPerQuad;
-    if (!bgfx::allocTransientBuffers(vertex_buffer, layout, num_vertices, index_buffer, num_indices)) {
+  void setQuadIndexBuffer(int num_quads) {
+    VISAGE_ASSERT(num_quads <= kMaxQuadsPerDraw);
+    bgfx::setIndexBuffer(QuadBufferCache::quadIndexBuffer(), 0, num_quads * kIndicesPerQuad);
+  }
+
+  int maxTransientQuads(const bgfx::VertexLayout& layout) {
+    int max_vertices = kMaxQuadsPerDraw * kVerticesPerQuad;
+    return bgfx::getAvailTransientVertexBuffer(max_vertices, layout) / kVerticesPerQuad;
+  }
+
+  uint8_t* initQuadVerticesWithLayout(int num_quads, const bgfx::VertexLayout& layout) {
+    if (num_quads > maxTransientQuads(layout)) {
       VISAGE_LOG("Not enough transient buffer memory for %d quads", num_quads);
-      return false;
+      return nullptr;
     }
 
-    uint16_t* indices = reinterpret_cast<uint16_t*>(index_buffer->data);
-    for (int i = 0; i < num_quads; ++i) {
-      int vertex_index = i * kVerticesPerQuad;
-      int index = i * kIndicesPerQuad;
-      for (int v = 0; v < kIndicesPerQuad; ++v)
-        indices[index + v] = vertex_index + kQuadTriangles[v];
+    bgfx::TransientVertexBuffer vertex_buffer {};
+    bgfx::allocTransientVertexBuffer(&vertex_buffer, num_quads * kVerticesPerQuad, layout);
+    bgfx::setVertexBuffer(0, &vertex_buffer);
+    setQuadIndexBuffer(num_quads);
+    return vertex_buffer.data;
+  }
+
+  // Splits the quads into draws that fit the 16-bit index range. Each draw goes through the
+  // transient buffer while it has room, after that through a vertex buffer that lives for
+  // a single frame so nothing gets dropped when the transient budget runs out.
+  void submitQuadChunks(const void* vertices, int num_quads, const bgfx::VertexLayout& layout,
+                        const std::function<void()>& submit_chunk) {
+    const uint8_t* data = static_cast<const uint8_t*>(vertices);
+    int quad_stride = kVerticesPerQuad * layout.getStride();
+    for (int start = 0; start < num_quads; start += kMaxQuadsPerDraw) {
+      int chunk_quads = std::min(num_quads - start, kMaxQuadsPerDraw);
+      const uint8_t* chunk_data = data + static_cast<size_t>(start) * quad_stride;
+      if (chunk_quads <= maxTransientQuads(layout)) {
+        uint8_t* destination = initQuadVerticesWithLayout(chunk_quads, layout);
+        std::memcpy(destination, chunk_data, chunk_quads * quad_stride);
+        submit_chunk();
+        continue;
+      }
+
+      bgfx::VertexBufferHandle vertex_buffer =
+          bgfx::createVertexBuffer(bgfx::copy(chunk_data, chunk_quads * quad_stride), layout);
+      if (!bgfx::isValid(vertex_buffer)) {
+        VISAGE_LOG("Couldn't create vertex buffer for %d quads", chunk_quads);
+        return;
+      }
+
+      bgfx::setVertexBuffer(0, vertex_buffer);
+      setQuadIndexBuffer(chunk_quads);
+      submit_chunk();
+      bgfx::destroy(vertex_buffer);
     }
+  }
 
-    return true;
+  const EmbeddedFile* compactVertexShader(const EmbeddedFile& vertex_shader) {
+    if ((bgfx::getCaps()->supported & BGFX_CAPS_VERTEX_ATTRIB_HALF) == 0)
+      return nullptr;
+
+    if (&vertex_shader == &shaders::vs_shape)
+      return &shaders::vs_shape_compact;
+    if (&vertex_shader == &shaders::vs_color)
+      return &shaders::vs_color_compact;
+    if (&vertex_shader == &shaders::vs_arc)
+      return &shaders::vs_arc_compact;
+    if (&vertex_shader == &shaders::vs_complex_shape)
+      return &shaders::vs_complex_shape_compact;
+    if (&vertex_shader == &shaders::vs_tinted_texture)
+      return &shaders::vs_tinted_texture_compact;
+    if (&vertex_shader == &shaders::vs_text)
+      return &shaders::vs_text_compact;
+    return nullptr;
   }
 
-  uint8_t* initQuadVerticesWithLayout(int num_quads, const bgfx::VertexLayout& layout) {
-    bgfx::TransientVertexBuffer vertex_buffer {};
-    bgfx::TransientIndexBuffer index_buffer {};
-    if (!initTransientQuadBuffers(num_quads, layout, &vertex_buffer, &index_buffer))
+  bool setRetainedQuadBuffers(Layer& layer, uint64_t key) {
+    return layer.setRetainedQuadBuffers(key);
+  }
+
+  bool retainQuadBuffers(Layer& layer, uint64_t key, const void* vertices, int num_quads,
+                         const bgfx::VertexLayout& layout) {
+    return layer.retainQuadBuffers(key, vertices, num_quads, layout);
+  }
+
+  static std::atomic<bool> parallel_vertex_generation = true;
+
+  static WorkerPool* vertexWorkers() {
+    static constexpr int kMaxWorkers = 7;
+    int num_workers = std::clamp(static_cast<int>(std::thread::hardware_concurrency()) - 1, 0, kMaxWorkers);
+    static WorkerPool workers(num_workers, "Vertex Worker");
+    return &workers;
+  }
+
+  void setParallelVertexGeneration(bool parallel) {
+    parallel_vertex_generation = parallel;
+  }
+
+  bool parallelVertexGeneration() {
+    return parallel_vertex_generation;
+  }
+
+  void runVertexJobs(int num_jobs, const std::function<void(int)>& job) {
+    vertexWorkers()->run(num_jobs, job);
+  }
+
+  bool instancedShapesSupported() {
+    return bgfx::getCaps()->supported & BGFX_CAPS_INSTANCING;
+  }
+
+  static void setUnitQuadBuffers() {
+    bgfx::setVertexBuffer(0, QuadBufferCache::unitQuadVertexBuffer());
+    bgfx::setIndexBuffer(QuadBufferCache::unitQuadIndexBuffer());
+  }
+
+  uint8_t* initQuadInstances(int num_instances, int instance_stride) {
+    VISAGE_ASSERT(instance_stride % 16 == 0);
+    if (bgfx::getAvailInstanceDataBuffer(num_instances, instance_stride) != num_instances) {
+      VISAGE_LOG("Not enough instance buffer memory for %d quads", num_instances);
       return nullptr;
+    }
 
-    bgfx::setVertexBuffer(0, &vertex_buffer);
-    bgfx::setIndexBuffer(&index_buffer);
-    return vertex_buffer.data;
+    bgfx::InstanceDataBuffer instance_buffer {};
+    bgfx::allocInstanceDataBuffer(&instance_buffer, num_instances, instance_stride);
+    setUnitQuadBuffers();
+    bgfx::setInstanceDataBuffer(&instance_buffer);
+    return instance_buffer.data;
   }
 
   void submitShapes(const Layer& layer, const EmbeddedFile& vertex_shader,
@@ -311,130 +397,190 @@ namespace visage {
     setOriginFlipUniform(layer.bottomLeftOrigin());
     GradientAtlas* gradient_atlas = layer.gradientAtlas();
     setTexture<Uniforms::kGradient>(0, gradient_atlas->colorTextureHandle());
-    bgfx::submit(submit_pass, ProgramCache::programHandle(vertex_shader, fragment_shader));
+    submitDraw(layer, submit_pass, ProgramCache::programHandle(vertex_shader, fragment_shader));
   }
 
-  void submitLine(const LineWrapper& line_wrapper, const Layer& layer, int submit_pass) {
-    Line* line = line_wrapper.line;
-    if (bgfx::getAvailTransientVertexBuffer(line->num_line_vertices, LineVertex::layout()) !=
-        line->num_line_vertices)
-      return;
-
-    bgfx::TransientVertexBuffer vertex_buffer {};
-    bgfx::allocTransientVertexBuffer(&vertex_buffer, line->num_line_vertices, LineVertex::layout());
-    setLineVertices(line_wrapper, vertex_buffer);
-
-    bgfx::setState(blendModeValue(BlendMode::Alpha) | BGFX_STATE_PT_TRISTRIP);
-
-    float dimensions[4] = { line_wrapper.width, line_wrapper.height, 1.0f, 1.0f };
-    float time[] = { static_cast<float>(layer.time()), 0.0f, 0.0f, 0.0f };
-
-    auto pos = PackedBrush::computeVertexGradientPositions(line_wrapper.brush, 0, 0, 0, 0,
-                                                           line_wrapper.width, line_wrapper.height);
-    float gradient_color_pos[] = { pos.gradient_color_from_x, pos.gradient_color_y,
-                                   pos.gradient_color_to_x, pos.gradient_color_y };
-    float gradient_pos[] = { pos.gradient_position_from_x, pos.gradient_position_from_y,
-                             pos.gradient_position_to_x, pos.gradient_position_to_y };
-    float line_width[] = { line_wrapper.line_width * 2.0f, 0.0f, 0.0f, 0.0f };
-    setUniform<Uniforms::kDimensions>(dimensions);
-    setUniform<Uniforms::kTime>(time);
-    setUniform<Uniforms::kGradientColorPosition>(gradient_color_pos);
-    setUniform<Uniforms::kGradientPosition>(gradient_pos);
-    setUniform<Uniforms::kLineWidth>(line_width);
-    setTexture<Uniforms::kGradient>(0, layer.gradientAtlas()->colorTextureHandle());
-
-    bgfx::setVertexBuffer(0, &vertex_buffer);
-    setUniformBounds(line_wrapper.x, line_wrapper.y, layer.width(), layer.height());
-    setColorMult(layer.hdr());
-    setScissor(line_wrapper, layer.width(), layer.height());
-    auto program = ProgramCache::programHandle(LineWrapper::vertexShader(), LineWrapper::fragmentShader());
-    bgfx::submit(submit_pass, program);
-  }
-
-  static void setFillVertices(const LineFillWrapper& line_fill_wrapper,
-                              const bgfx::TransientVertexBuffer& vertex_buffer) {
-    LineVertex* fill_data = reinterpret_cast<LineVertex*>(vertex_buffer.data);
+  static void setFillVertices(const LineFillWrapper& line_fill_wrapper, LineVertex* fill_data) {
     Line* line = line_fill_wrapper.line;
+    int level = line_fill_wrapper.decimation_level;
 
     float scale = line_fill_wrapper.scale;
     int fill_location = line_fill_wrapper.fill_center;
-    for (int i = 0; i < line->num_points; ++i) {
+    int num_points = line->numDrawPoints(level);
+    for (int i = 0; i < num_points; ++i) {
       int index_top = i * Line::kFillVerticesPerPoint;
       int index_bottom = index_top + 1;
-      float x = line->x[i] * scale;
-      float y = line->y[i] * scale;
-      float value = line->values[i] * line->fill_value_scale;
+      int point_index = line->drawPointIndex(level, i);
+      int storage_index = line->storageIndex(point_index);
+      float x = line->x[point_index] * scale;
+      float y = line->y[storage_index] * scale;
+      float value = line->values[storage_index] * line->fill_value_scale;
       fill_data[index_top].x = x;
       fill_data[index_top].y = y;
+      fill_data[index_top].fill = 0.0f;
       fill_data[index_top].value = value;
       fill_data[index_bottom].x = x;
       fill_data[index_bottom].y = fill_location;
+      fill_data[index_bottom].fill = 1.0f;
       fill_data[index_bottom].value = value;
     }
   }
 
-  void submitLineFill(const LineFillWrapper& line_fill_wrapper, const Layer& layer, int submit_pass) {
-    Line* line = line_fill_wrapper.line;
-    if (bgfx::getAvailTransientVertexBuffer(line->num_fill_vertices, LineVertex::layout()) !=
-        line->num_fill_vertices)
-      return;
+  static void setLineAttributes(const BaseShape& shape, float line_width, LineVertex* vertices,
+                                int num_vertices) {
+    PackedBrush::setVertexGradientPositions(shape.brush, vertices, num_vertices, shape.x, shape.y,
+                                            shape.x, shape.y, shape.x + shape.width,
+                                            shape.y + shape.height);
+
+    ClampBounds clamp = shape.clamp.clamp(shape.x, shape.y, shape.width, shape.height);
+    for (int i = 0; i < num_vertices; ++i) {
+      vertices[i].x += shape.x;
+      vertices[i].y += shape.y;
+      vertices[i].line_width = line_width;
+      vertices[i].clamp_left = clamp.left;
+      vertices[i].clamp_top = clamp.top;
+      vertices[i].clamp_right = clamp.right;
+      vertices[i].clamp_bottom = clamp.bottom;
+    }
+  }
 
-    float dimension_y_scale = line_fill_wrapper.fill_center / line_fill_wrapper.height;
-    float dimensions[4] = { line_fill_wrapper.width, line_fill_wrapper.height * dimension_y_scale,
-                            1.0f, 1.0f };
-    float time[] = { static_cast<float>(layer.time()), 0.0f, 0.0f, 0.0f };
-    auto pos = PackedBrush::computeVertexGradientPositions(line_fill_wrapper.brush, 0, 0, 0, 0,
-                                                           line_fill_wrapper.width,
-                                                           line_fill_wrapper.height);
-    float gradient_color_pos[] = { pos.gradient_color_from_x, pos.gradient_color_y,
-                                   pos.gradient_color_to_x, pos.gradient_color_y };
-    float gradient_pos[] = { pos.gradient_position_from_x, pos.gradient_position_from_y,
-                             pos.gradient_position_to_x, pos.gradient_position_to_y };
-
-    float fill_location = static_cast<int>(line_fill_wrapper.fill_center);
-    float center[] = { 0.0f, fill_location, 0.0f, 0.0f };
-
-    bgfx::TransientVertexBuffer fill_vertex_buffer {};
-    bgfx::allocTransientVertexBuffer(&fill_vertex_buffer, line->num_fill_vertices, LineVertex::layout());
-    setFillVertices(line_fill_wrapper, fill_vertex_buffer);
+  static int numStripVertices(const LineWrapper& line_wrapper) {
+    int num_points = line_wrapper.line->numDrawPoints(line_wrapper.decimation_level);
+    return Line::kLineVerticesPerPoint * num_points;
+  }
 
-    bgfx::setState(blendModeValue(BlendMode::Alpha) | BGFX_STATE_PT_TRISTRIP);
-    setUniform<Uniforms::kDimensions>(dimensions);
-    setUniform<Uniforms::kTime>(time);
-    setUniform<Uniforms::kGradientColorPosition>(gradient_color_pos);
-    setUniform<Uniforms::kGradientPosition>(gradient_pos);
-    setUniform<Uniforms::kCenterPosition>(center);
+  static int numStripVertices(const LineFillWrapper& line_fill_wrapper) {
+    int num_points = line_fill_wrapper.line->numDrawPoints(line_fill_wrapper.decimation_level);
+    return Line::kFillVerticesPerPoint * num_points;
+  }
 
-    setTexture<Uniforms::kGradient>(0, layer.gradientAtlas()->colorTextureHandle());
+  static void setStripVertices(const LineWrapper& line_wrapper, LineVertex* vertices) {
+    setLineVertices(line_wrapper, vertices);
+    setLineAttributes(line_wrapper, line_wrapper.line_width * 2.0f, vertices,
+                      numStripVertices(line_wrapper));
+  }
 
-    bgfx::setVertexBuffer(0, &fill_vertex_buffer);
-    setUniformBounds(line_fill_wrapper.x, line_fill_wrapper.y, layer.width(), layer.height());
-    setScissor(line_fill_wrapper, layer.width(), layer.height());
-    setColorMult(layer.hdr());
-    auto program = ProgramCache::programHandle(LineFillWrapper::vertexShader(),
-                                               LineFillWrapper::fragmentShader());
-    bgfx::submit(submit_pass, program);
+  static void setStripVertices(const LineFillWrapper& line_fill_wrapper, LineVertex* vertices) {
+    setFillVertices(line_fill_wrapper, vertices);
+    setLineAttributes(line_fill_wrapper, 0.0f, vertices, numStripVertices(line_fill_wrapper));
   }
 
-  void submitImages(const BatchVector<ImageWrapper>& batches, const Layer& layer, int submit_pass) {
-    if (!setupQuads(batches))
+  template<typename T>
+  static int numStripVertices(const BatchVector<T>& batches) {
+    int num_vertices = 0;
+    int num_strips = 0;
+    for (const auto& batch : batches) {
+      for (const T& shape : *batch.shapes) {
+        int strip_vertices = numStripVertices(shape);
+        if (strip_vertices) {
+          num_vertices += strip_vertices;
+          num_strips++;
+        }
+      }
+    }
+    return num_vertices + 2 * std::max(0, num_strips - 1);
+  }
+
+  // Strips are joined with a repeated vertex on each side so the triangles between them are
+  // degenerate, letting every line in the batch go out in a single draw.
+  template<typename T>
+  static int setStripVertices(const BatchVector<T>& batches, LineVertex* vertices) {
+    int vertex_index = 0;
+    for (const auto& batch : batches) {
+      for (const T& shape : *batch.shapes) {
+        int strip_vertices = numStripVertices(shape);
+        if (strip_vertices == 0)
+          continue;
+
+        T positioned = shape;
+        positioned.x = batch.x + shape.x;
+        positioned.y = batch.y + shape.y;
+        positioned.clamp = shape.clamp.withOffset(batch.x, batch.y);
+
+        int start = vertex_index ? vertex_index + 2 : 0;
+        setStripVertices(positioned, vertices + start);
+        if (vertex_index) {
+          vertices[vertex_index] = vertices[vertex_index - 1];
+          vertices[vertex_index + 1] = vertices[start];
+        }
+        vertex_index = start + strip_vertices;
+      }
+    }
+    return vertex_index;
+  }
+
+  int numLineVertices(const BatchVector<LineWrapper>& batches) {
+    return numStripVertices(batches);
+  }
+
+  int setLineVertices(const BatchVector<LineWrapper>& batches, LineVertex* vertices) {
+    return setStripVertices(batches, vertices);
+  }
+
+  int numLineFillVertices(const BatchVector<LineFillWrapper>& batches) {
+    return numStripVertices(batches);
+  }
+
+  int setLineFillVertices(const BatchVector<LineFillWrapper>& batches, LineVertex* vertices) {
+    return setStripVertices(batches, vertices);
+  }
+
+  template<typename T>
+  static void submitStrips(const BatchVector<T>& batches, const Layer& layer, int submit_pass) {
+    int num_vertices = numStripVertices(batches);
+    if (num_vertices == 0)
       return;
 
-    const ImageAtlas* image_atlas = batches[0].shapes->front().image_atlas;
-    setBlendMode(BlendMode::Alpha);
-    float atlas_scale[] = { 1.0f / image_atlas->width(), 1.0f / image_atlas->height(), 0.0f, 0.0f };
-    setUniform<Uniforms::kAtlasScale>(atlas_scale);
+    if (bgfx::getAvailTransientVertexBuffer(num_vertices, LineVertex::layout()) != num_vertices) {
+      VISAGE_LOG("Not enough transient buffer memory for %d line vertices", num_vertices);
+      return;
+    }
+
+    bgfx::TransientVertexBuffer vertex_buffer {};
+    bgfx::allocTransientVertexBuffer(&vertex_buffer, num_vertices, LineVertex::layout());
+    setStripVertices(batches, reinterpret_cast<LineVertex*>(vertex_buffer.data));
+
+    bgfx::setState(blendModeValue(BlendMode::Alpha) | BGFX_STATE_PT_TRISTRIP);
+    bgfx::setVertexBuffer(0, &vertex_buffer);
     setTexture<Uniforms::kGradient>(0, layer.gradientAtlas()->colorTextureHandle());
-    setTexture<Uniforms::kTexture>(1, image_atlas->textureHandle());
     setUniformDimensions(layer.width(), layer.height());
     setColorMult(layer.hdr());
+    submitDraw(layer, submit_pass, ProgramCache::programHandle(T::vertexShader(), T::fragmentShader()));
+  }
 
-    auto program = ProgramCache::programHandle(ImageWrapper::vertexShader(),
-                                               ImageWrapper::fragmentShader());
-    bgfx::submit(submit_pass, program);
+  void submitLines(const BatchVector<LineWrapper>& batches, const Layer& layer, int submit_pass) {
+    submitStrips(batches, layer, submit_pass);
+  }
+
+  void submitLineFills(const BatchVector<LineFillWrapper>& batches, const Layer& layer, int submit_pass) {
+    submitStrips(batches, layer, submit_pass);
+  }
+
+  void submitImages(const BatchVector<ImageWrapper>& batches, const Layer& layer, int submit_pass) {
+    const ImageAtlas* image_atlas = batches[0].shapes->front().image_atlas;
+    auto submit = [&](const EmbeddedFile& vertex_shader) {
+      setBlendMode(BlendMode::Alpha);
+      float atlas_scale[] = { 1.0f / image_atlas->width(), 1.0f / image_atlas->height(), 0.0f, 0.0f };
+      setUniform<Uniforms::kAtlasScale>(atlas_scale);
+      setTexture<Uniforms::kGradient>(0, layer.gradientAtlas()->colorTextureHandle());
+      setTexture<Uniforms::kTexture>(1, image_atlas->textureHandle());
+      setUniformDimensions(layer.width(), layer.height());
+      setColorMult(layer.hdr());
+
+      auto program = ProgramCache::programHandle(vertex_shader, ImageWrapper::fragmentShader());
+      submitDraw(layer, submit_pass, program);
+    };
+
+    ShapePieces<ImageWrapper> pieces(batches);
+    if (submitOversizedQuads(pieces, [&] { submit(ImageWrapper::vertexShader()); }))
+      return;
+
+    const EmbeddedFile* vertex_shader = setupQuadsWithLayout(pieces, ImageWrapper::vertexShader());
+    if (vertex_shader)
+      submit(*vertex_shader);
   }
 
-  inline int numTextPieces(const TextBlock& text, int x, int y, const std::vector<IBounds>& invalid_rects) {
+  inline int numTextPieces(const TextBlock& text, int x, int y, const DirtyRegion& invalid_rects) {
     auto count_pieces = [x, y, &text](int sum, IBounds invalid_rect) {
       ClampBounds clamp = text.clamp.clamp(invalid_rect.x() - x, invalid_rect.y() - y,
                                            invalid_rect.width(), invalid_rect.height());
@@ -451,27 +597,9 @@ namespace visage {
     return std::accumulate(invalid_rects.begin(), invalid_rects.end(), 0, count_pieces);
   }
 
-  void submitText(const BatchVector<TextBlock>& batches, const Layer& layer, int submit_pass) {
-    if (batches.empty() || batches[0].shapes->empty())
-      return;
-
-    const Font& font = batches[0].shapes->front().font;
-    int total_length = 0;
-    for (const auto& batch : batches) {
-      auto count_pieces = [&batch](int sum, const TextBlock& text_block) {
-        return sum + numTextPieces(text_block, batch.x, batch.y, *batch.invalid_rects);
-      };
-      total_length += std::accumulate(batch.shapes->begin(), batch.shapes->end(), 0, count_pieces);
-    }
-
-    if (total_length == 0)
-      return;
-
-    TextureVertex* vertices = initQuadVertices<TextureVertex>(total_length);
-    if (vertices == nullptr)
-      return;
-
-    int vertex_index = 0;
+  template<typename F>
+  static bool setTextQuads(const BatchVector<TextBlock>& batches, F&& write_quad) {
+    TextureVertex quad[kVerticesPerQuad] {};
     for (const auto& batch : batches) {
       for (const TextBlock& text_block : *batch.shapes) {
         int length = text_block.quads.size();
@@ -527,9 +655,18 @@ namespace visage {
             coordinate_index3 = 2;
           }
 
-          PackedBrush::setVertexGradientPositions(text_block.brush, vertices + vertex_index,
-                                                  length * kVerticesPerQuad, x, y, batch.x, batch.y,
-                                                  x + text_block.width, y + text_block.height);
+          PackedBrush::setVertexGradientPositions(text_block.brush, quad, kVerticesPerQuad, x, y,
+                                                  batch.x, batch.y, x + text_block.width,
+                                                  y + text_block.height);
+
+          for (int v = 0; v < kVerticesPerQuad; ++v) {
+            quad[v].clamp_left = positioned_clamp.left;
+            quad[v].clamp_top = positioned_clamp.top;
+            quad[v].clamp_right = positioned_clamp.right;
+            quad[v].clamp_bottom = positioned_clamp.bottom;
+            quad[v].direction_x = direction_x;
+            quad[v].direction_y = direction_y;
+          }
 
           for (int i = 0; i < length; ++i) {
             if (!overlaps(text_block.quads[i]))
@@ -545,87 +682,168 @@ namespace visage {
             float texture_width = text_block.quads[i].packed_glyph->width;
             float texture_height = text_block.quads[i].packed_glyph->height;
 
-            vertices[vertex_index].x = left;
-            vertices[vertex_index].y = top;
-            vertices[vertex_index + 1].x = right;
-            vertices[vertex_index + 1].y = top;
-            vertices[vertex_index + 2].x = left;
-            vertices[vertex_index + 2].y = bottom;
-            vertices[vertex_index + 3].x = right;
-            vertices[vertex_index + 3].y = bottom;
-
-            vertices[vertex_index + coordinate_index0].texture_x = texture_x;
-            vertices[vertex_index + coordinate_index0].texture_y = texture_y;
-            vertices[vertex_index + coordinate_index1].texture_x = texture_x + texture_width;
-            vertices[vertex_index + coordinate_index1].texture_y = texture_y;
-            vertices[vertex_index + coordinate_index2].texture_x = texture_x;
-            vertices[vertex_index + coordinate_index2].texture_y = texture_y + texture_height;
-            vertices[vertex_index + coordinate_index3].texture_x = texture_x + texture_width;
-            vertices[vertex_index + coordinate_index3].texture_y = texture_y + texture_height;
-
-            for (int v = 0; v < kVerticesPerQuad; ++v) {
-              int index = vertex_index + v;
-              vertices[index].clamp_left = positioned_clamp.left;
-              vertices[index].clamp_top = positioned_clamp.top;
-              vertices[index].clamp_right = positioned_clamp.right;
-              vertices[index].clamp_bottom = positioned_clamp.bottom;
-              vertices[index].direction_x = direction_x;
-              vertices[index].direction_y = direction_y;
-            }
-
-            vertex_index += kVerticesPerQuad;
+            quad[0].x = left;
+            quad[0].y = top;
+            quad[1].x = right;
+            quad[1].y = top;
+            quad[2].x = left;
+            quad[2].y = bottom;
+            quad[3].x = right;
+            quad[3].y = bottom;
+
+            quad[coordinate_index0].texture_x = texture_x;
+            quad[coordinate_index0].texture_y = texture_y;
+            quad[coordinate_index1].texture_x = texture_x + texture_width;
+            quad[coordinate_index1].texture_y = texture_y;
+            quad[coordinate_index2].texture_x = texture_x;
+            quad[coordinate_index2].texture_y = texture_y + texture_height;
+            quad[coordinate_index3].texture_x = texture_x + texture_width;
+            quad[coordinate_index3].texture_y = texture_y + texture_height;
+
+            // Emoji are packed on the second atlas page
+            float atlas_page = text_block.quads[i].packed_glyph->type_face ? 0.0f : 1.0f;
+            for (int v = 0; v < kVerticesPerQuad; ++v)
+              quad[v].atlas_page = atlas_page;
+
+            if (!write_quad(quad))
+              return false;
           }
         }
       }
     }
 
-    VISAGE_ASSERT(vertex_index == total_length * kVerticesPerQuad);
-
-    float atlas_scale_uniform[] = { 1.0f / font.atlasWidth(), 1.0f / font.atlasHeight(), 0.0f, 0.0f };
-    setUniform<Uniforms::kAtlasScale>(atlas_scale_uniform);
-    setTexture<Uniforms::kGradient>(0, layer.gradientAtlas()->colorTextureHandle());
-    setTexture<Uniforms::kTexture>(1, font.textureHandle());
-    setUniformDimensions(layer.width(), layer.height());
-    setColorMult(layer.hdr());
-    bgfx::submit(submit_pass,
-                 ProgramCache::programHandle(shaders::vs_tinted_texture, shaders::fs_tinted_texture));
+    return true;
   }
 
-  void submitShader(const BatchVector<ShaderWrapper>& batches, const Layer& layer, int submit_pass) {
-    if (!setupQuads(batches))
+  void submitText(const BatchVector<TextBlock>& batches, BlendMode state, const Layer& layer,
+                  int submit_pass) {
+    if (batches.empty() || batches[0].shapes->empty())
       return;
 
-    setBlendMode(BlendMode::Alpha);
-    setTimeUniform(layer.time());
-    setUniformDimensions(layer.width(), layer.height());
-    setTexture<Uniforms::kGradient>(0, layer.gradientAtlas()->colorTextureHandle());
-    setColorMult(layer.hdr());
-    setOriginFlipUniform(layer.bottomLeftOrigin());
+    const Font& font = batches[0].shapes->front().font;
+    int total_length = 0;
+    for (const auto& batch : batches) {
+      auto count_pieces = [&batch](int sum, const TextBlock& text_block) {
+        return sum + numTextPieces(text_block, batch.x, batch.y, *batch.invalid_rects);
+      };
+      total_length += std::accumulate(batch.shapes->begin(), batch.shapes->end(), 0, count_pieces);
+    }
+
+    if (total_length == 0)
+      return;
+
+    auto submit = [&](const EmbeddedFile& vertex_shader) {
+      setBlendMode(state);
+      setTexture<Uniforms::kGradient>(0, layer.gradientAtlas()->colorTextureHandle());
+      setTexture<Uniforms::kTexture>(1, font.textureHandle());
+      setTexture<Uniforms::kTexture2>(2, font.emojiTextureHandle());
+      float atlas_scale_uniform[] = { 1.0f / font.atlasWidth(), 1.0f / font.atlasHeight(),
+                                      1.0f / font.emojiAtlasWidth(), 1.0f / font.emojiAtlasHeight() };
+      setUniform<Uniforms::kAtlasScale>(atlas_scale_uniform);
+      setUniformDimensions(layer.width(), layer.height());
+      setColorMult(layer.hdr());
+      submitDraw(layer, submit_pass, ProgramCache::programHandle(vertex_shader, shaders::fs_text));
+    };
+
+    int vertex_index = 0;
+    if (total_length > maxTransientQuads(TextureVertex::layout())) {
+      std::vector<TextureVertex> vertices(total_length * kVerticesPerQuad);
+      setTextQuads(batches, [&vertices, &vertex_index](const TextureVertex* quad) {
+        std::copy(quad, quad + kVerticesPerQuad, vertices.data() + vertex_index);
+        vertex_index += kVerticesPerQuad;
+        return true;
+      });
+      submitQuadChunks(vertices.data(), total_length, TextureVertex::layout(),
+                       [&] { submit(shaders::vs_text); });
+      return;
+    }
+
+    const EmbeddedFile* vertex_shader = compactVertexShader(shaders::vs_text);
+    if (vertex_shader) {
+      auto& pool = VectorPool<CompactTextureVertex>::instance();
+      std::vector<CompactTextureVertex> compact = pool.vector(total_length * kVerticesPerQuad);
+      auto write_quad = [&compact, &vertex_index](const TextureVertex* quad) {
+        for (int v = 0; v < kVerticesPerQuad; ++v) {
+          if (!compactVertex(quad[v], compact.data() + vertex_index + v))
+            return false;
+        }
+        vertex_index += kVerticesPerQuad;
+        return true;
+      };
+
+      CompactTextureVertex* vertices = nullptr;
+      if (setTextQuads(batches, write_quad))
+        vertices = initQuadVertices<CompactTextureVertex>(total_length);
+      if (vertices)
+        std::copy(compact.begin(), compact.end(), vertices);
+      else
+        vertex_shader = nullptr;
+      pool.returnVector(std::move(compact));
+    }
+
+    if (vertex_shader == nullptr) {
+      vertex_index = 0;
+      vertex_shader = &shaders::vs_text;
+      TextureVertex* vertices = initQuadVertices<TextureVertex>(total_length);
+      if (vertices == nullptr)
+        return;
+
+      setTextQuads(batches, [vertices, &vertex_index](const TextureVertex* quad) {
+        std::copy(quad, quad + kVerticesPerQuad, vertices + vertex_index);
+        vertex_index += kVerticesPerQuad;
+        return true;
+      });
+    }
+
+    VISAGE_ASSERT(vertex_index == total_length * kVerticesPerQuad);
+    submit(*vertex_shader);
+  }
+
+  void submitShader(const BatchVector<ShaderWrapper>& batches, const Layer& layer, int submit_pass) {
     Shader* shader = batches[0].shapes->front().shader;
-    bgfx::submit(submit_pass,
+    auto submit = [&] {
+      setBlendMode(BlendMode::Alpha);
+      setTimeUniform(layer.time());
+      setUniformDimensions(layer.width(), layer.height());
+      setTexture<Uniforms::kGradient>(0, layer.gradientAtlas()->colorTextureHandle());
+      setColorMult(layer.hdr());
+      setOriginFlipUniform(layer.bottomLeftOrigin());
+      submitDraw(layer, submit_pass,
                  ProgramCache::programHandle(shader->vertexShader(), shader->fragmentShader()));
-  }
+    };
 
-  void submitSampleRegions(const BatchVector<SampleRegion>& batches, const Layer& layer, int submit_pass) {
-    if (!setupQuads(batches))
+    ShapePieces<ShaderWrapper> pieces(batches);
+    if (submitOversizedQuads(pieces, submit) || !setupQuads(pieces))
       return;
 
+    submit();
+  }
+
+  void submitSampleRegions(const BatchVector<SampleRegion>& batches, const Layer& layer, int submit_pass) {
     Layer* source_layer = batches[0].shapes->front().region->layer();
-    float width_scale = 1.0f / source_layer->width();
-    float height_scale = 1.0f / source_layer->height();
+    auto submit = [&] {
+      float width_scale = 1.0f / source_layer->width();
+      float height_scale = 1.0f / source_layer->height();
+
+      setBlendMode(BlendMode::Alpha);
+      setTimeUniform(layer.time());
+      float atlas_scale[] = { width_scale, height_scale, 0.0f, 0.0f };
+      setUniform<Uniforms::kAtlasScale>(atlas_scale);
+
+      setTexture<Uniforms::kTexture>(0, bgfx::getTexture(source_layer->frameBuffer()));
+      setUniformDimensions(layer.width(), layer.height());
+      float value = layer.hdr() ? kHdrColorMultiplier : 1.0f;
+      float color_mult[] = { value, value, value, 1.0f };
+      setUniform<Uniforms::kColorMult>(color_mult);
+      setOriginFlipUniform(layer.bottomLeftOrigin());
+      submitDraw(layer, submit_pass,
+                 ProgramCache::programHandle(SampleRegion::vertexShader(), SampleRegion::fragmentShader()));
+    };
 
-    setBlendMode(BlendMode::Alpha);
-    setTimeUniform(layer.time());
-    float atlas_scale[] = { width_scale, height_scale, 0.0f, 0.0f };
-    setUniform<Uniforms::kAtlasScale>(atlas_scale);
+    ShapePieces<SampleRegion> pieces(batches);
+    if (submitOversizedQuads(pieces, submit) || !setupQuads(pieces))
+      return;
 
-    setTexture<Uniforms::kTexture>(0, bgfx::getTexture(source_layer->frameBuffer()));
-    setUniformDimensions(layer.width(), layer.height());
-    float value = layer.hdr() ? kHdrColorMultiplier : 1.0f;
-    float color_mult[] = { value, value, value, 1.0f };
-    setUniform<Uniforms::kColorMult>(color_mult);
-    setOriginFlipUniform(layer.bottomLeftOrigin());
-    bgfx::submit(submit_pass, ProgramCache::programHandle(SampleRegion::vertexShader(),
-                                                          SampleRegion::fragmentShader()));
+    submit();
   }
 }
\ No newline at end of file
@@ -27,7 +27,12 @@
 #include "visage_utils/space.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
 #include <numeric>
+#include <type_traits>
+#include <unordered_map>
 
 #ifndef NDEBUG
 #include <random>
@@ -55,11 +60,11 @@ namespace visage {
 
   template<typename T>
   struct DrawBatch {
-    DrawBatch(const std::vector<T>* shapes, std::vector<IBounds>* invalid_rects, int x, int y) :
+    DrawBatch(const std::vector<T>* shapes, DirtyRegion* invalid_rects, int x, int y) :
         shapes(shapes), invalid_rects(invalid_rects), x(x), y(y) { }
 
     const std::vector<T>* shapes;
-    std::vector<IBounds>* invalid_rects;
+    DirtyRegion* invalid_rects;
     int x = 0;
     int y = 0;
   };
@@ -67,7 +72,7 @@ namespace visage {
   template<typename T>
   using BatchVector = std::vector<DrawBatch<T>>;
 
-  inline int numShapePieces(const BaseShape& shape, int x, int y, const std::vector<IBounds>& invalid_rects) {
+  inline int numShapePieces(const BaseShape& shape, int x, int y, const DirtyRegion& invalid_rects) {
     auto check_overlap = [x, y, &shape](IBounds invalid_rect) {
       ClampBounds clamp = shape.clamp.clamp(invalid_rect.x() - x, invalid_rect.y() - y,
                                             invalid_rect.width(), invalid_rect.height());
@@ -88,13 +93,111 @@ namespace visage {
     return total_size;
   }
 
+  static constexpr int kShapeChunkSize = 256;
+  static constexpr int kMinParallelShapes = 2048;
+
+  void setParallelVertexGeneration(bool parallel);
+  bool parallelVertexGeneration();
+  void runVertexJobs(int num_jobs, const std::function<void(int)>& job);
+
+  template<typename T>
+  class ShapePieces {
+  public:
+    explicit ShapePieces(const BatchVector<T>& batches) : batches_(batches) {
+      int num_shapes = 0;
+      for (const auto& batch : batches)
+        num_shapes += batch.shapes->size();
+
+      if (num_shapes < kMinParallelShapes || !parallelVertexGeneration()) {
+        num_pieces_ = numShapes(batches);
+        return;
+      }
+
+      for (int i = 0; i < batches.size(); ++i) {
+        int size = batches[i].shapes->size();
+        for (int begin = 0; begin < size; begin += kShapeChunkSize)
+          chunks_.push_back({ i, begin, std::min(size, begin + kShapeChunkSize) });
+      }
+
+      runVertexJobs(chunks_.size(), [this](int index) {
+        Chunk& chunk = chunks_[index];
+        const DrawBatch<T>& batch = batches_[chunk.batch];
+        for (int i = chunk.begin; i < chunk.end; ++i)
+          chunk.num_pieces += numShapePieces((*batch.shapes)[i], batch.x, batch.y, *batch.invalid_rects);
+      });
+
+      for (Chunk& chunk : chunks_) {
+        chunk.offset = num_pieces_;
+        num_pieces_ += chunk.num_pieces;
+      }
+    }
+
+    int numPieces() const { return num_pieces_; }
+
+    // Calls set_piece(shape, batch, clamp, piece_index) for every visible piece and stops
+    // when set_piece returns false. Each piece gets the same index in the serial and the
+    // parallel path so the output doesn't depend on how the work is split.
+    template<typename F>
+    bool set(const F& set_piece) const {
+      if (chunks_.empty()) {
+        int piece_index = 0;
+        for (const auto& batch : batches_) {
+          if (!setPieces(batch, 0, batch.shapes->size(), piece_index, set_piece))
+            return false;
+        }
+        return true;
+      }
+
+      std::atomic<bool> success = true;
+      runVertexJobs(chunks_.size(), [&](int index) {
+        const Chunk& chunk = chunks_[index];
+        int piece_index = chunk.offset;
+        if (!setPieces(batches_[chunk.batch], chunk.begin, chunk.end, piece_index, set_piece))
+          success = false;
+      });
+      return success;
+    }
+
+  private:
+    struct Chunk {
+      int batch = 0;
+      int begin = 0;
+      int end = 0;
+      int num_pieces = 0;
+      int offset = 0;
+    };
+
+    template<typename F>
+    static bool setPieces(const DrawBatch<T>& batch, int begin, int end, int& piece_index,
+                          const F& set_piece) {
+      for (int i = begin; i < end; ++i) {
+        const T& shape = (*batch.shapes)[i];
+        for (const IBounds& invalid_rect : *batch.invalid_rects) {
+          ClampBounds clamp = shape.clamp.clamp(invalid_rect.x() - batch.x, invalid_rect.y() - batch.y,
+                                                invalid_rect.width(), invalid_rect.height());
+          if (shape.totallyClamped(clamp))
+            continue;
+
+          if (!set_piece(shape, batch, clamp.withOffset(batch.x, batch.y), piece_index++))
+            return false;
+        }
+      }
+      return true;
+    }
+
+    const BatchVector<T>& batches_;
+    std::vector<Chunk> chunks_;
+    int num_pieces_ = 0;
+  };
+
   void setUniformDimensions(int width, int height);
   void setOriginFlipUniform(bool origin_flip);
   void setBlendMode(BlendMode draw_state);
 
-  bool initTransientQuadBuffers(int num_quads, const bgfx::VertexLayout& layout,
-                                bgfx::TransientVertexBuffer* vertex_buffer,
-                                bgfx::TransientIndexBuffer* index_buffer);
+  void setQuadIndexBuffer(int num_quads);
+  int maxTransientQuads(const bgfx::VertexLayout& layout);
+  void submitQuadChunks(const void* vertices, int num_quads, const bgfx::VertexLayout& layout,
+                        const std::function<void()>& submit_chunk);
   uint8_t* initQuadVerticesWithLayout(int num_quads, const bgfx::VertexLayout& layout);
   template<typename T>
   T* initQuadVertices(int num_quads) {
@@ -104,50 +207,239 @@ namespace visage {
   void submitShapes(const Layer& layer, const EmbeddedFile& vertex_shader,
                     const EmbeddedFile& fragment_shader, int submit_pass);
 
-  void submitLine(const LineWrapper& line_wrapper, const Layer& layer, int submit_pass);
-  void submitLineFill(const LineFillWrapper& line_fill_wrapper, const Layer& layer, int submit_pass);
+  int numLineVertices(const BatchVector<LineWrapper>& batches);
+  int setLineVertices(const BatchVector<LineWrapper>& batches, LineVertex* vertices);
+  int numLineFillVertices(const BatchVector<LineFillWrapper>& batches);
+  int setLineFillVertices(const BatchVector<LineFillWrapper>& batches, LineVertex* vertices);
+  void submitLines(const BatchVector<LineWrapper>& batches, const Layer& layer, int submit_pass);
+  void submitLineFills(const BatchVector<LineFillWrapper>& batches, const Layer& layer, int submit_pass);
   void submitImages(const BatchVector<ImageWrapper>& batches, const Layer& layer, int submit_pass);
-  void submitText(const BatchVector<TextBlock>& batches, const Layer& layer, int submit_pass);
+  void submitText(const BatchVector<TextBlock>& batches, BlendMode state, const Layer& layer,
+                  int submit_pass);
   void submitShader(const BatchVector<ShaderWrapper>& batches, const Layer& layer, int submit_pass);
   void submitSampleRegions(const BatchVector<SampleRegion>& batches, const Layer& layer, int submit_pass);
 
+  const EmbeddedFile* compactVertexShader(const EmbeddedFile& vertex_shader);
+  bool setRetainedQuadBuffers(Layer& layer, uint64_t key);
+  bool retainQuadBuffers(Layer& layer, uint64_t key, const void* vertices, int num_quads,
+                         const bgfx::VertexLayout& layout);
+  bool instancedShapesSupported();
+  uint8_t* initQuadInstances(int num_instances, int instance_stride);
   template<typename T>
-  bool setupQuads(const BatchVector<T>& batches) {
-    int num_shapes = numShapes(batches);
-    if (num_shapes == 0)
+  T* initQuadInstances(int num_instances) {
+    return reinterpret_cast<T*>(initQuadInstances(num_instances, sizeof(T)));
+  }
+
+  template<typename T, typename = void>
+  struct HasInstancedShader : std::false_type { };
+
+  template<typename T>
+  struct HasInstancedShader<T, std::void_t<decltype(T::instancedVertexShader())>> : std::true_type { };
+
+  template<typename T>
+  int setQuadVertices(const ShapePieces<T>& pieces, typename T::Vertex* vertices) {
+    pieces.set([vertices](const T& shape, const DrawBatch<T>& batch, const ClampBounds& clamp, int index) {
+      typename T::Vertex* quad = vertices + index * kVerticesPerQuad;
+      setQuadPositions(quad, shape, clamp, batch.x, batch.y);
+      shape.setVertexData(quad);
+      return true;
+    });
+    return pieces.numPieces() * kVerticesPerQuad;
+  }
+
+  template<typename T>
+  int setQuadVertices(const BatchVector<T>& batches, typename T::Vertex* vertices) {
+    return setQuadVertices(ShapePieces<T>(batches), vertices);
+  }
+
+  // Returns false when the pieces fit in a single transient draw. Otherwise the vertices are
+  // generated once and submitted in chunks, calling submit_chunk after each chunk's buffers
+  // are bound.
+  template<typename T>
+  bool submitOversizedQuads(const ShapePieces<T>& pieces, const std::function<void()>& submit_chunk) {
+    const bgfx::VertexLayout& layout = T::Vertex::layout();
+    if (pieces.numPieces() <= maxTransientQuads(layout))
+      return false;
+
+    std::vector<typename T::Vertex> vertices(pieces.numPieces() * kVerticesPerQuad);
+    setQuadVertices(pieces, vertices.data());
+    submitQuadChunks(vertices.data(), pieces.numPieces(), layout, submit_chunk);
+    return true;
+  }
+
+  template<typename V, typename = void>
+  struct HasCompactVertex : std::false_type { };
+
+  template<typename V>
+  struct HasCompactVertex<V, std::void_t<typename V::Compact>> : std::true_type { };
+
+  template<typename T>
+  bool setCompactQuadVertices(const ShapePieces<T>& pieces, typename T::Vertex::Compact* vertices) {
+    return pieces.set([vertices](const T& shape, const DrawBatch<T>& batch, const ClampBounds& clamp,
+                                 int index) {
+      typename T::Vertex quad[kVerticesPerQuad] {};
+      setQuadPositions(quad, shape, clamp, batch.x, batch.y);
+      shape.setVertexData(quad);
+      for (int v = 0; v < kVerticesPerQuad; ++v) {
+        if (!compactVertex(quad[v], vertices + index * kVerticesPerQuad + v))
+          return false;
+      }
+      return true;
+    });
+  }
+
+  template<typename T>
+  bool setCompactQuadVertices(const BatchVector<T>& batches, typename T::Vertex::Compact* vertices) {
+    return setCompactQuadVertices(ShapePieces<T>(batches), vertices);
+  }
+
+  template<typename T>
+  int setQuadInstances(const ShapePieces<T>& pieces, ShapeInstance* instances) {
+    static_assert(std::is_same_v<typename T::Vertex, ShapeVertex>,
+                  "Only ShapeVertex shapes fit in an instance record");
+
+    pieces.set([instances](const T& shape, const DrawBatch<T>& batch, const ClampBounds& clamp, int index) {
+      ShapeVertex corners[kVerticesPerQuad] {};
+      setQuadPositions(corners, shape, clamp, batch.x, batch.y);
+      shape.setVertexData(corners);
+      instances[index] = ShapeInstance::fromVertex(corners[0]);
+      return true;
+    });
+    return pieces.numPieces();
+  }
+
+  template<typename T>
+  int setQuadInstances(const BatchVector<T>& batches, ShapeInstance* instances) {
+    return setQuadInstances(ShapePieces<T>(batches), instances);
+  }
+
+  template<typename T>
+  bool setupQuads(const ShapePieces<T>& pieces) {
+    if (pieces.numPieces() == 0)
       return false;
 
-    auto vertices = initQuadVertices<typename T::Vertex>(num_shapes);
+    auto vertices = initQuadVertices<typename T::Vertex>(pieces.numPieces());
     if (vertices == nullptr)
       return false;
-    int vertex_index = 0;
 
-    for (const auto& batch : batches) {
-      for (const T& shape : *batch.shapes) {
-        for (const IBounds& invalid_rect : *batch.invalid_rects) {
-          ClampBounds clamp = shape.clamp.clamp(invalid_rect.x() - batch.x, invalid_rect.y() - batch.y,
-                                                invalid_rect.width(), invalid_rect.height());
-          if (shape.totallyClamped(clamp))
-            continue;
+    setQuadVertices(pieces, vertices);
+    // debugVertices(vertices, pieces.numPieces(), kVerticesPerQuad);
+    return true;
+  }
 
-          clamp = clamp.withOffset(batch.x, batch.y);
-          setQuadPositions(vertices + vertex_index, shape, clamp, batch.x, batch.y);
-          shape.setVertexData(vertices + vertex_index);
-          vertex_index += kVerticesPerQuad;
-        }
-      }
+  template<typename T>
+  bool setupQuads(const BatchVector<T>& batches) {
+    return setupQuads(ShapePieces<T>(batches));
+  }
+
+  // Quantizes into pooled scratch memory first so a value out of range doesn't leave transient
+  // memory allocated for vertices that are never drawn.
+  template<typename T>
+  bool setupCompactQuads(const ShapePieces<T>& pieces) {
+    using Compact = typename T::Vertex::Compact;
+    if (pieces.numPieces() == 0)
+      return false;
+
+    auto& pool = VectorPool<Compact>::instance();
+    std::vector<Compact> compact = pool.vector(pieces.numPieces() * kVerticesPerQuad);
+    bool setup = setCompactQuadVertices(pieces, compact.data());
+    if (setup) {
+      auto vertices = initQuadVertices<Compact>(pieces.numPieces());
+      setup = vertices != nullptr;
+      if (setup)
+        std::copy(compact.begin(), compact.end(), vertices);
     }
+    pool.returnVector(std::move(compact));
+    return setup;
+  }
 
-    // debugVertices(vertices, num_shapes, kVerticesPerQuad);
-    VISAGE_ASSERT(vertex_index == num_shapes * kVerticesPerQuad);
+  template<typename T>
+  const EmbeddedFile* setupQuadsWithLayout(const ShapePieces<T>& pieces,
+                                           const EmbeddedFile& vertex_shader) {
+    if constexpr (HasCompactVertex<typename T::Vertex>::value) {
+      const EmbeddedFile* compact_shader = compactVertexShader(vertex_shader);
+      if (compact_shader && setupCompactQuads(pieces))
+        return compact_shader;
+    }
+
+    if (setupQuads(pieces))
+      return &vertex_shader;
+    return nullptr;
+  }
+
+  template<typename T>
+  const EmbeddedFile* setupQuadsWithLayout(const BatchVector<T>& batches,
+                                           const EmbeddedFile& vertex_shader) {
+    return setupQuadsWithLayout(ShapePieces<T>(batches), vertex_shader);
+  }
+
+  template<typename T>
+  bool setupInstances(const ShapePieces<T>& pieces) {
+    if (pieces.numPieces() == 0)
+      return false;
+
+    auto instances = initQuadInstances<ShapeInstance>(pieces.numPieces());
+    if (instances == nullptr)
+      return false;
+
+    setQuadInstances(pieces, instances);
     return true;
   }
 
   template<typename T>
-  static void submitShapes(const BatchVector<T>& batches, BlendMode state, Layer& layer, int submit_pass) {
-    if (!setupQuads(batches))
+  static void submitShapePieces(const ShapePieces<T>& pieces, BlendMode state, Layer& layer,
+                                int submit_pass) {
+    if constexpr (HasInstancedShader<T>::value) {
+      if (instancedShapesSupported() && setupInstances(pieces)) {
+        setBlendMode(state);
+        submitShapes(layer, T::instancedVertexShader(), T::fragmentShader(), submit_pass);
+        return;
+      }
+    }
+
+    auto submit = [&](const EmbeddedFile& vertex_shader) {
+      setBlendMode(state);
+      submitShapes(layer, vertex_shader, T::fragmentShader(), submit_pass);
+    };
+    if (submitOversizedQuads(pieces, [&] { submit(T::vertexShader()); }))
       return;
 
+    const EmbeddedFile* vertex_shader = setupQuadsWithLayout(pieces, T::vertexShader());
+    if (vertex_shader)
+      submit(*vertex_shader);
+  }
+
+  template<typename T>
+  static void submitShapes(const BatchVector<T>& batches, BlendMode state, Layer& layer, int submit_pass) {
+    submitShapePieces(ShapePieces<T>(batches), state, layer, submit_pass);
+  }
+
+  template<typename T>
+  void submitRetainedShapes(const BatchVector<T>& batches, BlendMode state, Layer& layer,
+                            int submit_pass, uint64_t key) {
+    if (!setRetainedQuadBuffers(layer, key)) {
+      ShapePieces<T> pieces(batches);
+      if (pieces.numPieces() == 0)
+        return;
+
+      // Too many quads for one retained buffer, so don't generate vertices that would be dropped
+      if (pieces.numPieces() > kMaxQuadsPerDraw) {
+        submitShapePieces(pieces, state, layer, submit_pass);
+        return;
+      }
+
+      auto& pool = VectorPool<typename T::Vertex>::instance();
+      std::vector<typename T::Vertex> vertices = pool.vector(pieces.numPieces() * kVerticesPerQuad);
+      setQuadVertices(pieces, vertices.data());
+      bool retained = retainQuadBuffers(layer, key, vertices.data(), pieces.numPieces(),
+                                        T::Vertex::layout());
+      pool.returnVector(std::move(vertices));
+      if (!retained) {
+        submitShapePieces(pieces, state, layer, submit_pass);
+        return;
+      }
+    }
+
     setBlendMode(state);
     submitShapes(layer, T::vertexShader(), T::fragmentShader(), submit_pass);
   }
@@ -155,29 +447,13 @@ namespace visage {
   template<>
   inline void submitShapes<LineWrapper>(const BatchVector<LineWrapper>& batches, BlendMode state,
                                         Layer& layer, int submit_pass) {
-    for (const auto& batch : batches) {
-      for (const LineWrapper& line_wrapper : *batch.shapes) {
-        LineWrapper line = line_wrapper;
-        line.x = batch.x + line_wrapper.x;
-        line.y = batch.y + line_wrapper.y;
-        setBlendMode(state);
-        submitLine(line, layer, submit_pass);
-      }
-    }
+    submitLines(batches, layer, submit_pass);
   }
 
   template<>
   inline void submitShapes<LineFillWrapper>(const BatchVector<LineFillWrapper>& batches,
                                             BlendMode state, Layer& layer, int submit_pass) {
-    for (const auto& batch : batches) {
-      for (const LineFillWrapper& line_fill_wrapper : *batch.shapes) {
-        LineFillWrapper line_fill = line_fill_wrapper;
-        line_fill.x = batch.x + line_fill.x;
-        line_fill.y = batch.y + line_fill.y;
-        setBlendMode(state);
-        submitLineFill(line_fill, layer, submit_pass);
-      }
-    }
+    submitLineFills(batches, layer, submit_pass);
   }
 
   template<>
@@ -197,8 +473,7 @@ namespace visage {
   template<>
   inline void submitShapes<TextBlock>(const BatchVector<TextBlock>& batches, BlendMode state,
                                       Layer& layer, int submit_pass) {
-    setBlendMode(state);
-    submitText(batches, layer, submit_pass);
+    submitText(batches, state, layer, submit_pass);
   }
 
   template<>
@@ -224,31 +499,48 @@ namespace visage {
 
   struct PositionedBatch {
     SubmitBatch* batch = nullptr;
-    std::vector<IBounds>* invalid_rects {};
+    DirtyRegion* invalid_rects {};
     int x = 0;
     int y = 0;
   };
 
-  class SubmitBatch {
-  public:
-    explicit SubmitBatch(BlendMode blend_mode) : blend_mode_(blend_mode) { }
-    virtual ~SubmitBatch() = default;
-    virtual void clear() = 0;
-    virtual void submit(Layer& layer, int submit_pass, const std::vector<PositionedBatch>& others) = 0;
+  struct BatchArea {
+    static BatchArea fromShape(const BaseShape& shape) {
+      return { shape.x, shape.y, shape.x + shape.width, shape.y + shape.height };
+    }
 
-    bool overlapsShape(const BaseShape& shape) const {
+    static BatchArea queryFromShape(const BaseShape& shape) {
       int x = shape.x;
       int y = shape.y;
       int right = shape.x + shape.width;
       int bottom = shape.y + shape.height;
-      return std::any_of(areas_.begin(), areas_.end(), [x, y, right, bottom](auto& area) {
-        return x < area.right && right > area.x && y < area.bottom && bottom > area.y;
-      });
+      return { static_cast<float>(x), static_cast<float>(y), static_cast<float>(right),
+               static_cast<float>(bottom) };
     }
 
+    bool overlaps(const BatchArea& other) const {
+      return x < other.right && right > other.x && y < other.bottom && bottom > other.y;
+    }
+
+    float x, y, right, bottom;
+  };
+
+  class SubmitBatch {
+  public:
+    explicit SubmitBatch(BlendMode blend_mode) : blend_mode_(blend_mode) { }
+    virtual ~SubmitBatch() = default;
+    virtual void clear() = 0;
+    virtual void submit(Layer& layer, int submit_pass, const std::vector<PositionedBatch>& others) = 0;
+
     const void* id() const { return id_; }
     void setBlendMode(BlendMode blend_mode) { blend_mode_ = blend_mode; }
     BlendMode blendMode() const { return blend_mode_; }
+    const std::vector<BatchArea>& areas() const { return areas_; }
+    void setIndex(int index) { index_ = index; }
+    int index() const { return index_; }
+    void setRetained(bool retained) { retained_ = retained; }
+    bool retained() const { return retained_; }
+    uint64_t contentStamp() const { return content_stamp_; }
 
     int compare(const void* other_id, BlendMode other_blend_mode) const {
       if (id_ < other_id)
@@ -264,11 +556,16 @@ namespace visage {
 
     int compare(const SubmitBatch* other) const { return compare(other->id_, other->blend_mode_); }
 
-    void clearAreas() { areas_.clear(); }
+    void clearAreas() {
+      areas_.clear();
+      content_stamp_ = nextContentStamp();
+    }
+
     void addShapeArea(const BaseShape& shape) {
       VISAGE_ASSERT(id_ == nullptr || id_ == shape.batch_id);
       id_ = shape.batch_id;
-      areas_.push_back({ shape.x, shape.y, shape.x + shape.width, shape.y + shape.height });
+      content_stamp_ = nextContentStamp();
+      areas_.push_back(BatchArea::fromShape(shape));
     }
 
   protected:
@@ -278,15 +575,37 @@ namespace visage {
     }
 
   private:
-    struct Area {
-      float x, y, right, bottom;
-    };
+    static uint64_t nextContentStamp() {
+      static uint64_t stamp = 0;
+      return ++stamp;
+    }
 
     const void* id_ = nullptr;
-    std::vector<Area> areas_;
+    std::vector<BatchArea> areas_;
     BlendMode blend_mode_;
+    int index_ = 0;
+    bool retained_ = false;
+    uint64_t content_stamp_ = nextContentStamp();
   };
 
+  inline uint64_t retainedGeometryKey(const std::vector<PositionedBatch>& batches) {
+    auto pack = [](int a, int b) {
+      return (static_cast<uint64_t>(static_cast<uint32_t>(a)) << 32) | static_cast<uint32_t>(b);
+    };
+
+    uint64_t key = 0;
+    for (const PositionedBatch& batch : batches) {
+      key = hashCombine(key, batch.batch->contentStamp());
+      key = hashCombine(key, static_cast<uint64_t>(batch.batch->blendMode()));
+      key = hashCombine(key, pack(batch.x, batch.y));
+      for (const IBounds& rect : *batch.invalid_rects) {
+        key = hashCombine(key, pack(rect.x(), rect.y()));
+        key = hashCombine(key, pack(rect.width(), rect.height()));
+      }
+    }
+    return key;
+  }
+
   template<typename T>
   class ShapeBatch : public SubmitBatch {
   public:
@@ -306,6 +625,16 @@ namespace visage {
         const std::vector<T>* shapes = &reinterpret_cast<ShapeBatch<T>*>(batch.batch)->shapes_;
         batch_list.emplace_back(shapes, batch.invalid_rects, batch.x, batch.y);
       }
+
+      if constexpr (std::is_base_of_v<Primitive<typename T::Vertex>, T> ||
+                    std::is_same_v<T, SdfShape>) {
+        bool retained = std::all_of(batches.begin(), batches.end(),
+                                    [](const PositionedBatch& batch) { return batch.batch->retained(); });
+        if (retained && !batches.empty()) {
+          submitRetainedShapes(batch_list, blendMode(), layer, submit_pass, retainedGeometryKey(batches));
+          return;
+        }
+      }
       submitShapes(batch_list, blendMode(), layer, submit_pass);
     }
 
@@ -318,6 +647,98 @@ namespace visage {
     std::vector<T> shapes_;
   };
 
+  class BatchAreaIndex {
+  public:
+    static constexpr float kCellSize = 64.0f;
+    static constexpr float kMaxCell = 1 << 20;
+    static constexpr int kMaxCellSpan = 64;
+    static constexpr int kMaxRetainedCells = 4096;
+
+    void clear() {
+      if (cells_.size() > kMaxRetainedCells)
+        cells_.clear();
+      else {
+        for (auto& cell : cells_)
+          cell.second.clear();
+      }
+      large_entries_.clear();
+    }
+
+    void addArea(const SubmitBatch* batch, const BatchArea& area) {
+      CellRange range = cellRange(area);
+      if (range.numCells() > kMaxCellSpan) {
+        large_entries_.push_back({ batch, area });
+        return;
+      }
+
+      for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x)
+          cells_[cellKey(x, y)].push_back({ batch, area });
+      }
+    }
+
+    int lastOverlappingIndex(const BaseShape& shape) const {
+      BatchArea area = BatchArea::queryFromShape(shape);
+      int result = -1;
+      auto check_entries = [&area, &result](const std::vector<Entry>& entries) {
+        for (const Entry& entry : entries) {
+          if (entry.batch->index() > result && entry.area.overlaps(area))
+            result = entry.batch->index();
+        }
+      };
+
+      check_entries(large_entries_);
+      CellRange range = cellRange(area);
+      if (range.numCells() > static_cast<int64_t>(cells_.size())) {
+        for (const auto& cell : cells_)
+          check_entries(cell.second);
+        return result;
+      }
+
+      for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x) {
+          auto cell = cells_.find(cellKey(x, y));
+          if (cell != cells_.end())
+            check_entries(cell->second);
+        }
+      }
+      return result;
+    }
+
+  private:
+    struct Entry {
+      const SubmitBatch* batch = nullptr;
+      BatchArea area;
+    };
+
+    struct CellRange {
+      int64_t numCells() const {
+        return (right - left + 1) * static_cast<int64_t>(bottom - top + 1);
+      }
+
+      int left, top, right, bottom;
+    };
+
+    static int cellCoordinate(float position) {
+      float cell = std::max(-kMaxCell, std::min(kMaxCell, position / kCellSize));
+      return static_cast<int>(std::floor(cell));
+    }
+
+    static CellRange cellRange(const BatchArea& area) {
+      int left = cellCoordinate(area.x);
+      int top = cellCoordinate(area.y);
+      return { left, top, std::max(left, cellCoordinate(area.right)),
+               std::max(top, cellCoordinate(area.bottom)) };
+    }
+
+    static uint64_t cellKey(int x, int y) {
+      return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+
+    std::unordered_map<uint64_t, std::vector<Entry>> cells_;
+    std::vector<Entry> large_entries_;
+  };
+
   class ShapeBatcher {
   public:
     void clear() {
@@ -326,6 +747,8 @@ namespace visage {
         unused_batches_[batch->id()].push_back(std::move(batch));
       }
       batches_.clear();
+      batches_by_key_.clear();
+      area_index_.clear();
     }
 
     void submit(Layer& layer, int submit_pass) {
@@ -333,20 +756,27 @@ namespace visage {
         batch->submit(layer, submit_pass, {});
     }
 
+    // Finding a matching batch is a lookup in the batches sharing the shape's id and blend mode.
+    // Only a shape that needs a new batch scans back to the last overlap for the insert position,
+    // so that O(batches) cost is paid once per batch instead of once per shape.
     int autoBatchIndex(const BaseShape& shape, BlendMode blend) const {
-      int match = batches_.size();
+      int last_overlap = area_index_.lastOverlappingIndex(shape);
+      auto candidates = batches_by_key_.find({ shape.batch_id, blend });
+      if (candidates != batches_by_key_.end()) {
+        const std::vector<SubmitBatch*>& matching = candidates->second;
+        auto first = std::lower_bound(matching.begin(), matching.end(), last_overlap,
+                                      [](const SubmitBatch* batch, int index) {
+                                        return batch->index() < index;
+                                      });
+        if (first != matching.end())
+          return (*first)->index();
+      }
+
       int insert = batches_.size();
-      for (int i = batches_.size() - 1; i >= 0; --i) {
-        SubmitBatch* batch = batches_[i].get();
-        if (batch->id() == shape.batch_id && batch->blendMode() == blend)
-          match = i;
-        if (batch->overlapsShape(shape))
-          break;
-        if (batch->id() > shape.batch_id)
+      for (int i = batches_.size() - 1; i > last_overlap; --i) {
+        if (batches_[i]->id() > shape.batch_id)
           insert = i;
       }
-      if (match < batches_.size())
-        return match;
       return insert;
     }
 
@@ -374,6 +804,18 @@ namespace visage {
       else
         batches_.insert(batches_.begin() + insert_index, std::make_unique<ShapeBatch<T>>(blend));
 
+      batches_[insert_index]->setRetained(retained_geometry_);
+      for (int i = insert_index; i < batches_.size(); ++i)
+        batches_[i]->setIndex(i);
+
+      // Inserting shifts later batches together so each key's list stays in index order
+      std::vector<SubmitBatch*>& matching = batches_by_key_[{ id, blend }];
+      auto position = std::lower_bound(matching.begin(), matching.end(), insert_index,
+                                       [](const SubmitBatch* batch, int index) {
+                                         return batch->index() < index;
+                                       });
+      matching.insert(position, batches_[insert_index].get());
+
       return reinterpret_cast<ShapeBatch<T>*>(batches_[insert_index].get());
     }
 
@@ -385,10 +827,17 @@ namespace visage {
       ShapeBatch<T>* batch = match ? reinterpret_cast<ShapeBatch<T>*>(batches_[batch_index].get()) :
                                      createNewBatch<T>(shape.batch_id, blend, batch_index);
 
+      area_index_.addArea(batch, BatchArea::fromShape(shape));
       batch->addShape(std::move(shape));
     }
 
     void setManualBatching(bool manual) { manual_batching_ = manual; }
+    void setRetainedGeometry(bool retained) {
+      retained_geometry_ = retained;
+      for (auto& batch : batches_)
+        batch->setRetained(retained);
+    }
+    bool retainedGeometry() const { return retained_geometry_; }
 
     int numBatches() const { return batches_.size(); }
     bool isEmpty() const { return batches_.empty(); }
@@ -397,6 +846,9 @@ namespace visage {
   private:
     std::vector<std::unique_ptr<SubmitBatch>> batches_;
     std::map<const void*, std::vector<std::unique_ptr<SubmitBatch>>> unused_batches_;
+    std::map<std::pair<const void*, BlendMode>, std::vector<SubmitBatch*>> batches_by_key_;
+    BatchAreaIndex area_index_;
     bool manual_batching_ = false;
+    bool retained_geometry_ = false;
   };
 }
\ No newline at end of file
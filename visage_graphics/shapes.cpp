@@ -23,6 +23,7 @@
 
 #include "embedded/shaders.h"
 #include "layer.h"
+#include "line.h"
 #include "region.h"
 
 #define VISAGE_SET_PROGRAM(shape, vertex, fragment) \
@@ -33,19 +34,34 @@
     return fragment;                                \
   }
 
+#define VISAGE_SET_INSTANCED_PROGRAM(shape, vertex, instanced_vertex, fragment) \
+  VISAGE_SET_PROGRAM(shape, vertex, fragment)                                  \
+  const EmbeddedFile& shape::instancedVertexShader() {                         \
+    return instanced_vertex;                                                   \
+  }
+
 namespace visage {
-  VISAGE_SET_PROGRAM(Fill, shaders::vs_color, shaders::fs_color)
-  VISAGE_SET_PROGRAM(Rectangle, shaders::vs_shape, shaders::fs_rectangle)
-  VISAGE_SET_PROGRAM(RoundedRectangle, shaders::vs_shape, shaders::fs_rounded_rectangle)
-  VISAGE_SET_PROGRAM(Circle, shaders::vs_shape, shaders::fs_circle)
-  VISAGE_SET_PROGRAM(Squircle, shaders::vs_shape, shaders::fs_squircle)
-  VISAGE_SET_PROGRAM(FlatArc, shaders::vs_arc, shaders::fs_flat_arc)
-  VISAGE_SET_PROGRAM(RoundedArc, shaders::vs_arc, shaders::fs_rounded_arc)
+  VISAGE_SET_INSTANCED_PROGRAM(Fill, shaders::vs_color, shaders::vs_color_instanced,
+                               shaders::fs_color)
+  VISAGE_SET_INSTANCED_PROGRAM(Rectangle, shaders::vs_shape, shaders::vs_shape_instanced,
+                               shaders::fs_rectangle)
+  VISAGE_SET_INSTANCED_PROGRAM(RoundedRectangle, shaders::vs_shape, shaders::vs_shape_instanced,
+                               shaders::fs_rounded_rectangle)
+  VISAGE_SET_INSTANCED_PROGRAM(Circle, shaders::vs_shape, shaders::vs_shape_instanced,
+                               shaders::fs_circle)
+  VISAGE_SET_INSTANCED_PROGRAM(Squircle, shaders::vs_shape, shaders::vs_shape_instanced,
+                               shaders::fs_squircle)
+  VISAGE_SET_INSTANCED_PROGRAM(FlatArc, shaders::vs_arc, shaders::vs_arc_instanced,
+                               shaders::fs_flat_arc)
+  VISAGE_SET_INSTANCED_PROGRAM(RoundedArc, shaders::vs_arc, shaders::vs_arc_instanced,
+                               shaders::fs_rounded_arc)
   VISAGE_SET_PROGRAM(FlatSegment, shaders::vs_complex_shape, shaders::fs_flat_segment)
   VISAGE_SET_PROGRAM(RoundedSegment, shaders::vs_complex_shape, shaders::fs_rounded_segment)
   VISAGE_SET_PROGRAM(Triangle, shaders::vs_complex_shape, shaders::fs_triangle)
   VISAGE_SET_PROGRAM(QuadraticBezier, shaders::vs_complex_shape, shaders::fs_quadratic_bezier)
-  VISAGE_SET_PROGRAM(Diamond, shaders::vs_shape, shaders::fs_diamond)
+  VISAGE_SET_INSTANCED_PROGRAM(Diamond, shaders::vs_shape, shaders::vs_shape_instanced,
+                               shaders::fs_diamond)
+  VISAGE_SET_PROGRAM(SdfShape, shaders::vs_sdf_shape, shaders::fs_sdf_shape)
   VISAGE_SET_PROGRAM(ImageWrapper, shaders::vs_tinted_texture, shaders::fs_tinted_texture)
   VISAGE_SET_PROGRAM(LineWrapper, shaders::vs_line, shaders::fs_line)
   VISAGE_SET_PROGRAM(LineFillWrapper, shaders::vs_line_fill, shaders::fs_line_fill)
@@ -59,6 +75,17 @@ namespace visage {
       batch_id = post_effect;
   }
 
+  LineWrapper::LineWrapper(const ClampBounds& clamp, const PackedBrush* brush, float x, float y,
+                           float width, float height, Line* line, float line_width, float scale) :
+      Shape(batchId(), clamp, brush, x, y, width, height), line(line), line_width(line_width),
+      scale(scale), decimation_level(line->decimationLevel(scale)) { }
+
+  LineFillWrapper::LineFillWrapper(const ClampBounds& clamp, const PackedBrush* brush, float x,
+                                   float y, float width, float height, Line* line,
+                                   float fill_center, float scale) :
+      Shape(batchId(), clamp, brush, x, y, width, height), line(line), fill_center(fill_center),
+      scale(scale), decimation_level(line->decimationLevel(scale)) { }
+
   void SampleRegion::setVertexData(Vertex* vertices) const {
     region->layer()->setTexturePositionsForRegion(region, vertices);
   }
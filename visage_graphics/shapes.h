@@ -27,6 +27,7 @@
 
 #include <algorithm>
 #include <cfloat>
+#include <type_traits>
 
 #define VISAGE_CREATE_BATCH_ID \
   static void* batchId() {     \
@@ -44,6 +45,21 @@ namespace visage {
 
   static constexpr float kFullThickness = FLT_MAX;
 
+  enum class SdfShapeKind {
+    Fill,
+    Rectangle,
+    RoundedRectangle,
+    Circle,
+    Squircle,
+    FlatArc,
+    RoundedArc,
+    Diamond,
+    FlatSegment,
+    RoundedSegment,
+    Triangle,
+    QuadraticBezier,
+  };
+
   enum class Direction {
     Left,
     Up,
@@ -166,7 +182,9 @@ namespace visage {
 
   struct Fill : Primitive<> {
     VISAGE_CREATE_BATCH_ID
+    static constexpr SdfShapeKind kSdfKind = SdfShapeKind::Fill;
     static const EmbeddedFile& vertexShader();
+    static const EmbeddedFile& instancedVertexShader();
     static const EmbeddedFile& fragmentShader();
 
     Fill(const ClampBounds& clamp, const PackedBrush* brush, float x, float y, float width,
@@ -177,7 +195,9 @@ namespace visage {
 
   struct Rectangle : Primitive<> {
     VISAGE_CREATE_BATCH_ID
+    static constexpr SdfShapeKind kSdfKind = SdfShapeKind::Rectangle;
     static const EmbeddedFile& vertexShader();
+    static const EmbeddedFile& instancedVertexShader();
     static const EmbeddedFile& fragmentShader();
 
     Rectangle(const ClampBounds& clamp, const PackedBrush* brush, float x, float y, float width,
@@ -188,7 +208,9 @@ namespace visage {
 
   struct RoundedRectangle : Primitive<> {
     VISAGE_CREATE_BATCH_ID
+    static constexpr SdfShapeKind kSdfKind = SdfShapeKind::RoundedRectangle;
     static const EmbeddedFile& vertexShader();
+    static const EmbeddedFile& instancedVertexShader();
     static const EmbeddedFile& fragmentShader();
 
     RoundedRectangle(const ClampBounds& clamp, const PackedBrush* brush, float x, float y,
@@ -206,7 +228,9 @@ namespace visage {
 
   struct Circle : Primitive<> {
     VISAGE_CREATE_BATCH_ID
+    static constexpr SdfShapeKind kSdfKind = SdfShapeKind::Circle;
     static const EmbeddedFile& vertexShader();
+    static const EmbeddedFile& instancedVertexShader();
     static const EmbeddedFile& fragmentShader();
 
     Circle(const ClampBounds& clamp, const PackedBrush* brush, float x, float y, float width) :
@@ -217,7 +241,9 @@ namespace visage {
 
   struct Squircle : Primitive<> {
     VISAGE_CREATE_BATCH_ID
+    static constexpr SdfShapeKind kSdfKind = SdfShapeKind::Squircle;
     static const EmbeddedFile& vertexShader();
+    static const EmbeddedFile& instancedVertexShader();
     static const EmbeddedFile& fragmentShader();
 
     Squircle(const ClampBounds& clamp, const PackedBrush* brush, float x, float y, float width,
@@ -235,7 +261,9 @@ namespace visage {
 
   struct FlatArc : Primitive<> {
     VISAGE_CREATE_BATCH_ID
+    static constexpr SdfShapeKind kSdfKind = SdfShapeKind::FlatArc;
     static const EmbeddedFile& vertexShader();
+    static const EmbeddedFile& instancedVertexShader();
     static const EmbeddedFile& fragmentShader();
 
     FlatArc(const ClampBounds& clamp, const PackedBrush* brush, float x, float y, float width,
@@ -259,7 +287,9 @@ namespace visage {
 
   struct RoundedArc : Primitive<> {
     VISAGE_CREATE_BATCH_ID
+    static constexpr SdfShapeKind kSdfKind = SdfShapeKind::RoundedArc;
     static const EmbeddedFile& vertexShader();
+    static const EmbeddedFile& instancedVertexShader();
     static const EmbeddedFile& fragmentShader();
 
     RoundedArc(const ClampBounds& clamp, const PackedBrush* brush, float x, float y, float width,
@@ -283,6 +313,7 @@ namespace visage {
 
   struct FlatSegment : Primitive<ComplexShapeVertex> {
     VISAGE_CREATE_BATCH_ID
+    static constexpr SdfShapeKind kSdfKind = SdfShapeKind::FlatSegment;
     static const EmbeddedFile& vertexShader();
     static const EmbeddedFile& fragmentShader();
 
@@ -312,6 +343,7 @@ namespace visage {
 
   struct RoundedSegment : Primitive<ComplexShapeVertex> {
     VISAGE_CREATE_BATCH_ID
+    static constexpr SdfShapeKind kSdfKind = SdfShapeKind::RoundedSegment;
     static const EmbeddedFile& vertexShader();
     static const EmbeddedFile& fragmentShader();
 
@@ -341,6 +373,7 @@ namespace visage {
 
   struct Triangle : Primitive<ComplexShapeVertex> {
     VISAGE_CREATE_BATCH_ID
+    static constexpr SdfShapeKind kSdfKind = SdfShapeKind::Triangle;
     static const EmbeddedFile& vertexShader();
     static const EmbeddedFile& fragmentShader();
 
@@ -375,6 +408,7 @@ namespace visage {
 
   struct QuadraticBezier : Primitive<ComplexShapeVertex> {
     VISAGE_CREATE_BATCH_ID
+    static constexpr SdfShapeKind kSdfKind = SdfShapeKind::QuadraticBezier;
     static const EmbeddedFile& vertexShader();
     static const EmbeddedFile& fragmentShader();
 
@@ -409,7 +443,9 @@ namespace visage {
 
   struct Diamond : Primitive<> {
     VISAGE_CREATE_BATCH_ID
+    static constexpr SdfShapeKind kSdfKind = SdfShapeKind::Diamond;
     static const EmbeddedFile& vertexShader();
+    static const EmbeddedFile& instancedVertexShader();
     static const EmbeddedFile& fragmentShader();
 
     Diamond(const ClampBounds& clamp, const PackedBrush* brush, float x, float y, float width,
@@ -425,6 +461,58 @@ namespace visage {
     float rounding = 0.0f;
   };
 
+  template<typename T, typename = void>
+  struct HasSdfKind : std::false_type { };
+
+  template<typename T>
+  struct HasSdfKind<T, std::void_t<decltype(T::kSdfKind)>> : std::true_type { };
+
+  // Any primitive with an SdfShapeKind converted to one vertex format and drawn by a single
+  // shader, so neighboring primitives of different kinds can share a batch
+  struct SdfShape : Shape<SdfShapeVertex> {
+    VISAGE_CREATE_BATCH_ID
+    static const EmbeddedFile& vertexShader();
+    static const EmbeddedFile& fragmentShader();
+
+    template<typename T>
+    explicit SdfShape(const T& shape) :
+        Shape(batchId(), shape.clamp, shape.brush, shape.x, shape.y, shape.width, shape.height),
+        kind(T::kSdfKind) {
+      typename T::Vertex vertices[kVerticesPerQuad] {};
+      shape.setVertexData(vertices);
+      thickness = vertices[0].thickness;
+      fade = vertices[0].fade;
+      values[0] = vertices[0].value_1;
+      values[1] = vertices[0].value_2;
+      if constexpr (std::is_same_v<typename T::Vertex, ComplexShapeVertex>) {
+        values[2] = vertices[0].value_3;
+        values[3] = vertices[0].value_4;
+        values[4] = vertices[0].value_5;
+        values[5] = vertices[0].value_6;
+      }
+    }
+
+    void setVertexData(Vertex* vertices) const {
+      setCornerCoordinates(vertices);
+      for (int v = 0; v < kVerticesPerQuad; ++v) {
+        vertices[v].thickness = thickness;
+        vertices[v].fade = fade;
+        vertices[v].value_1 = values[0];
+        vertices[v].value_2 = values[1];
+        vertices[v].value_3 = values[2];
+        vertices[v].value_4 = values[3];
+        vertices[v].value_5 = values[4];
+        vertices[v].value_6 = values[5];
+        vertices[v].shape_kind = static_cast<float>(kind);
+      }
+    }
+
+    SdfShapeKind kind = SdfShapeKind::Fill;
+    float thickness = 0.0f;
+    float fade = 0.0f;
+    float values[6] {};
+  };
+
   struct ImageWrapper : Shape<TextureVertex> {
     static const EmbeddedFile& vertexShader();
     static const EmbeddedFile& fragmentShader();
@@ -453,13 +541,12 @@ namespace visage {
     static const EmbeddedFile& fragmentShader();
 
     LineWrapper(const ClampBounds& clamp, const PackedBrush* brush, float x, float y, float width,
-                float height, Line* line, float line_width, float scale) :
-        Shape(batchId(), clamp, brush, x, y, width, height), line(line), line_width(line_width),
-        scale(scale) { }
+                float height, Line* line, float line_width, float scale);
 
     Line* line = nullptr;
     float line_width = 0.0f;
     float scale = 1.0f;
+    int decimation_level = -1;
   };
 
   struct LineFillWrapper : Shape<> {
@@ -468,13 +555,12 @@ namespace visage {
     static const EmbeddedFile& fragmentShader();
 
     LineFillWrapper(const ClampBounds& clamp, const PackedBrush* brush, float x, float y,
-                    float width, float height, Line* line, float fill_center, float scale) :
-        Shape(batchId(), clamp, brush, x, y, width, height), line(line), fill_center(fill_center),
-        scale(scale) { }
+                    float width, float height, Line* line, float fill_center, float scale);
 
     Line* line = nullptr;
     float fill_center = 0.0f;
     float scale = 1.0f;
+    int decimation_level = -1;
   };
 
   template<typename T>
@@ -531,23 +617,18 @@ namespace visage {
     TextBlock(const ClampBounds& clamp, const PackedBrush* brush, float x, float y, float width,
               float height, Text* text, const Font& font, Direction direction) :
         Shape(font.packedFont(), clamp, brush, x, y, width, height),
-        quads(VectorPool<FontAtlasQuad>::instance().vector(text->text().length())), text(text),
-        font(font), direction(direction) {
+        quads(VectorPool<FontAtlasQuad>::instance().vector(0)), text(text), font(font),
+        direction(direction) {
       this->clamp = clamp.clamp(x, y, width, height);
 
-      const char32_t* c_str = text->text().c_str();
-      int length = text->text().length();
       float w = width;
       float h = height;
       if (direction == Direction::Left || direction == Direction::Right)
         std::swap(w, h);
-      if (text->multiLine()) {
-        font.setMultiLineVertexPositions(quads.data(), c_str, length, 0, 0, w, h, text->justification());
-      }
-      else {
-        font.setVertexPositions(quads.data(), c_str, length, 0, 0, w, h, text->justification(),
-                                text->characterOverride());
-      }
+      const std::vector<FontAtlasQuad>& layout = TextLayoutCache::instance()->layout(
+          font, text->text().c_str(), text->text().length(), w, h, text->justification(),
+          text->multiLine(), text->characterOverride());
+      quads.assign(layout.begin(), layout.end());
 
       if (direction == Direction::Down) {
         for (auto& quad : quads) {
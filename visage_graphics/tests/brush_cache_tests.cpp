@@ -0,0 +1,94 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "allocation_counter.h"
+#include "visage_graphics/region.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace visage;
+
+namespace {
+  void drawFrame(Region& region, BrushCache& cache, const std::vector<Color>& colors,
+                 const Brush& gradient_brush) {
+    region.clear();
+    for (int i = 0; i < 1000; ++i) {
+      region.addBrush(cache.solidBrush(colors[i % colors.size()]));
+      if (i % 10 == 0)
+        region.addBrush(cache.brush(gradient_brush));
+    }
+  }
+}
+
+TEST_CASE("Brush cache interns brushes", "[graphics]") {
+  GradientAtlas atlas;
+  BrushCache cache(&atlas);
+
+  auto red = cache.solidBrush(Color(0xffff0000));
+  auto red_again = cache.solidBrush(Color(0xffff0000));
+  auto blue = cache.solidBrush(Color(0xff0000ff));
+  REQUIRE(red == red_again);
+  REQUIRE(red != blue);
+  REQUIRE(cache.brush(Brush::solid(0xffff0000)) == red);
+
+  Brush horizontal = Brush::horizontal(0xffff0000, 0xff0000ff);
+  Brush vertical = Brush::vertical(0xffff0000, 0xff0000ff);
+  auto horizontal_brush = cache.brush(horizontal);
+  REQUIRE(cache.brush(horizontal) == horizontal_brush);
+  REQUIRE(cache.brush(vertical) != horizontal_brush);
+  REQUIRE(cache.brush(vertical)->gradient()->gradient().resolution() == 2);
+  REQUIRE(cache.numBrushes() == 4);
+
+  red_again = nullptr;
+  horizontal_brush = nullptr;
+  cache.removeUnusedBrushes();
+  REQUIRE(cache.numBrushes() == 2);
+  REQUIRE(cache.solidBrush(Color(0xffff0000)) == red);
+}
+
+TEST_CASE("Brush cache steady state frames do not allocate", "[graphics]") {
+  GradientAtlas atlas;
+  BrushCache cache(&atlas);
+  Region region;
+
+  std::vector<Color> colors;
+  for (int i = 0; i < 16; ++i)
+    colors.emplace_back(0xff000000 + i * 0x100);
+  Brush gradient_brush = Brush::linear(0xffff0000, 0xff00ff00, { 0.0f, 0.0f }, { 10.0f, 10.0f });
+
+  size_t start = numAllocations();
+  drawFrame(region, cache, colors, gradient_brush);
+  size_t first_frame_allocations = numAllocations() - start;
+  REQUIRE(first_frame_allocations > 0);
+  REQUIRE(cache.numBrushes() == static_cast<int>(colors.size()) + 1);
+
+  drawFrame(region, cache, colors, gradient_brush);
+  cache.removeUnusedBrushes();
+
+  start = numAllocations();
+  drawFrame(region, cache, colors, gradient_brush);
+  cache.removeUnusedBrushes();
+  size_t steady_frame_allocations = numAllocations() - start;
+  INFO("First frame allocations: " << first_frame_allocations);
+  INFO("Steady state frame allocations: " << steady_frame_allocations);
+  REQUIRE(steady_frame_allocations == 0);
+  REQUIRE(cache.numBrushes() == static_cast<int>(colors.size()) + 1);
+}
@@ -0,0 +1,176 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "embedded/fonts.h"
+#include "visage_graphics/font.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+using namespace visage;
+
+TEST_CASE("Font atlas stages one upload for a long string", "[graphics]") {
+  static constexpr int kLength = 2000;
+
+  std::u32string text;
+  for (char32_t c = 0x21; text.size() < kLength; ++c) {
+    if (c == 0x7f)
+      c = 0xc0;
+    else if (c > 0xff)
+      c = 0x21;
+    text.push_back(c);
+  }
+
+  Font font(14, fonts::Lato_Regular_ttf);
+  std::vector<FontAtlasQuad> quads(kLength);
+  font.setVertexPositions(quads.data(), text.c_str(), kLength, 0, 0, 10000, 100);
+
+  REQUIRE(font.atlasWidth() > 0);
+  REQUIRE(font.atlasBytes() == font.atlasWidth() * font.atlasHeight());
+  REQUIRE(font.emojiAtlasWidth() == 0);
+  REQUIRE(font.numStagedAtlasUploads() == 1);
+  REQUIRE(font.numAtlasUploads() == 0);
+}
+
+TEST_CASE("Packed glyphs stay put as the glyph table grows", "[graphics]") {
+  std::u32string text = U"A\u00e9\u0416\u20ac\U0001F600";
+  Font font(14, fonts::Lato_Regular_ttf);
+  std::vector<FontAtlasQuad> expected(text.size());
+  font.setVertexPositions(expected.data(), text.c_str(), text.size(), 0, 0, 1000, 100);
+  float width = font.stringWidth(text.c_str(), text.size());
+
+  std::u32string filler;
+  for (char32_t c = 0x21; c < 0x2000; ++c)
+    filler.push_back(c);
+  std::vector<FontAtlasQuad> filler_quads(filler.size());
+  font.setVertexPositions(filler_quads.data(), filler.c_str(), filler.size(), 0, 0, 100000, 100);
+
+  std::vector<FontAtlasQuad> quads(text.size());
+  font.setVertexPositions(quads.data(), text.c_str(), text.size(), 0, 0, 1000, 100);
+  for (size_t i = 0; i < text.size(); ++i) {
+    REQUIRE(quads[i].packed_glyph == expected[i].packed_glyph);
+    REQUIRE(quads[i].x == expected[i].x);
+    REQUIRE(quads[i].width == expected[i].width);
+  }
+  REQUIRE(font.stringWidth(text.c_str(), text.size()) == width);
+}
+
+TEST_CASE("Font atlas grows without moving glyphs", "[graphics]") {
+  Font font(14, fonts::Lato_Regular_ttf);
+  std::u32string text = U"Open Menu";
+  std::vector<FontAtlasQuad> quads(text.size());
+  font.setVertexPositions(quads.data(), text.c_str(), text.size(), 0, 0, 1000, 100);
+  std::vector<std::pair<int, int>> positions;
+  for (const FontAtlasQuad& quad : quads)
+    positions.emplace_back(quad.packed_glyph->atlas_left, quad.packed_glyph->atlas_top);
+
+  int atlas_width = font.atlasWidth();
+  std::u32string filler;
+  for (char32_t c = 0x21; c < 0x180; ++c) {
+    if (c < 0x7f || c > 0xa0)
+      filler.push_back(c);
+  }
+  std::vector<FontAtlasQuad> filler_quads(filler.size());
+  font.setVertexPositions(filler_quads.data(), filler.c_str(), filler.size(), 0, 0, 100000, 100);
+  REQUIRE(font.atlasWidth() > atlas_width);
+
+  for (size_t i = 0; i < quads.size(); ++i) {
+    REQUIRE(quads[i].packed_glyph->atlas_left == positions[i].first);
+    REQUIRE(quads[i].packed_glyph->atlas_top == positions[i].second);
+  }
+
+  for (size_t i = 0; i < filler_quads.size(); ++i) {
+    const PackedGlyph* a = filler_quads[i].packed_glyph;
+    if (a->type_face == nullptr)
+      continue;
+
+    REQUIRE(a->atlas_left + a->width <= font.atlasWidth());
+    REQUIRE(a->atlas_top + a->height <= font.atlasHeight());
+    for (size_t j = i + 1; j < filler_quads.size(); ++j) {
+      const PackedGlyph* b = filler_quads[j].packed_glyph;
+      if (a->type_face != b->type_face)
+        continue;
+
+      bool overlaps = a->atlas_left < b->atlas_left + b->width &&
+                      b->atlas_left < a->atlas_left + a->width &&
+                      a->atlas_top < b->atlas_top + b->height && b->atlas_top < a->atlas_top + a->height;
+      REQUIRE_FALSE(overlaps);
+    }
+  }
+}
+
+TEST_CASE("Text layout cache hits for repeated layouts", "[graphics]") {
+  TextLayoutCache* cache = TextLayoutCache::instance();
+  cache->clear();
+  cache->resetCounters();
+
+  Font font(12, fonts::Lato_Regular_ttf);
+  std::u32string text = U"Cutoff Frequency";
+  std::vector<FontAtlasQuad> expected(text.size());
+  font.setVertexPositions(expected.data(), text.c_str(), text.size(), 0, 0, 100, 20, Font::kLeft);
+
+  for (int i = 0; i < 100; ++i) {
+    const std::vector<FontAtlasQuad>& quads = cache->layout(font, text.c_str(), text.size(), 100,
+                                                            20, Font::kLeft, false, 0);
+    REQUIRE(quads.size() == expected.size());
+    for (size_t q = 0; q < quads.size(); ++q) {
+      REQUIRE(quads[q].packed_glyph == expected[q].packed_glyph);
+      REQUIRE(quads[q].x == expected[q].x);
+      REQUIRE(quads[q].y == expected[q].y);
+    }
+  }
+  REQUIRE(cache->misses() == 1);
+  REQUIRE(cache->hits() == 99);
+
+  cache->layout(font, text.c_str(), text.size(), 120, 20, Font::kLeft, false, 0);
+  cache->layout(font, text.c_str(), text.size(), 100, 20, Font::kCenter, false, 0);
+  cache->layout(font, text.c_str(), text.size() - 1, 100, 20, Font::kLeft, false, 0);
+  REQUIRE(cache->misses() == 4);
+  REQUIRE(cache->numEntries() == 4);
+
+  cache->setMaxEntries(2);
+  REQUIRE(cache->numEntries() == 2);
+  cache->layout(font, text.c_str(), text.size(), 100, 20, Font::kLeft, false, 0);
+  REQUIRE(cache->misses() == 5);
+  REQUIRE(cache->numEntries() == 2);
+
+  cache->setMaxEntries(TextLayoutCache::kDefaultMaxEntries);
+  cache->clear();
+}
+
+TEST_CASE("Stale fonts are evicted once the memory budget drops", "[graphics]") {
+  std::u32string text = U"Stale font";
+  FontCache::setMemoryBudget(64 * 1024 * 1024);
+  int num_fonts = FontCache::numFonts();
+  {
+    Font font(37, fonts::Lato_Regular_ttf);
+    std::vector<FontAtlasQuad> quads(text.size());
+    font.setVertexPositions(quads.data(), text.c_str(), text.size(), 0, 0, 1000, 100);
+  }
+
+  FontCache::clearStaleFonts();
+  REQUIRE(FontCache::numFonts() == num_fonts + 1);
+
+  FontCache::setMemoryBudget(1);
+  FontCache::clearStaleFonts();
+  REQUIRE(FontCache::numFonts() <= num_fonts);
+  FontCache::setMemoryBudget(0);
+}
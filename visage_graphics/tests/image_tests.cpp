@@ -43,4 +43,39 @@ TEST_CASE("Image blur", "[graphics]") {
     REQUIRE(image[i] == 0);
     REQUIRE(image[(kWidth * kHeight + 1) * ImageAtlas::kChannels + i] == 0);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Image atlas stays within its memory budget", "[graphics]") {
+  static constexpr int kNumImages = 4000;
+  static constexpr size_t kBudget = 256 * 1024;
+  static constexpr int kMaxImageBytes = 60 * 36 * ImageAtlas::kChannels;
+  static const char kData[kNumImages] = {};
+
+  ImageAtlas atlas;
+  atlas.setMemoryBudget(kBudget);
+  ImageAtlas::PackedImage kept = atlas.addImage(Image(kData, 1, 32, 32));
+
+  for (int i = 1; i < kNumImages; ++i) {
+    atlas.addImage(Image(kData + i, 1, 20 + i % 40, 16 + i % 20));
+    atlas.clearStaleImages();
+    REQUIRE(atlas.usedBytes() <= kBudget + kMaxImageBytes);
+    REQUIRE(atlas.textureBytes() <= 512 * 512 * ImageAtlas::kChannels);
+  }
+
+  REQUIRE(kept.w() == 32);
+  REQUIRE(atlas.numStaleImages() > 0);
+
+  const ImageAtlas::PackedImageRect* recent = nullptr;
+  {
+    ImageAtlas::PackedImage image = atlas.addImage(Image(kData + kNumImages - 1, 1, 20, 16));
+    recent = image.packedImageRect();
+  }
+  atlas.clearStaleImages();
+  ImageAtlas::PackedImage again = atlas.addImage(Image(kData + kNumImages - 1, 1, 20, 16));
+  REQUIRE(again.packedImageRect() == recent);
+
+  atlas.setMemoryBudget(0);
+  atlas.clearStaleImages();
+  REQUIRE(atlas.numStaleImages() == 0);
+  REQUIRE(atlas.usedBytes() == (32 * 32 + 20 * 16) * ImageAtlas::kChannels);
+}
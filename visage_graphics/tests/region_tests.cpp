@@ -0,0 +1,190 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "allocation_counter.h"
+#include "embedded/fonts.h"
+#include "visage_graphics/canvas.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace visage;
+
+namespace {
+  struct StaticScene {
+    Font font { 12, fonts::Lato_Regular_ttf };
+    String label = "Static scene label";
+    Brush gradient = Brush::vertical(0xffff0000, 0xff0000ff);
+  };
+
+  void drawStaticScene(Canvas& canvas, Region& region, const StaticScene& scene) {
+    canvas.beginRegion(&region);
+    for (int i = 0; i < 20; ++i) {
+      canvas.setColor(0xff000000 + i);
+      canvas.fill(i, i, 10, 10);
+      canvas.circle(i, 2 * i, 8);
+      canvas.setColor(scene.gradient);
+      canvas.roundedRectangle(2 * i, i, 20, 10, 3);
+      canvas.text(scene.label, scene.font, Font::kLeft, 0, i * 10, 100, 10);
+    }
+    canvas.endRegion();
+  }
+}
+
+TEST_CASE("Static scene redraw does not allocate", "[graphics]") {
+  Canvas canvas;
+  canvas.setDimensions(200, 200);
+  Region region;
+  region.setBounds(0, 0, 200, 200);
+  canvas.addRegion(&region);
+  StaticScene scene;
+
+  for (int i = 0; i < 3; ++i)
+    drawStaticScene(canvas, region, scene);
+
+  size_t start = numAllocations();
+  drawStaticScene(canvas, region, scene);
+  size_t allocations = numAllocations() - start;
+  INFO("Static scene redraw allocations: " << allocations);
+  REQUIRE(allocations == 0);
+}
+
+TEST_CASE("Flat sub regions follow empty containers", "[graphics]") {
+  Canvas canvas;
+  canvas.setDimensions(200, 200);
+  Region root;
+  root.setBounds(0, 0, 200, 200);
+  canvas.addRegion(&root);
+
+  Region container;
+  Region first;
+  Region second;
+  Region leaf;
+  root.addRegion(&container);
+  container.addRegion(&first);
+  container.addRegion(&second);
+  root.addRegion(&leaf);
+  container.setBounds(10, 20, 100, 100);
+  first.setBounds(5, 5, 10, 10);
+  second.setBounds(30, 5, 10, 10);
+  leaf.setBounds(150, 150, 20, 20);
+
+  for (Region* region : { &first, &second, &leaf }) {
+    canvas.beginRegion(region);
+    canvas.fill(0, 0, 10, 10);
+    canvas.endRegion();
+  }
+
+  const auto& flat = root.flatSubRegions();
+  REQUIRE(flat.size() == 4);
+  REQUIRE(flat[0].region == &container);
+  REQUIRE(flat[0].container);
+  REQUIRE(flat[0].end == 3);
+  REQUIRE(flat[1].region == &first);
+  REQUIRE(flat[1].x == 15);
+  REQUIRE(flat[1].y == 25);
+  REQUIRE(flat[2].region == &second);
+  REQUIRE(flat[3].region == &leaf);
+  REQUIRE_FALSE(flat[3].container);
+
+  container.setBounds(0, 0, 100, 100);
+  REQUIRE(root.flatSubRegions()[1].x == 5);
+
+  leaf.setVisible(false);
+  REQUIRE(root.flatSubRegions().size() == 3);
+
+  canvas.beginRegion(&container);
+  canvas.fill(0, 0, 10, 10);
+  canvas.endRegion();
+  REQUIRE(root.flatSubRegions().size() == 1);
+  REQUIRE_FALSE(root.flatSubRegions()[0].container);
+}
+
+TEST_CASE("Flat sub regions only flag overlapping siblings", "[graphics]") {
+  static constexpr int kGridSize = 8;
+
+  Canvas canvas;
+  canvas.setDimensions(200, 200);
+  Region root;
+  root.setBounds(0, 0, 200, 200);
+  canvas.addRegion(&root);
+
+  std::vector<Region> pads(kGridSize * kGridSize);
+  for (int i = 0; i < pads.size(); ++i) {
+    root.addRegion(&pads[i]);
+    pads[i].setBounds((i % kGridSize) * 20, (i / kGridSize) * 20, 20, 20);
+  }
+  Region popup;
+  Region empty;
+  root.addRegion(&popup);
+  root.addRegion(&empty);
+  popup.setBounds(30, 30, 20, 20);
+  empty.setBounds(0, 0, 200, 200);
+
+  for (Region& pad : pads) {
+    canvas.beginRegion(&pad);
+    canvas.fill(0, 0, 20, 20);
+    canvas.endRegion();
+  }
+  canvas.beginRegion(&popup);
+  canvas.fill(0, 0, 20, 20);
+  canvas.endRegion();
+
+  const auto& flat = root.flatSubRegions();
+  REQUIRE(flat.size() == pads.size() + 1);
+  for (int i = 0; i < pads.size(); ++i)
+    REQUIRE_FALSE(flat[i].overlaps);
+  REQUIRE(flat.back().region == &popup);
+  REQUIRE(flat.back().overlaps);
+
+  canvas.beginRegion(&empty);
+  canvas.fill(0, 0, 10, 10);
+  canvas.endRegion();
+  REQUIRE(root.flatSubRegions().size() == pads.size() + 2);
+  REQUIRE(root.flatSubRegions().back().region == &empty);
+  REQUIRE(root.flatSubRegions().back().overlaps);
+}
+
+TEST_CASE("Stacked sub regions are not all compared with each other", "[graphics]") {
+  static constexpr int kNumRows = 1200;
+  static constexpr int kRowHeight = 20;
+
+  Canvas canvas;
+  canvas.setDimensions(100, kNumRows * kRowHeight);
+  Region root;
+  root.setBounds(0, 0, 100, kNumRows * kRowHeight);
+  canvas.addRegion(&root);
+
+  std::vector<Region> rows(kNumRows);
+  for (int i = 0; i < kNumRows; ++i) {
+    root.addRegion(&rows[i]);
+    rows[i].setBounds(0, i * kRowHeight, 100, kRowHeight + kRowHeight / 2);
+    canvas.beginRegion(&rows[i]);
+    canvas.fill(0, 0, 100, kRowHeight);
+    canvas.endRegion();
+  }
+
+  const auto& flat = root.flatSubRegions();
+  REQUIRE(flat.size() == kNumRows);
+  REQUIRE_FALSE(flat[0].overlaps);
+  for (int i = 1; i < kNumRows; ++i)
+    REQUIRE(flat[i].overlaps);
+  REQUIRE(root.numOverlapChecks() < 2 * kNumRows);
+}
@@ -0,0 +1,680 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "allocation_counter.h"
+#include "visage_graphics/line.h"
+#include "visage_graphics/shape_batcher.h"
+#include "visage_utils/sample_ring.h"
+
+#include <atomic>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <tuple>
+
+using namespace visage;
+
+namespace {
+  int linearBatchIndex(const ShapeBatcher& batcher, const BaseShape& shape, BlendMode blend) {
+    int match = batcher.numBatches();
+    int insert = batcher.numBatches();
+    for (int i = batcher.numBatches() - 1; i >= 0; --i) {
+      SubmitBatch* batch = batcher.batchAtIndex(i);
+      if (batch->id() == shape.batch_id && batch->blendMode() == blend)
+        match = i;
+      int x = shape.x;
+      int y = shape.y;
+      int right = shape.x + shape.width;
+      int bottom = shape.y + shape.height;
+      const std::vector<BatchArea>& areas = batch->areas();
+      auto overlaps = [x, y, right, bottom](const BatchArea& area) {
+        return x < area.right && right > area.x && y < area.bottom && bottom > area.y;
+      };
+      if (std::any_of(areas.begin(), areas.end(), overlaps))
+        break;
+      if (batch->id() > shape.batch_id)
+        insert = i;
+    }
+    if (match < batcher.numBatches())
+      return match;
+    return insert;
+  }
+
+  template<typename F>
+  void forEachMixedShape(int num_shapes, F&& callback) {
+    static constexpr int kColumns = 50;
+    static constexpr float kSpacing = 40.0f;
+
+    std::mt19937 generator(num_shapes);
+    std::uniform_real_distribution<float> offset(0.0f, 16.0f);
+    std::uniform_real_distribution<float> size(2.0f, 24.0f);
+    std::uniform_int_distribution<int> type(0, 19);
+
+    ClampBounds clamp = { 0.0f, 0.0f, 4000.0f, 4000.0f };
+    for (int i = 0; i < num_shapes; ++i) {
+      int widget = i / 5;
+      float x = (widget % kColumns) * kSpacing + offset(generator);
+      float y = (widget / kColumns) * kSpacing + offset(generator);
+      float width = size(generator);
+      float height = size(generator);
+      BlendMode blend = type(generator) == 0 ? BlendMode::Add : BlendMode::Alpha;
+
+      switch (type(generator) % 7) {
+      case 0: callback(Fill(clamp, nullptr, x, y, width, height), blend); break;
+      case 1: callback(Rectangle(clamp, nullptr, x, y, width, height), blend); break;
+      case 2: callback(RoundedRectangle(clamp, nullptr, x, y, width, height, 4.0f), blend); break;
+      case 3: callback(Circle(clamp, nullptr, x, y, width), blend); break;
+      case 4:
+        callback(Triangle(clamp, nullptr, x, y, width, height, 0.0f, 0.0f, width, 0.0f, 0.0f,
+                          height, 1.0f, 1.0f),
+                 blend);
+        break;
+      case 5: callback(Diamond(clamp, nullptr, x, y, width, height, 2.0f), blend); break;
+      default: callback(Squircle(clamp, nullptr, x, y, width, height, 4.0f), blend); break;
+      }
+
+      if (i % 1000 == 999)
+        callback(Fill(clamp, nullptr, 0.0f, y, kColumns * kSpacing, kSpacing), BlendMode::Alpha);
+    }
+  }
+}
+
+TEST_CASE("Shape instances match quad vertices", "[graphics]") {
+  static_assert(sizeof(ShapeInstance) % 16 == 0);
+  static_assert(HasInstancedShader<RoundedRectangle>::value);
+  static_assert(!HasInstancedShader<Triangle>::value);
+
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<float> position(-50.0f, 350.0f);
+  std::uniform_real_distribution<float> size(1.0f, 120.0f);
+
+  ClampBounds clamp = { 0.0f, 0.0f, 300.0f, 250.0f };
+  std::vector<RoundedRectangle> shapes;
+  for (int i = 0; i < 200; ++i) {
+    shapes.emplace_back(clamp, nullptr, position(generator), position(generator), size(generator),
+                        size(generator), size(generator) * 0.1f);
+    shapes.back().thickness = size(generator) * 0.05f;
+  }
+
+  DirtyRegion invalid_rects(DirtyRegion::kDefaultMaxRects, 0.0f);
+  invalid_rects.add({ 0, 0, 200, 150 });
+  invalid_rects.add({ 200, 0, 100, 250 });
+  invalid_rects.add({ 0, 150, 150, 100 });
+  REQUIRE(invalid_rects.numRects() == 3);
+  BatchVector<RoundedRectangle> batches;
+  batches.emplace_back(&shapes, &invalid_rects, 10, 20);
+
+  int num_shapes = numShapes(batches);
+  REQUIRE(num_shapes > shapes.size() / 2);
+
+  std::vector<ShapeVertex> vertices(num_shapes * kVerticesPerQuad);
+  std::vector<ShapeInstance> instances(num_shapes);
+  REQUIRE(setQuadVertices(batches, vertices.data()) == num_shapes * kVerticesPerQuad);
+  REQUIRE(setQuadInstances(batches, instances.data()) == num_shapes);
+
+  for (int i = 0; i < num_shapes; ++i) {
+    const ShapeInstance& instance = instances[i];
+    for (int v = 0; v < kVerticesPerQuad; ++v) {
+      const ShapeVertex& vertex = vertices[i * kVerticesPerQuad + v];
+      float corner_x = vertex.coordinate_x * 0.5f + 0.5f;
+      float corner_y = vertex.coordinate_y * 0.5f + 0.5f;
+      REQUIRE(vertex.x == instance.x + corner_x * instance.dimension_x);
+      REQUIRE(vertex.y == instance.y + corner_y * instance.dimension_y);
+      REQUIRE(vertex.dimension_x == instance.dimension_x);
+      REQUIRE(vertex.dimension_y == instance.dimension_y);
+      REQUIRE(vertex.gradient_color_from_x == instance.gradient_color_from_x);
+      REQUIRE(vertex.gradient_color_from_y == instance.gradient_color_from_y);
+      REQUIRE(vertex.gradient_color_to_x == instance.gradient_color_to_x);
+      REQUIRE(vertex.gradient_color_to_y == instance.gradient_color_to_y);
+      REQUIRE(vertex.gradient_position_from_x == instance.gradient_position_from_x);
+      REQUIRE(vertex.gradient_position_from_y == instance.gradient_position_from_y);
+      REQUIRE(vertex.gradient_position_to_x == instance.gradient_position_to_x);
+      REQUIRE(vertex.gradient_position_to_y == instance.gradient_position_to_y);
+      REQUIRE(vertex.clamp_left == instance.clamp_left);
+      REQUIRE(vertex.clamp_top == instance.clamp_top);
+      REQUIRE(vertex.clamp_right == instance.clamp_right);
+      REQUIRE(vertex.clamp_bottom == instance.clamp_bottom);
+      REQUIRE(vertex.thickness == instance.thickness);
+      REQUIRE(vertex.fade == instance.fade);
+      REQUIRE(vertex.value_1 == instance.value_1);
+      REQUIRE(vertex.value_2 == instance.value_2);
+    }
+  }
+}
+
+TEST_CASE("Parallel vertex generation matches serial output", "[graphics]") {
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<float> position(-50.0f, 1050.0f);
+  std::uniform_real_distribution<float> size(1.0f, 60.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  ClampBounds clamp = { 0.0f, 0.0f, 1000.0f, 800.0f };
+  std::vector<RoundedRectangle> shapes[3];
+  std::vector<Triangle> triangles;
+  for (auto& batch_shapes : shapes) {
+    for (int i = 0; i < 3000; ++i) {
+      batch_shapes.emplace_back(clamp, nullptr, position(generator), position(generator),
+                                size(generator), size(generator), size(generator) * 0.1f);
+      batch_shapes.back().thickness = size(generator) * 0.05f;
+    }
+  }
+  for (int i = 0; i < 3000; ++i) {
+    float width = size(generator);
+    float height = size(generator);
+    triangles.emplace_back(clamp, nullptr, position(generator), position(generator), width, height,
+                           0.0f, height, width * unit(generator), 0.0f, width, height, 1.0f, 2.0f);
+  }
+
+  DirtyRegion invalid_rects(DirtyRegion::kDefaultMaxRects, 0.0f);
+  invalid_rects.add({ 0, 0, 500, 300 });
+  invalid_rects.add({ 500, 0, 500, 800 });
+  invalid_rects.add({ 0, 300, 300, 500 });
+  DirtyRegion full_rect;
+  full_rect.add({ 0, 0, 1000, 800 });
+
+  BatchVector<RoundedRectangle> batches;
+  batches.emplace_back(&shapes[0], &invalid_rects, 0, 0);
+  batches.emplace_back(&shapes[1], &full_rect, 17, 5);
+  batches.emplace_back(&shapes[2], &invalid_rects, -30, 40);
+  BatchVector<Triangle> triangle_batches;
+  triangle_batches.emplace_back(&triangles, &invalid_rects, 3, 9);
+
+  auto generate = [&](bool parallel) {
+    setParallelVertexGeneration(parallel);
+    int num_shapes = numShapes(batches);
+    int num_triangles = numShapes(triangle_batches);
+    std::vector<ShapeVertex> vertices(num_shapes * kVerticesPerQuad);
+    std::vector<CompactShapeVertex> compact(num_shapes * kVerticesPerQuad);
+    std::vector<ShapeInstance> instances(num_shapes);
+    std::vector<ComplexShapeVertex> triangle_vertices(num_triangles * kVerticesPerQuad);
+    REQUIRE(setQuadVertices(batches, vertices.data()) == vertices.size());
+    REQUIRE(setCompactQuadVertices(batches, compact.data()));
+    REQUIRE(setQuadInstances(batches, instances.data()) == instances.size());
+    REQUIRE(setQuadVertices(triangle_batches, triangle_vertices.data()) == triangle_vertices.size());
+    setParallelVertexGeneration(true);
+    return std::make_tuple(vertices, compact, instances, triangle_vertices);
+  };
+
+  auto bytes_equal = [](const auto& a, const auto& b) {
+    using Element = typename std::decay_t<decltype(a)>::value_type;
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(Element)) == 0;
+  };
+
+  auto serial = generate(false);
+  auto parallel = generate(true);
+  REQUIRE(std::get<0>(serial).size() > kMinParallelShapes * kVerticesPerQuad);
+  REQUIRE(bytes_equal(std::get<0>(serial), std::get<0>(parallel)));
+  REQUIRE(bytes_equal(std::get<1>(serial), std::get<1>(parallel)));
+  REQUIRE(bytes_equal(std::get<2>(serial), std::get<2>(parallel)));
+  REQUIRE(bytes_equal(std::get<3>(serial), std::get<3>(parallel)));
+}
+
+TEST_CASE("Compact vertices round trip within half a pixel", "[graphics]") {
+  static_assert(sizeof(CompactShapeVertex) * 2 <= sizeof(ShapeVertex));
+  static_assert(sizeof(CompactComplexShapeVertex) * 2 <= sizeof(ComplexShapeVertex));
+  static_assert(sizeof(CompactTextureVertex) * 2 <= sizeof(TextureVertex));
+  static_assert(HasCompactVertex<ComplexShapeVertex>::value);
+  static_assert(!HasCompactVertex<PostEffectVertex>::value);
+
+  static constexpr float kMaxPixelError = 0.5f;
+  auto half_error = [](float value) { return std::max(std::abs(value) / 1024.0f, 1.0f / 16384.0f); };
+
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<float> position(-2000.0f, 4000.0f);
+  std::uniform_real_distribution<float> size(0.5f, 800.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  ClampBounds clamp = { 0.0f, 0.0f, 3840.0f, 2160.0f };
+  DirtyRegion invalid_rects;
+  invalid_rects.add({ 0, 0, 3840, 2160 });
+
+  SECTION("Shape vertices") {
+    std::vector<RoundedRectangle> shapes;
+    for (int i = 0; i < 500; ++i) {
+      shapes.emplace_back(clamp, nullptr, position(generator), position(generator),
+                          size(generator), size(generator), size(generator) * 0.1f);
+      shapes.back().thickness = size(generator) * 0.05f;
+    }
+
+    BatchVector<RoundedRectangle> batches;
+    batches.emplace_back(&shapes, &invalid_rects, 13, 7);
+    int num_vertices = numShapes(batches) * kVerticesPerQuad;
+    std::vector<ShapeVertex> vertices(num_vertices);
+    std::vector<CompactShapeVertex> compact(num_vertices);
+    REQUIRE(setQuadVertices(batches, vertices.data()) == num_vertices);
+    REQUIRE(setCompactQuadVertices(batches, compact.data()));
+
+    for (int i = 0; i < num_vertices; ++i) {
+      const ShapeVertex& vertex = vertices[i];
+      ShapeVertex result {};
+      expandVertex(compact[i], &result);
+      REQUIRE(std::abs(result.x - vertex.x) < kMaxPixelError);
+      REQUIRE(std::abs(result.y - vertex.y) < kMaxPixelError);
+      REQUIRE(std::abs(result.dimension_x - vertex.dimension_x) < kMaxPixelError);
+      REQUIRE(std::abs(result.dimension_y - vertex.dimension_y) < kMaxPixelError);
+      REQUIRE(std::abs(result.coordinate_x - vertex.coordinate_x) < kMaxPixelError);
+      REQUIRE(std::abs(result.coordinate_y - vertex.coordinate_y) < kMaxPixelError);
+      REQUIRE(std::abs(result.clamp_left - vertex.clamp_left) < kMaxPixelError);
+      REQUIRE(std::abs(result.clamp_bottom - vertex.clamp_bottom) < kMaxPixelError);
+      REQUIRE(std::abs(result.thickness - vertex.thickness) <= half_error(vertex.thickness));
+      REQUIRE(std::abs(result.value_1 - vertex.value_1) <= half_error(vertex.value_1));
+      REQUIRE(std::abs(result.value_2 - vertex.value_2) <= half_error(vertex.value_2));
+    }
+  }
+
+  SECTION("Complex shape vertices") {
+    std::vector<Triangle> shapes;
+    for (int i = 0; i < 500; ++i) {
+      float width = size(generator);
+      float height = size(generator);
+      shapes.emplace_back(clamp, nullptr, position(generator), position(generator), width, height,
+                          0.0f, height, width * unit(generator), 0.0f, width, height,
+                          size(generator) * 0.01f, size(generator) * 0.05f);
+    }
+
+    BatchVector<Triangle> batches;
+    batches.emplace_back(&shapes, &invalid_rects, 0, 0);
+    int num_vertices = numShapes(batches) * kVerticesPerQuad;
+    std::vector<ComplexShapeVertex> vertices(num_vertices);
+    std::vector<CompactComplexShapeVertex> compact(num_vertices);
+    REQUIRE(setQuadVertices(batches, vertices.data()) == num_vertices);
+    REQUIRE(setCompactQuadVertices(batches, compact.data()));
+
+    for (int i = 0; i < num_vertices; ++i) {
+      const ComplexShapeVertex& vertex = vertices[i];
+      ComplexShapeVertex result {};
+      expandVertex(compact[i], &result);
+      REQUIRE(std::abs(result.x - vertex.x) < kMaxPixelError);
+      REQUIRE(std::abs(result.y - vertex.y) < kMaxPixelError);
+      REQUIRE(std::abs(result.value_3 - vertex.value_3) <= half_error(vertex.value_3));
+      REQUIRE(std::abs(result.value_6 - vertex.value_6) <= half_error(vertex.value_6));
+    }
+  }
+
+  SECTION("Texture vertices") {
+    for (int i = 0; i < 2000; ++i) {
+      TextureVertex vertex {};
+      vertex.x = position(generator);
+      vertex.y = position(generator);
+      vertex.gradient_color_from_x = unit(generator);
+      vertex.gradient_color_to_y = unit(generator);
+      vertex.gradient_position_from_x = position(generator);
+      vertex.gradient_position_to_y = position(generator);
+      vertex.texture_x = std::round(unit(generator) * 4096.0f);
+      vertex.texture_y = std::round(unit(generator) * 4096.0f);
+      vertex.direction_y = -1.0f;
+      vertex.clamp_right = clamp.right;
+      vertex.atlas_page = i % 2;
+
+      CompactTextureVertex compact {};
+      TextureVertex result {};
+      REQUIRE(compactVertex(vertex, &compact));
+      expandVertex(compact, &result);
+      REQUIRE(std::abs(result.x - vertex.x) < kMaxPixelError);
+      REQUIRE(std::abs(result.y - vertex.y) < kMaxPixelError);
+      REQUIRE(std::abs(result.gradient_color_from_x - vertex.gradient_color_from_x) < 1.0f / 32767.0f);
+      REQUIRE(std::abs(result.gradient_color_to_y - vertex.gradient_color_to_y) < 1.0f / 32767.0f);
+      REQUIRE(std::abs(result.gradient_position_from_x - vertex.gradient_position_from_x) <
+              kMaxPixelError);
+      REQUIRE(std::abs(result.texture_x - vertex.texture_x) < kMaxPixelError);
+      REQUIRE(std::abs(result.texture_y - vertex.texture_y) < kMaxPixelError);
+      REQUIRE(result.direction_y == vertex.direction_y);
+      REQUIRE(std::abs(result.clamp_right - vertex.clamp_right) < kMaxPixelError);
+      REQUIRE(result.atlas_page == vertex.atlas_page);
+    }
+  }
+
+  SECTION("Out of range values are rejected") {
+    ShapeVertex vertex {};
+    CompactShapeVertex compact {};
+    REQUIRE(compactVertex(vertex, &compact));
+    vertex.x = kCompactPixelRange * 2.0f;
+    REQUIRE_FALSE(compactVertex(vertex, &compact));
+    vertex.x = 0.0f;
+    vertex.value_1 = 1.0e6f;
+    REQUIRE_FALSE(compactVertex(vertex, &compact));
+  }
+}
+
+namespace {
+  template<typename T>
+  void requireSdfVerticesMatch(const T& shape) {
+    static_assert(HasSdfKind<T>::value);
+
+    typename T::Vertex expected[kVerticesPerQuad] {};
+    setQuadPositions(expected, shape, shape.clamp, 3.0f, 5.0f);
+    shape.setVertexData(expected);
+
+    SdfShape sdf_shape(shape);
+    SdfShapeVertex result[kVerticesPerQuad] {};
+    setQuadPositions(result, sdf_shape, sdf_shape.clamp, 3.0f, 5.0f);
+    sdf_shape.setVertexData(result);
+
+    for (int v = 0; v < kVerticesPerQuad; ++v) {
+      REQUIRE(result[v].x == expected[v].x);
+      REQUIRE(result[v].y == expected[v].y);
+      REQUIRE(result[v].gradient_color_from_x == expected[v].gradient_color_from_x);
+      REQUIRE(result[v].gradient_position_to_y == expected[v].gradient_position_to_y);
+      REQUIRE(result[v].coordinate_x == expected[v].coordinate_x);
+      REQUIRE(result[v].coordinate_y == expected[v].coordinate_y);
+      REQUIRE(result[v].dimension_x == expected[v].dimension_x);
+      REQUIRE(result[v].dimension_y == expected[v].dimension_y);
+      REQUIRE(result[v].clamp_left == expected[v].clamp_left);
+      REQUIRE(result[v].clamp_bottom == expected[v].clamp_bottom);
+      REQUIRE(result[v].thickness == expected[v].thickness);
+      REQUIRE(result[v].fade == expected[v].fade);
+      REQUIRE(result[v].value_1 == expected[v].value_1);
+      REQUIRE(result[v].value_2 == expected[v].value_2);
+      if constexpr (std::is_same_v<typename T::Vertex, ComplexShapeVertex>) {
+        REQUIRE(result[v].value_3 == expected[v].value_3);
+        REQUIRE(result[v].value_4 == expected[v].value_4);
+        REQUIRE(result[v].value_5 == expected[v].value_5);
+        REQUIRE(result[v].value_6 == expected[v].value_6);
+      }
+      REQUIRE(result[v].shape_kind == static_cast<float>(T::kSdfKind));
+    }
+  }
+}
+
+TEST_CASE("SDF shapes carry the same vertex data as per type shapes", "[graphics]") {
+  ClampBounds clamp = { 2.0f, 4.0f, 90.0f, 70.0f };
+  requireSdfVerticesMatch(Fill(clamp, nullptr, 10.0f, 12.0f, 30.0f, 20.0f));
+  requireSdfVerticesMatch(Rectangle(clamp, nullptr, 10.0f, 12.0f, 30.0f, 20.0f));
+  requireSdfVerticesMatch(RoundedRectangle(clamp, nullptr, 10.0f, 12.0f, 30.0f, 20.0f, 4.0f));
+  requireSdfVerticesMatch(Circle(clamp, nullptr, 10.0f, 12.0f, 30.0f));
+  requireSdfVerticesMatch(Squircle(clamp, nullptr, 10.0f, 12.0f, 30.0f, 30.0f, 4.0f));
+  requireSdfVerticesMatch(FlatArc(clamp, nullptr, 10.0f, 12.0f, 30.0f, 30.0f, 3.0f, 1.0f, 2.0f));
+  requireSdfVerticesMatch(RoundedArc(clamp, nullptr, 10.0f, 12.0f, 30.0f, 30.0f, 3.0f, 1.0f, 2.0f));
+  requireSdfVerticesMatch(Diamond(clamp, nullptr, 10.0f, 12.0f, 30.0f, 30.0f, 2.0f));
+  requireSdfVerticesMatch(FlatSegment(clamp, nullptr, 10.0f, 12.0f, 30.0f, 20.0f, -0.5f, -0.5f,
+                                      0.5f, 0.5f, 2.0f, 1.0f));
+  requireSdfVerticesMatch(RoundedSegment(clamp, nullptr, 10.0f, 12.0f, 30.0f, 20.0f, -0.5f, -0.5f,
+                                         0.5f, 0.5f, 2.0f, 1.0f));
+  requireSdfVerticesMatch(Triangle(clamp, nullptr, 10.0f, 12.0f, 30.0f, 20.0f, 0.0f, 20.0f, 15.0f,
+                                   0.0f, 30.0f, 20.0f, 1.0f, 2.0f));
+  requireSdfVerticesMatch(QuadraticBezier(clamp, nullptr, 10.0f, 12.0f, 30.0f, 20.0f, -0.5f, 0.5f,
+                                          0.0f, -0.5f, 0.5f, 0.5f, 2.0f, 1.0f));
+}
+
+TEST_CASE("SDF shapes merge overlapping primitives into one batch", "[graphics]") {
+  ClampBounds clamp = { 0.0f, 0.0f, 4000.0f, 200.0f };
+  ShapeBatcher per_type;
+  ShapeBatcher sdf;
+  for (int i = 0; i < 100; ++i) {
+    float x = i * 30.0f;
+    RoundedRectangle background(clamp, nullptr, x, 0.0f, 40.0f, 40.0f, 4.0f);
+    Circle knob(clamp, nullptr, x + 5.0f, 5.0f, 30.0f);
+    RoundedArc arc(clamp, nullptr, x + 2.0f, 2.0f, 36.0f, 36.0f, 3.0f, 0.0f, 2.0f);
+
+    per_type.addShape(background);
+    per_type.addShape(knob);
+    per_type.addShape(arc);
+    sdf.addShape(SdfShape(background));
+    sdf.addShape(SdfShape(knob));
+    sdf.addShape(SdfShape(arc));
+  }
+
+  REQUIRE(per_type.numBatches() >= 100);
+  REQUIRE(sdf.numBatches() == 1);
+}
+
+TEST_CASE("Retained geometry key tracks batch content", "[graphics]") {
+  ClampBounds clamp = { 0.0f, 0.0f, 400.0f, 400.0f };
+  ShapeBatcher batcher;
+  batcher.setRetainedGeometry(true);
+  batcher.addShape(Rectangle(clamp, nullptr, 10.0f, 10.0f, 50.0f, 50.0f));
+  batcher.addShape(Rectangle(clamp, nullptr, 100.0f, 10.0f, 50.0f, 50.0f));
+  REQUIRE(batcher.numBatches() == 1);
+  REQUIRE(batcher.batchAtIndex(0)->retained());
+
+  DirtyRegion invalid_rects;
+  invalid_rects.add({ 0, 0, 200, 200 });
+  auto key = [&batcher, &invalid_rects](int x, int y) {
+    return retainedGeometryKey({ { batcher.batchAtIndex(0), &invalid_rects, x, y } });
+  };
+
+  uint64_t original = key(0, 0);
+  REQUIRE(key(0, 0) == original);
+  REQUIRE(key(5, 0) != original);
+
+  invalid_rects.clear();
+  invalid_rects.add({ 0, 0, 100, 200 });
+  REQUIRE(key(0, 0) != original);
+  invalid_rects.clear();
+  invalid_rects.add({ 0, 0, 200, 200 });
+  REQUIRE(key(0, 0) == original);
+
+  batcher.addShape(Rectangle(clamp, nullptr, 200.0f, 200.0f, 50.0f, 50.0f));
+  REQUIRE(key(0, 0) != original);
+
+  uint64_t added = key(0, 0);
+  batcher.clear();
+  batcher.addShape(Rectangle(clamp, nullptr, 10.0f, 10.0f, 50.0f, 50.0f));
+  batcher.addShape(Rectangle(clamp, nullptr, 100.0f, 10.0f, 50.0f, 50.0f));
+  REQUIRE(key(0, 0) != added);
+  REQUIRE(key(0, 0) != original);
+
+  batcher.setRetainedGeometry(false);
+  REQUIRE_FALSE(batcher.batchAtIndex(0)->retained());
+}
+
+TEST_CASE("Line batches stitch into a single strip", "[graphics]") {
+  static constexpr int kNumLines = 32;
+  static constexpr int kNumPoints = 20;
+
+  ClampBounds clamp = { 0.0f, 0.0f, 400.0f, 300.0f };
+  std::vector<Line> lines(kNumLines, Line(kNumPoints));
+  std::vector<LineWrapper> line_wrappers;
+  std::vector<LineFillWrapper> fill_wrappers;
+  for (int i = 0; i < kNumLines; ++i) {
+    for (int p = 0; p < kNumPoints; ++p) {
+      lines[i].x[p] = p * 10.0f;
+      lines[i].y[p] = 50.0f + 40.0f * std::sin(p * 0.3f);
+    }
+    line_wrappers.emplace_back(clamp, nullptr, i, 2.0f * i, 200.0f, 100.0f, &lines[i], 1.5f, 1.0f);
+    fill_wrappers.emplace_back(clamp, nullptr, i, 2.0f * i, 200.0f, 100.0f, &lines[i], 100.0f, 1.0f);
+  }
+
+  DirtyRegion invalid_rects;
+  invalid_rects.add({ 0, 0, 400, 300 });
+  BatchVector<LineWrapper> line_batches;
+  line_batches.emplace_back(&line_wrappers, &invalid_rects, 5, 7);
+  BatchVector<LineFillWrapper> fill_batches;
+  fill_batches.emplace_back(&fill_wrappers, &invalid_rects, 5, 7);
+
+  auto check_strip = [](const std::vector<LineVertex>& vertices, int strip_vertices) {
+    for (int i = 0; i < kNumLines; ++i) {
+      int start = i * (strip_vertices + 2);
+      for (int v = 0; v < strip_vertices; ++v) {
+        REQUIRE(std::abs(vertices[start + v].x - vertices[v].x - i) < 0.001f);
+        REQUIRE(std::abs(vertices[start + v].y - vertices[v].y - 2.0f * i) < 0.001f);
+        REQUIRE(vertices[start + v].clamp_left == 5.0f + i);
+        REQUIRE(vertices[start + v].clamp_top == 7.0f + 2.0f * i);
+      }
+
+      if (i > 0) {
+        REQUIRE(vertices[start - 2].x == vertices[start - 3].x);
+        REQUIRE(vertices[start - 2].y == vertices[start - 3].y);
+        REQUIRE(vertices[start - 1].x == vertices[start].x);
+        REQUIRE(vertices[start - 1].y == vertices[start].y);
+      }
+    }
+  };
+
+  int num_line_vertices = numLineVertices(line_batches);
+  REQUIRE(num_line_vertices == kNumLines * (lines[0].num_line_vertices + 2) - 2);
+  std::vector<LineVertex> line_vertices(num_line_vertices);
+  REQUIRE(setLineVertices(line_batches, line_vertices.data()) == num_line_vertices);
+  check_strip(line_vertices, lines[0].num_line_vertices);
+
+  int num_fill_vertices = numLineFillVertices(fill_batches);
+  REQUIRE(num_fill_vertices == kNumLines * (lines[0].num_fill_vertices + 2) - 2);
+  std::vector<LineVertex> fill_vertices(num_fill_vertices);
+  REQUIRE(setLineFillVertices(fill_batches, fill_vertices.data()) == num_fill_vertices);
+  check_strip(fill_vertices, lines[0].num_fill_vertices);
+}
+
+TEST_CASE("Decimated line fill keeps the min max envelope", "[graphics]") {
+  static constexpr int kWidth = 400;
+  static constexpr int kPointsPerPixel = 256;
+  static constexpr int kNumPoints = kWidth * kPointsPerPixel;
+
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+  Line line(kNumPoints);
+  line.setMinMaxDecimation(true);
+  for (int i = 0; i < kNumPoints; ++i) {
+    line.x[i] = i / static_cast<float>(kPointsPerPixel);
+    line.y[i] = 100.0f + 60.0f * std::sin(i * 0.001f) + 30.0f * noise(random);
+  }
+
+  auto check_envelope = [&line] {
+    ClampBounds clamp = { 0.0f, 0.0f, kWidth, 200.0f };
+    std::vector<LineFillWrapper> fill_wrappers;
+    fill_wrappers.emplace_back(clamp, nullptr, 0.0f, 0.0f, kWidth, 200.0f, &line, 200.0f, 1.0f);
+    REQUIRE(fill_wrappers[0].decimation_level >= 0);
+
+    DirtyRegion invalid_rects;
+    invalid_rects.add({ 0, 0, kWidth, 200 });
+    BatchVector<LineFillWrapper> batches;
+    batches.emplace_back(&fill_wrappers, &invalid_rects, 0, 0);
+
+    int num_vertices = numLineFillVertices(batches);
+    REQUIRE(num_vertices <= 4 * kWidth * Line::kFillVerticesPerPoint);
+    std::vector<LineVertex> vertices(num_vertices);
+    setLineFillVertices(batches, vertices.data());
+
+    std::vector<float> min_y(kWidth, FLT_MAX), max_y(kWidth, -FLT_MAX);
+    for (int i = 0; i < kNumPoints; ++i) {
+      int column = line.x[i];
+      min_y[column] = std::min(min_y[column], line.y[i]);
+      max_y[column] = std::max(max_y[column], line.y[i]);
+    }
+
+    std::vector<float> drawn_min_y(kWidth, FLT_MAX), drawn_max_y(kWidth, -FLT_MAX);
+    for (int i = 0; i < num_vertices; i += Line::kFillVerticesPerPoint) {
+      int column = vertices[i].x;
+      drawn_min_y[column] = std::min(drawn_min_y[column], vertices[i].y);
+      drawn_max_y[column] = std::max(drawn_max_y[column], vertices[i].y);
+    }
+
+    REQUIRE(drawn_min_y == min_y);
+    REQUIRE(drawn_max_y == max_y);
+  };
+
+  check_envelope();
+
+  for (int i = 5000; i < 5300; ++i) {
+    line.y[i] = (i % 2) ? -50.0f : 250.0f;
+    line.pointChanged(i);
+  }
+  line.y[kNumPoints - 1] = 400.0f;
+  line.pointChanged(kNumPoints - 1);
+  check_envelope();
+}
+
+TEST_CASE("Streamed line draws the newest ring samples", "[graphics]") {
+  static constexpr int kNumPoints = 1024;
+  static constexpr int kBlockSize = 64;
+  static constexpr int kNumBlocks = 20000;
+
+  SampleRing ring(4 * kNumPoints);
+  std::atomic<size_t> producer_allocations = 0;
+  std::thread producer([&ring, &producer_allocations] {
+    float block[kBlockSize];
+    size_t start_allocations = numThreadAllocations();
+    for (int b = 0; b < kNumBlocks; ++b) {
+      for (int i = 0; i < kBlockSize; ++i)
+        block[i] = b * kBlockSize + i + 1;
+
+      for (int pushed = 0; pushed < kBlockSize;)
+        pushed += ring.push(block + pushed, kBlockSize - pushed);
+    }
+    producer_allocations = numThreadAllocations() - start_allocations;
+  });
+
+  Line line(kNumPoints);
+  for (int i = 0; i < kNumPoints; ++i)
+    line.x[i] = i;
+
+  ClampBounds clamp = { 0.0f, 0.0f, kNumPoints, 100.0f };
+  DirtyRegion invalid_rects;
+  invalid_rects.add({ 0, 0, kNumPoints, 100 });
+  std::vector<LineVertex> vertices(kNumPoints * Line::kLineVerticesPerPoint);
+  float last_sample = 0.0f;
+  while (last_sample < kNumBlocks * kBlockSize) {
+    line.readSamples(ring, 0.0f, 1.0f);
+    std::vector<LineWrapper> wrappers;
+    wrappers.emplace_back(clamp, nullptr, 0.0f, 0.0f, kNumPoints, 100.0f, &line, 1.0f, 1.0f);
+    BatchVector<LineWrapper> batches;
+    batches.emplace_back(&wrappers, &invalid_rects, 0, 0);
+    REQUIRE(setLineVertices(batches, vertices.data()) == kNumPoints * Line::kLineVerticesPerPoint);
+
+    bool consecutive = true;
+    for (int i = 1; i < kNumPoints; ++i) {
+      float previous = line.y[line.storageIndex(i - 1)];
+      if (previous > 0.0f)
+        consecutive = consecutive && line.y[line.storageIndex(i)] == previous + 1.0f;
+    }
+    REQUIRE(consecutive);
+    last_sample = line.y[line.storageIndex(kNumPoints - 1)];
+  }
+
+  producer.join();
+  REQUIRE(producer_allocations == 0);
+  REQUIRE(ring.numAvailable() == 0);
+}
+
+TEST_CASE("Indexed batch assignment matches linear scan", "[graphics]") {
+  ShapeBatcher batcher;
+  forEachMixedShape(10000, [&batcher](auto shape, BlendMode blend) {
+    REQUIRE(batcher.autoBatchIndex(shape, blend) == linearBatchIndex(batcher, shape, blend));
+    batcher.addShape(shape, blend);
+  });
+  REQUIRE(batcher.numBatches() > 1);
+}
+
+TEST_CASE("Batch assignment benchmark", "[graphics][.benchmark]") {
+  ShapeBatcher batcher;
+  std::vector<Rectangle> queries;
+  forEachMixedShape(10000, [&batcher, &queries](auto shape, BlendMode blend) {
+    batcher.addShape(shape, blend);
+    queries.emplace_back(shape.clamp, nullptr, shape.x, shape.y, shape.width, shape.height);
+  });
+
+  BENCHMARK("Indexed batch lookup on 10k mixed shapes") {
+    int total = 0;
+    for (const Rectangle& query : queries)
+      total += batcher.autoBatchIndex(query, BlendMode::Alpha);
+    return total;
+  };
+
+  BENCHMARK("Linear batch lookup on 10k mixed shapes") {
+    int total = 0;
+    for (const Rectangle& query : queries)
+      total += linearBatchIndex(batcher, query, BlendMode::Alpha);
+    return total;
+  };
+}
@@ -0,0 +1,135 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "auto_cache.h"
+
+#include "frame.h"
+
+#include <algorithm>
+
+namespace visage {
+  // Frames can outlive the editor that cached them, so they're detached here
+  AutoCache::~AutoCache() {
+    for (Frame* frame : cached_frames_)
+      frame->auto_cache_ = {};
+  }
+
+  int AutoCache::subtreeShapes(const Frame* frame) {
+    int total = frame->region_.numShapes();
+    for (const Frame* child : frame->children()) {
+      if (child->isVisible() && child->isDrawing())
+        total += subtreeShapes(child);
+    }
+    return total;
+  }
+
+  void AutoCache::update(Frame* root, const std::set<Frame*>& redrawing) {
+    if (redrawing.empty() || (!enabled_ && used_bytes_ == 0))
+      return;
+
+    // A frame changes when it or anything inside it redraws
+    changed_.clear();
+    redrawn_areas_.clear();
+    for (const Frame* frame : redrawing) {
+      IBounds area(0, 0, frame->nativeWidth(), frame->nativeHeight());
+      for (const Frame* parent = frame; parent && parent != root; parent = parent->parent()) {
+        changed_.insert(parent);
+        area = { area.x() + parent->nativeX(), area.y() + parent->nativeY(), area.width(),
+                 area.height() };
+      }
+      redrawn_areas_.push_back(area);
+    }
+
+    for (Frame* child : root->children())
+      updateFrame(child, {}, root->requiresLayer());
+  }
+
+  void AutoCache::updateFrame(Frame* frame, IPoint offset, bool inside_layer) {
+    AutoCacheState& state = frame->auto_cache_;
+    IBounds bounds(offset.x + frame->nativeX(), offset.y + frame->nativeY(), frame->nativeWidth(),
+                   frame->nativeHeight());
+
+    if (!enabled_) {
+      if (state.cached)
+        demote(frame);
+    }
+    else if (!frame->isVisible() || !frame->isDrawing())
+      return;
+    else if (changed_.count(frame)) {
+      state.unchanged_ticks = 0;
+      state.exposed = false;
+      state.changed_ticks++;
+      if (state.cached && state.changed_ticks >= demote_after_)
+        demote(frame);
+    }
+    else {
+      state.changed_ticks = 0;
+      state.unchanged_ticks++;
+      bool exposed = std::any_of(redrawn_areas_.begin(), redrawn_areas_.end(),
+                                 [&bounds](const IBounds& area) { return area.overlaps(bounds); });
+      state.exposed = state.exposed || exposed;
+
+      if (state.cached && exposed)
+        shapes_saved_ += std::max(0, subtreeShapes(frame) - 1);
+      else if (!state.cached && !inside_layer && !frame->requiresLayer() && state.exposed &&
+               state.unchanged_ticks >= promote_after_) {
+        promote(frame, bounds);
+      }
+    }
+
+    inside_layer = inside_layer || frame->requiresLayer();
+    for (Frame* child : frame->children())
+      updateFrame(child, bounds.topLeft(), inside_layer);
+  }
+
+  void AutoCache::promote(Frame* frame, const IBounds& bounds) {
+    size_t bytes = static_cast<size_t>(bounds.width()) * bounds.height() * 4;
+    if (bytes == 0 || used_bytes_ + bytes > memory_budget_)
+      return;
+
+    AutoCacheState& state = frame->auto_cache_;
+    state.cached = true;
+    state.bytes = bytes;
+    state.owner = this;
+    cached_frames_.insert(frame);
+    used_bytes_ += bytes;
+    num_promotions_++;
+    frame->redraw();
+  }
+
+  void AutoCache::demote(Frame* frame) {
+    release(frame);
+    num_demotions_++;
+    frame->redraw();
+  }
+
+  void AutoCache::release(Frame* frame) {
+    AutoCacheState& state = frame->auto_cache_;
+    if (!state.cached || state.owner != this)
+      return;
+
+    used_bytes_ -= state.bytes;
+    cached_frames_.erase(frame);
+    state.cached = false;
+    state.bytes = 0;
+    state.owner = nullptr;
+  }
+}
@@ -0,0 +1,102 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "visage_utils/space.h"
+
+#include <cstddef>
+#include <set>
+#include <vector>
+
+namespace visage {
+  class AutoCache;
+  class Frame;
+
+  struct AutoCacheState {
+    int unchanged_ticks = 0;
+    int changed_ticks = 0;
+    bool exposed = false;
+    bool cached = false;
+    size_t bytes = 0;
+    AutoCache* owner = nullptr;
+  };
+
+  // Caches frames on its own based on how they redraw. A frame that stays unchanged while frames
+  // over or around it redraw gets drawn into a cached layer, and one that keeps redrawing goes
+  // back to drawing directly. Each window's editor owns one, and the layers it caches share its
+  // memory budget.
+  class AutoCache {
+  public:
+    static constexpr int kDefaultPromoteAfter = 30;
+    static constexpr int kDefaultDemoteAfter = 3;
+    static constexpr size_t kDefaultMemoryBudget = 64 * 1024 * 1024;
+
+    AutoCache() = default;
+    AutoCache(const AutoCache&) = delete;
+    AutoCache& operator=(const AutoCache&) = delete;
+    ~AutoCache();
+
+    void setEnabled(bool enabled) { enabled_ = enabled; }
+    bool enabled() const { return enabled_; }
+    void setPromoteAfter(int ticks) { promote_after_ = ticks; }
+    int promoteAfter() const { return promote_after_; }
+    void setDemoteAfter(int ticks) { demote_after_ = ticks; }
+    int demoteAfter() const { return demote_after_; }
+    void setMemoryBudget(size_t bytes) { memory_budget_ = bytes; }
+    size_t memoryBudget() const { return memory_budget_; }
+    size_t usedBytes() const { return used_bytes_; }
+
+    int numPromotions() const { return num_promotions_; }
+    int numDemotions() const { return num_demotions_; }
+    // Shapes that would have been resubmitted if the cached frames were drawn directly
+    long long shapesSaved() const { return shapes_saved_; }
+    void resetCounters() {
+      num_promotions_ = 0;
+      num_demotions_ = 0;
+      shapes_saved_ = 0;
+    }
+
+    // Called every time a window draws with the frames about to redraw
+    void update(Frame* root, const std::set<Frame*>& redrawing);
+    void release(Frame* frame);
+
+  private:
+    static int subtreeShapes(const Frame* frame);
+
+    void updateFrame(Frame* frame, IPoint offset, bool inside_layer);
+    void promote(Frame* frame, const IBounds& bounds);
+    void demote(Frame* frame);
+
+    bool enabled_ = false;
+    int promote_after_ = kDefaultPromoteAfter;
+    int demote_after_ = kDefaultDemoteAfter;
+    size_t memory_budget_ = kDefaultMemoryBudget;
+    size_t used_bytes_ = 0;
+    int num_promotions_ = 0;
+    int num_demotions_ = 0;
+    long long shapes_saved_ = 0;
+
+    std::set<Frame*> cached_frames_;
+    std::set<const Frame*> changed_;
+    std::vector<IBounds> redrawn_areas_;
+  };
+}
@@ -309,6 +309,7 @@ namespace visage {
     redrawing_ = false;
     region_.invalidate();
     region_.setNeedsLayer(requiresLayer());
+    region_.setOpaque(opaque_ && alpha_transparency_ == 1.0f && !masked_);
     if (width() <= 0 || height() <= 0) {
       region_.clear();
       return;
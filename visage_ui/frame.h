@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include "auto_cache.h"
 #include "events.h"
 #include "layout.h"
 #include "undo_history.h"
@@ -48,9 +49,13 @@ namespace visage {
 
   class Frame {
   public:
+    friend class AutoCache;
+
     Frame() = default;
     explicit Frame(std::string name) : name_(std::move(name)) { }
     virtual ~Frame() {
+      if (auto_cache_.cached)
+        auto_cache_.owner->release(this);
       notifyRemoveFromHierarchy();
       if (parent_)
         parent_->eraseChild(this);
@@ -160,6 +165,19 @@ namespace visage {
       redraw();
     }
 
+    // Promises the frame fills its whole bounds with opaque colors so frames under it can skip
+    // drawing what it covers. Alpha transparency and masking turn this off.
+    void setOpaque(bool opaque) {
+      opaque_ = opaque;
+      redraw();
+    }
+    bool isOpaque() const { return opaque_; }
+
+    bool isAutoCached() const { return auto_cache_.cached; }
+
+    void setRetainedGeometry(bool retained) { region_.setRetainedGeometry(retained); }
+    bool retainedGeometry() const { return region_.retainedGeometry(); }
+
     void setMasked(bool masked) {
       masked_ = masked;
       redraw();
@@ -370,7 +388,8 @@ namespace visage {
     void eraseChild(Frame* child);
 
     bool requiresLayer() const {
-      return post_effect_ || cached_ || masked_ || alpha_transparency_ != 1.0f;
+      return post_effect_ || cached_ || auto_cache_.cached || masked_ ||
+             alpha_transparency_ != 1.0f;
     }
 
     std::string name_;
@@ -416,6 +435,8 @@ namespace visage {
     PostEffect* post_effect_ = nullptr;
     bool cached_ = false;
     bool masked_ = false;
+    bool opaque_ = false;
+    AutoCacheState auto_cache_;
     float alpha_transparency_ = 1.0f;
     Region region_;
     std::unique_ptr<Layout> layout_;
@@ -0,0 +1,89 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "defines.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace visage {
+  // Single producer, single consumer queue of samples, meant for handing audio to the UI.
+  // Pushing is wait-free and never allocates so it's safe to call from an audio callback.
+  class SampleRing {
+  public:
+    explicit SampleRing(int capacity) :
+        capacity_(capacity), buffer_(std::make_unique<float[]>(capacity)) {
+      VISAGE_ASSERT(capacity > 0);
+    }
+
+    int capacity() const { return capacity_; }
+
+    // Producer thread only. Samples that don't fit are dropped and the number pushed is returned.
+    int push(const float* samples, int num_samples) {
+      size_t write = write_.load(std::memory_order_relaxed);
+      size_t read = read_.load(std::memory_order_acquire);
+      int num = std::min(num_samples, capacity_ - static_cast<int>(write - read));
+      int start = write % capacity_;
+      int first = std::min(num, capacity_ - start);
+      std::copy(samples, samples + first, buffer_.get() + start);
+      std::copy(samples + first, samples + num, buffer_.get());
+      write_.store(write + num, std::memory_order_release);
+      return num;
+    }
+
+    bool push(float sample) { return push(&sample, 1) == 1; }
+
+    // Consumer thread only.
+    int numAvailable() const {
+      return write_.load(std::memory_order_acquire) - read_.load(std::memory_order_relaxed);
+    }
+
+    int pop(float* destination, int max_samples) {
+      size_t read = read_.load(std::memory_order_relaxed);
+      size_t write = write_.load(std::memory_order_acquire);
+      int num = std::min(max_samples, static_cast<int>(write - read));
+      int start = read % capacity_;
+      int first = std::min(num, capacity_ - start);
+      std::copy(buffer_.get() + start, buffer_.get() + start + first, destination);
+      std::copy(buffer_.get(), buffer_.get() + num - first, destination + first);
+      read_.store(read + num, std::memory_order_release);
+      return num;
+    }
+
+    int skip(int max_samples) {
+      size_t read = read_.load(std::memory_order_relaxed);
+      size_t write = write_.load(std::memory_order_acquire);
+      int num = std::min(max_samples, static_cast<int>(write - read));
+      read_.store(read + num, std::memory_order_release);
+      return num;
+    }
+
+  private:
+    int capacity_ = 0;
+    std::unique_ptr<float[]> buffer_;
+    std::atomic<size_t> write_ = 0;
+    std::atomic<size_t> read_ = 0;
+  };
+}
@@ -25,6 +25,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <vector>
 
 namespace visage {
@@ -279,6 +280,322 @@ namespace visage {
     int height_ = 0;
   };
 
+  // Set of non-overlapping rectangles stored in y-x bands like pixman regions.
+  // Rectangles in a band share top and bottom edges and are sorted by x, bands are sorted by y.
+  class BandedRegion {
+  public:
+    BandedRegion() = default;
+    explicit BandedRegion(const IBounds& rect) {
+      if (rect.width() > 0 && rect.height() > 0)
+        rects_.push_back(rect);
+    }
+
+    std::vector<IBounds>::const_iterator begin() const { return rects_.begin(); }
+    std::vector<IBounds>::const_iterator end() const { return rects_.end(); }
+    const std::vector<IBounds>& rects() const { return rects_; }
+    int numRects() const { return rects_.size(); }
+    bool isEmpty() const { return rects_.empty(); }
+    void clear() { rects_.clear(); }
+
+    IBounds boundingBox() const {
+      if (rects_.empty())
+        return {};
+
+      int left = rects_.front().x();
+      int right = rects_.front().right();
+      for (const IBounds& rect : rects_) {
+        left = std::min(left, rect.x());
+        right = std::max(right, rect.right());
+      }
+      int top = rects_.front().y();
+      return { left, top, right - left, rects_.back().bottom() - top };
+    }
+
+    long long area() const {
+      long long area = 0;
+      for (const IBounds& rect : rects_)
+        area += static_cast<long long>(rect.width()) * rect.height();
+      return area;
+    }
+
+    bool contains(const IBounds& rect) const {
+      return std::any_of(rects_.begin(), rects_.end(),
+                         [&rect](const IBounds& other) { return other.contains(rect); });
+    }
+
+    void unite(const IBounds& rect) {
+      if (rect.width() <= 0 || rect.height() <= 0 || contains(rect))
+        return;
+
+      if (rects_.empty() || rect.contains(boundingBox())) {
+        rects_ = { rect };
+        return;
+      }
+
+      // Only bands touching the rectangle's rows can change
+      auto first = std::lower_bound(rects_.begin(), rects_.end(), rect.y(),
+                                    [](const IBounds& piece, int y) { return piece.bottom() < y; });
+      auto last = std::upper_bound(first, rects_.end(), rect.bottom(),
+                                   [](int bottom, const IBounds& piece) { return bottom < piece.y(); });
+      std::vector<IBounds> affected(first, last);
+      std::vector<IBounds> combined = combine(affected, { rect }, [](bool a, bool b) { return a || b; });
+      auto position = rects_.erase(first, last);
+      rects_.insert(position, combined.begin(), combined.end());
+    }
+
+    void unite(const BandedRegion& other) {
+      rects_ = combine(rects_, other.rects_, [](bool a, bool b) { return a || b; });
+    }
+
+    void subtract(const BandedRegion& other) {
+      rects_ = combine(rects_, other.rects_, [](bool a, bool b) { return a && !b; });
+    }
+
+    void intersect(const BandedRegion& other) {
+      rects_ = combine(rects_, other.rects_, [](bool a, bool b) { return a && b; });
+    }
+
+    void subtract(const IBounds& rect) { subtract(BandedRegion(rect)); }
+
+    // Clipping to a rectangle keeps the banding so it doesn't need a full combine
+    void intersect(const IBounds& rect) {
+      for (IBounds& piece : rects_)
+        piece = piece.intersection(rect);
+
+      rects_.erase(std::remove_if(rects_.begin(), rects_.end(),
+                                  [](const IBounds& piece) {
+                                    return piece.width() <= 0 || piece.height() <= 0;
+                                  }),
+                   rects_.end());
+    }
+
+  private:
+    static size_t bandEnd(const std::vector<IBounds>& rects, size_t start) {
+      size_t end = start;
+      while (end < rects.size() && rects[end].y() == rects[start].y())
+        ++end;
+      return end;
+    }
+
+    template<typename Op>
+    static void combineSpans(const std::vector<IBounds>& a, size_t a_index, size_t a_end,
+                             const std::vector<IBounds>& b, size_t b_index, size_t b_end, Op op,
+                             std::vector<int>& spans) {
+      static constexpr int kMax = std::numeric_limits<int>::max();
+
+      bool in_a = false;
+      bool in_b = false;
+      bool inside = false;
+      int start = 0;
+      while (a_index < a_end || b_index < b_end) {
+        int next_a = a_index < a_end ? (in_a ? a[a_index].right() : a[a_index].x()) : kMax;
+        int next_b = b_index < b_end ? (in_b ? b[b_index].right() : b[b_index].x()) : kMax;
+        int x = std::min(next_a, next_b);
+        if (next_a == x) {
+          a_index += in_a;
+          in_a = !in_a;
+        }
+        if (next_b == x) {
+          b_index += in_b;
+          in_b = !in_b;
+        }
+
+        bool now_inside = op(in_a, in_b);
+        if (now_inside && !inside) {
+          start = x;
+          if (!spans.empty() && spans.back() == x) {
+            spans.pop_back();
+            start = spans.back();
+            spans.pop_back();
+          }
+        }
+        else if (!now_inside && inside) {
+          spans.push_back(start);
+          spans.push_back(x);
+        }
+        inside = now_inside;
+      }
+    }
+
+    static void appendBand(std::vector<IBounds>& result, int top, int bottom,
+                           const std::vector<int>& spans, size_t& band_start) {
+      if (spans.empty())
+        return;
+
+      size_t num_spans = spans.size() / 2;
+      bool coalesce = !result.empty() && result.back().bottom() == top &&
+                      result.size() - band_start == num_spans;
+      for (size_t i = 0; coalesce && i < num_spans; ++i) {
+        const IBounds& rect = result[band_start + i];
+        coalesce = rect.x() == spans[2 * i] && rect.right() == spans[2 * i + 1];
+      }
+
+      if (coalesce) {
+        for (size_t i = band_start; i < result.size(); ++i)
+          result[i].setHeight(bottom - result[i].y());
+        return;
+      }
+
+      band_start = result.size();
+      for (size_t i = 0; i < num_spans; ++i)
+        result.emplace_back(spans[2 * i], top, spans[2 * i + 1] - spans[2 * i], bottom - top);
+    }
+
+    template<typename Op>
+    static std::vector<IBounds> combine(const std::vector<IBounds>& a, const std::vector<IBounds>& b, Op op) {
+      static constexpr int kMax = std::numeric_limits<int>::max();
+
+      std::vector<IBounds> result;
+      std::vector<int> spans;
+      size_t band_start = 0;
+      size_t a_index = 0;
+      size_t b_index = 0;
+      int y = std::numeric_limits<int>::min();
+      while (a_index < a.size() || b_index < b.size()) {
+        size_t a_end = bandEnd(a, a_index);
+        size_t b_end = bandEnd(b, b_index);
+        int a_top = a_index < a.size() ? std::max(y, a[a_index].y()) : kMax;
+        int b_top = b_index < b.size() ? std::max(y, b[b_index].y()) : kMax;
+        int top = std::min(a_top, b_top);
+        bool in_a = a_top == top;
+        bool in_b = b_top == top;
+        int bottom = std::min(in_a ? a[a_index].bottom() : a_top, in_b ? b[b_index].bottom() : b_top);
+
+        spans.clear();
+        combineSpans(a, a_index, in_a ? a_end : a_index, b, b_index, in_b ? b_end : b_index, op, spans);
+        appendBand(result, top, bottom, spans, band_start);
+
+        y = bottom;
+        if (in_a && a[a_index].bottom() <= y)
+          a_index = a_end;
+        if (in_b && b[b_index].bottom() <= y)
+          b_index = b_end;
+      }
+      return result;
+    }
+
+    std::vector<IBounds> rects_;
+  };
+
+  // Non-overlapping rectangles for tracking invalidated areas.
+  // Banding the whole set would slice every rectangle that shares rows with another, so only the
+  // uncovered part of each new rectangle is banded. A new rectangle is merged with the ones it
+  // touches when their bounding box wastes little area, and the whole set collapses to its bounding
+  // box when it has too many rectangles.
+  class DirtyRegion {
+  public:
+    static constexpr int kDefaultMaxRects = 64;
+    static constexpr float kDefaultMaxWaste = 0.25f;
+
+    explicit DirtyRegion(int max_rects = kDefaultMaxRects, float max_waste = kDefaultMaxWaste) :
+        max_rects_(max_rects), max_waste_(max_waste) { }
+
+    std::vector<IBounds>::const_iterator begin() const { return rects_.begin(); }
+    std::vector<IBounds>::const_iterator end() const { return rects_.end(); }
+    const std::vector<IBounds>& rects() const { return rects_; }
+    int numRects() const { return rects_.size(); }
+    bool isEmpty() const { return rects_.empty(); }
+    void clear() { rects_.clear(); }
+
+    IBounds boundingBox() const {
+      if (rects_.empty())
+        return {};
+
+      IBounds result = rects_.front();
+      for (const IBounds& rect : rects_)
+        result = boundingBox(result, rect);
+      return result;
+    }
+
+    long long area() const {
+      long long result = 0;
+      for (const IBounds& rect : rects_)
+        result += area(rect);
+      return result;
+    }
+
+    void add(IBounds rect) {
+      if (rect.width() <= 0 || rect.height() <= 0)
+        return;
+
+      for (size_t i = 0; i < rects_.size();) {
+        const IBounds& other = rects_[i];
+        if (other.contains(rect))
+          return;
+
+        bool touches = rect.x() <= other.right() && rect.right() >= other.x() &&
+                       rect.y() <= other.bottom() && rect.bottom() >= other.y();
+        IBounds box = boundingBox(rect, other);
+        long long covered = area(rect) + area(other) - area(rect.intersection(other));
+        if (!touches || area(box) - covered > max_waste_ * area(box)) {
+          ++i;
+          continue;
+        }
+
+        rect = box;
+        rects_.erase(rects_.begin() + i);
+        i = 0;
+      }
+
+      BandedRegion pieces(rect);
+      for (auto it = rects_.begin(); it != rects_.end();) {
+        if (rect.contains(*it))
+          it = rects_.erase(it);
+        else {
+          if (it->overlaps(rect))
+            pieces.subtract(*it);
+          ++it;
+        }
+      }
+      rects_.insert(rects_.end(), pieces.begin(), pieces.end());
+
+      if (numRects() > max_rects_)
+        rects_ = { boundingBox() };
+    }
+
+    void intersect(const IBounds& bounds) {
+      for (IBounds& rect : rects_)
+        rect = rect.intersection(bounds);
+
+      rects_.erase(std::remove_if(rects_.begin(), rects_.end(),
+                                  [](const IBounds& rect) {
+                                    return rect.width() <= 0 || rect.height() <= 0;
+                                  }),
+                   rects_.end());
+    }
+
+    // Never collapses to the bounding box, that could grow the region past what was invalidated.
+    void subtract(const IBounds& bounds) {
+      std::vector<IBounds> remaining;
+      for (const IBounds& rect : rects_) {
+        if (!rect.overlaps(bounds)) {
+          remaining.push_back(rect);
+          continue;
+        }
+
+        BandedRegion pieces(rect);
+        pieces.subtract(bounds);
+        remaining.insert(remaining.end(), pieces.begin(), pieces.end());
+      }
+      rects_ = std::move(remaining);
+    }
+
+  private:
+    static long long area(const IBounds& rect) {
+      return static_cast<long long>(std::max(0, rect.width())) * std::max(0, rect.height());
+    }
+
+    static IBounds boundingBox(const IBounds& a, const IBounds& b) {
+      int left = std::min(a.x(), b.x());
+      int top = std::min(a.y(), b.y());
+      return { left, top, std::max(a.right(), b.right()) - left, std::max(a.bottom(), b.bottom()) - top };
+    }
+
+    std::vector<IBounds> rects_;
+    int max_rects_ = kDefaultMaxRects;
+    float max_waste_ = kDefaultMaxWaste;
+  };
+
   class Bounds {
   public:
     Bounds() = default;
@@ -21,8 +21,10 @@
 
 #include "visage_utils/space.h"
 
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <random>
 
 using namespace visage;
 
@@ -378,3 +380,215 @@ TEST_CASE("IBounds reduced asymmetric", "[utils]") {
     REQUIRE(reduced.height() == 0);
   }
 }
+
+static void checkCoverage(const BandedRegion& region, const std::vector<bool>& expected, int size) {
+  std::vector<int> coverage(size * size, 0);
+  for (const IBounds& rect : region) {
+    REQUIRE(rect.width() > 0);
+    REQUIRE(rect.height() > 0);
+    for (int y = rect.y(); y < rect.bottom(); ++y) {
+      for (int x = rect.x(); x < rect.right(); ++x)
+        coverage[y * size + x]++;
+    }
+  }
+
+  for (int i = 0; i < size * size; ++i)
+    REQUIRE(coverage[i] == expected[i]);
+}
+
+static void applyToMask(std::vector<bool>& mask, int size, const IBounds& rect, bool value) {
+  for (int y = rect.y(); y < rect.bottom(); ++y) {
+    for (int x = rect.x(); x < rect.right(); ++x)
+      mask[y * size + x] = value;
+  }
+}
+
+TEST_CASE("Banded region union", "[utils]") {
+  BandedRegion region;
+  region.unite(IBounds(0, 0, 10, 10));
+  region.unite(IBounds(5, 5, 10, 10));
+  REQUIRE(region.numRects() == 3);
+  REQUIRE(region.area() == 175);
+  REQUIRE(region.boundingBox() == IBounds(0, 0, 15, 15));
+
+  region.unite(IBounds(2, 2, 3, 3));
+  REQUIRE(region.numRects() == 3);
+
+  region.unite(IBounds(10, 0, 5, 5));
+  REQUIRE(region.numRects() == 2);
+  REQUIRE(region.area() == 200);
+}
+
+TEST_CASE("Banded region coalesces adjacent bands", "[utils]") {
+  BandedRegion region;
+  region.unite(IBounds(0, 0, 10, 5));
+  region.unite(IBounds(0, 5, 10, 5));
+  REQUIRE(region.numRects() == 1);
+  REQUIRE(region.rects()[0] == IBounds(0, 0, 10, 10));
+
+  region.unite(IBounds(10, 0, 10, 10));
+  REQUIRE(region.numRects() == 1);
+  REQUIRE(region.rects()[0] == IBounds(0, 0, 20, 10));
+}
+
+TEST_CASE("Banded region subtract and intersect", "[utils]") {
+  BandedRegion region(IBounds(0, 0, 10, 10));
+  region.subtract(IBounds(3, 3, 4, 4));
+  REQUIRE(region.numRects() == 4);
+  REQUIRE(region.area() == 84);
+
+  BandedRegion other(IBounds(0, 0, 5, 10));
+  region.intersect(other);
+  REQUIRE(region.area() == 42);
+
+  region.intersect(IBounds(0, 0, 5, 5));
+  REQUIRE(region.area() == 21);
+}
+
+TEST_CASE("Banded region matches pixel coverage", "[utils]") {
+  static constexpr int kSize = 48;
+  std::mt19937 random(1);
+  std::uniform_int_distribution<int> position(0, kSize - 1);
+
+  BandedRegion region;
+  std::vector<bool> mask(kSize * kSize, false);
+  for (int i = 0; i < 300; ++i) {
+    int x = position(random);
+    int y = position(random);
+    int width = std::uniform_int_distribution<int>(1, kSize - x)(random);
+    int height = std::uniform_int_distribution<int>(1, kSize - y)(random);
+    IBounds rect(x, y, width, height);
+
+    if (i % 5 == 4) {
+      region.subtract(rect);
+      applyToMask(mask, kSize, rect, false);
+    }
+    else {
+      region.unite(rect);
+      applyToMask(mask, kSize, rect, true);
+    }
+    checkCoverage(region, mask, kSize);
+  }
+}
+
+TEST_CASE("Dirty region stays non-overlapping", "[utils]") {
+  static constexpr int kSize = 48;
+  std::mt19937 random(2);
+  std::uniform_int_distribution<int> position(0, kSize - 1);
+
+  DirtyRegion region(DirtyRegion::kDefaultMaxRects, 0.1f);
+  std::vector<bool> mask(kSize * kSize, false);
+  for (int i = 0; i < 100; ++i) {
+    int x = position(random);
+    int y = position(random);
+    int width = std::uniform_int_distribution<int>(1, std::min(12, kSize - x))(random);
+    int height = std::uniform_int_distribution<int>(1, std::min(12, kSize - y))(random);
+    region.add(IBounds(x, y, width, height));
+    applyToMask(mask, kSize, IBounds(x, y, width, height), true);
+
+    std::vector<int> coverage(kSize * kSize, 0);
+    for (const IBounds& rect : region) {
+      for (int r = rect.y(); r < rect.bottom(); ++r) {
+        for (int c = rect.x(); c < rect.right(); ++c)
+          coverage[r * kSize + c]++;
+      }
+    }
+
+    for (int p = 0; p < kSize * kSize; ++p) {
+      REQUIRE(coverage[p] <= 1);
+      REQUIRE((!mask[p] || coverage[p] == 1));
+    }
+  }
+}
+
+TEST_CASE("Dirty region merges low waste rects", "[utils]") {
+  DirtyRegion region;
+  region.add(IBounds(0, 0, 10, 10));
+  region.add(IBounds(0, 10, 9, 10));
+  REQUIRE(region.numRects() == 1);
+  REQUIRE(region.rects()[0] == IBounds(0, 0, 10, 20));
+
+  region.add(IBounds(100, 100, 10, 10));
+  REQUIRE(region.numRects() == 2);
+
+  region.add(IBounds(5, 5, 100, 2));
+  REQUIRE(region.area() == 490);
+  REQUIRE(region.numRects() > 2);
+
+  DirtyRegion limited(2);
+  limited.add(IBounds(0, 0, 2, 2));
+  limited.add(IBounds(10, 10, 2, 2));
+  REQUIRE(limited.numRects() == 2);
+  limited.add(IBounds(20, 20, 2, 2));
+  REQUIRE(limited.numRects() == 1);
+  REQUIRE(limited.rects()[0] == IBounds(0, 0, 22, 22));
+}
+
+static void addBrokenInvalidRect(std::vector<IBounds>& invalid_rects, IBounds rect) {
+  std::vector<IBounds> pieces;
+  for (auto it = invalid_rects.begin(); it != invalid_rects.end();) {
+    if (it->contains(rect))
+      return;
+
+    if (rect.contains(*it)) {
+      it = invalid_rects.erase(it);
+      continue;
+    }
+    IBounds::breakIntoNonOverlapping(rect, *it, pieces);
+    ++it;
+  }
+
+  invalid_rects.push_back(rect);
+  invalid_rects.insert(invalid_rects.end(), pieces.begin(), pieces.end());
+}
+
+static std::vector<IBounds> meterInvalidations(int num_meters, int invalidations_per_meter) {
+  std::mt19937 random(1);
+  std::uniform_int_distribution<int> x_position(0, 1600 - 20);
+  std::uniform_int_distribution<int> y_position(0, 900 - 80);
+  std::uniform_int_distribution<int> level(1, 80);
+
+  std::vector<IBounds> rects;
+  for (int i = 0; i < num_meters; ++i) {
+    int x = x_position(random);
+    int y = y_position(random);
+    for (int k = 0; k < invalidations_per_meter; ++k) {
+      int height = level(random);
+      rects.emplace_back(x - k, y + 80 - height, 12 + 2 * k, height);
+    }
+  }
+  return rects;
+}
+
+TEST_CASE("Invalid rect benchmark", "[utils][.benchmark]") {
+  std::vector<IBounds> scattered = meterInvalidations(200, 1);
+  std::vector<IBounds> overlapping = meterInvalidations(200, 4);
+
+  BENCHMARK("Broken rects on scattered meters") {
+    std::vector<IBounds> invalid_rects;
+    for (const IBounds& rect : scattered)
+      addBrokenInvalidRect(invalid_rects, rect);
+    return invalid_rects.size();
+  };
+
+  BENCHMARK("Dirty region on scattered meters") {
+    DirtyRegion region(std::numeric_limits<int>::max());
+    for (const IBounds& rect : scattered)
+      region.add(rect);
+    return region.numRects();
+  };
+
+  BENCHMARK("Broken rects on overlapping meter updates") {
+    std::vector<IBounds> invalid_rects;
+    for (const IBounds& rect : overlapping)
+      addBrokenInvalidRect(invalid_rects, rect);
+    return invalid_rects.size();
+  };
+
+  BENCHMARK("Dirty region on overlapping meter updates") {
+    DirtyRegion region(std::numeric_limits<int>::max());
+    for (const IBounds& rect : overlapping)
+      region.add(rect);
+    return region.numRects();
+  };
+}
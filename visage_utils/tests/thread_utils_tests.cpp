@@ -0,0 +1,67 @@
+/* Copyright Vital Audio, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "visage_utils/thread_utils.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+using namespace visage;
+
+TEST_CASE("Task queue runs every task in order", "[utils]") {
+  static constexpr int kNumTasks = 200;
+
+  std::mutex mutex;
+  std::vector<int> order;
+  {
+    TaskQueue queue(1);
+    for (int i = 0; i < kNumTasks; ++i) {
+      queue.add([&mutex, &order, i] {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(i);
+      });
+    }
+
+    while (true) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (order.size() == kNumTasks)
+        break;
+    }
+  }
+
+  for (int i = 0; i < kNumTasks; ++i)
+    REQUIRE(order[i] == i);
+}
+
+TEST_CASE("Worker pool runs each job once", "[utils]") {
+  static constexpr int kNumJobs = 1000;
+
+  WorkerPool pool(3);
+  std::vector<int> counts(kNumJobs);
+  for (int i = 0; i < 20; ++i)
+    pool.run(kNumJobs, [&counts](int index) { counts[index]++; });
+  pool.run(0, [&counts](int index) { counts[index]++; });
+  pool.run(1, [&counts](int index) { counts[index]++; });
+
+  REQUIRE(counts[0] == 21);
+  for (int i = 1; i < kNumJobs; ++i)
+    REQUIRE(counts[i] == 20);
+}
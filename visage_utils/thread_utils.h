@@ -24,11 +24,16 @@
 #include "defines.h"
 #include "time_utils.h"
 
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace visage {
   class Thread {
@@ -115,4 +120,113 @@ namespace visage {
     std::function<void()> task_;
     std::unique_ptr<std::thread> thread_;
   };
-}
\ No newline at end of file
+
+  // Background threads that run queued tasks in the order they were added. Without threads
+  // tasks run as soon as they're added.
+  class TaskQueue {
+  public:
+    explicit TaskQueue(int num_threads, const std::string& name = "Worker") {
+#if !VISAGE_EMSCRIPTEN
+      for (int i = 0; i < num_threads; ++i) {
+        threads_.push_back(std::make_unique<Thread>(name));
+        threads_.back()->setThreadTask([this] { work(); });
+        threads_.back()->start();
+      }
+#endif
+    }
+
+    // Tasks that haven't started yet are dropped
+    ~TaskQueue() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      condition_.notify_all();
+      for (auto& thread : threads_)
+        thread->stop();
+    }
+
+    int numThreads() const { return threads_.size(); }
+
+    void add(std::function<void()> task) {
+      if (threads_.empty()) {
+        task();
+        return;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+      }
+      condition_.notify_one();
+    }
+
+  private:
+    void work() {
+      while (true) {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          condition_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+          if (stopping_)
+            return;
+
+          task = std::move(tasks_.front());
+          tasks_.pop_front();
+        }
+        task();
+      }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stopping_ = false;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::unique_ptr<Thread>> threads_;
+  };
+
+  class WorkerPool {
+  public:
+    explicit WorkerPool(int num_threads, const std::string& name = "Worker") :
+        queue_(num_threads, name) { }
+
+    int numThreads() const { return queue_.numThreads(); }
+
+    // Calls job(0) through job(num_jobs - 1) across the workers and the calling thread
+    // and returns once every job has finished
+    void run(int num_jobs, const std::function<void(int)>& job) {
+      if (numThreads() == 0 || num_jobs <= 1) {
+        for (int i = 0; i < num_jobs; ++i)
+          job(i);
+        return;
+      }
+
+      int num_helpers = std::min(numThreads(), num_jobs - 1);
+      std::atomic<int> next_job = 0;
+      auto run_jobs = [&] {
+        for (int index = next_job++; index < num_jobs; index = next_job++)
+          job(index);
+      };
+
+      std::mutex mutex;
+      std::condition_variable done_condition;
+      int remaining_helpers = num_helpers;
+      for (int i = 0; i < num_helpers; ++i) {
+        queue_.add([&] {
+          run_jobs();
+          std::lock_guard<std::mutex> lock(mutex);
+          if (--remaining_helpers == 0)
+            done_condition.notify_all();
+        });
+      }
+
+      run_jobs();
+
+      std::unique_lock<std::mutex> lock(mutex);
+      done_condition.wait(lock, [&] { return remaining_helpers == 0; });
+    }
+
+  private:
+    TaskQueue queue_;
+  };
+}
@@ -24,6 +24,7 @@
 #include "visage_graphics/line.h"
 #include "visage_graphics/theme.h"
 #include "visage_ui/frame.h"
+#include "visage_utils/sample_ring.h"
 
 namespace visage {
   class GraphLine : public Frame {
@@ -58,17 +59,19 @@ namespace visage {
 
     void draw(Canvas& canvas) override;
 
-    float boostAt(int index) const { return line_.values[index]; }
+    float boostAt(int index) const { return line_.values[line_.storageIndex(index)]; }
     void setBoostAt(int index, float val) {
       VISAGE_ASSERT(index < line_.num_points && index >= 0);
-      line_.values[index] = val;
+      line_.values[line_.storageIndex(index)] = val;
       redraw();
     }
 
-    float yAt(int index) const { return line_.y[index]; }
+    float yAt(int index) const { return line_.y[line_.storageIndex(index)]; }
     void setYAt(int index, float val) {
       VISAGE_ASSERT(index < line_.num_points && index >= 0);
-      line_.y[index] = val;
+      int storage_index = line_.storageIndex(index);
+      line_.y[storage_index] = val;
+      line_.pointChanged(storage_index);
       redraw();
     }
 
@@ -79,6 +82,19 @@ namespace visage {
       redraw();
     }
 
+    // Only for graphs whose x values increase with the point index, like waveforms.
+    void setMinMaxDecimation(bool decimate) {
+      line_.setMinMaxDecimation(decimate);
+      redraw();
+    }
+
+    // Draws the newest numPoints() samples from the ring, with -1 to 1 spanning the height.
+    // Call from the UI thread, the audio thread only pushes into the ring.
+    void readSamples(SampleRing& ring) {
+      line_.readSamples(ring, height() * 0.5f, height() * -0.5f);
+      redraw();
+    }
+
     bool fill() const { return fill_; }
 
     void setFill(bool fill) { fill_ = fill; }